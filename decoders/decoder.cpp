@@ -1,6 +1,56 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #include "decoder.h"
 
+#include "project/footage.h"
+
+DecoderParams::DecoderParams() :
+  stream_index(-1),
+  start_number(0),
+  video_interlacing(VIDEO_PROGRESSIVE),
+  video_native_yuv(false),
+  video_divider(1),
+  threads(0),
+  audio_sample_rate(0),
+  audio_speed(1.0),
+  audio_maintain_pitch(false)
+{
+}
+
 Decoder::Decoder()
 {
+}
 
+Decoder::~Decoder()
+{
+}
+
+void Decoder::SetReversed(bool)
+{
+}
+
+void Decoder::SetFrameDiscard(AVDiscard)
+{
+}
+
+void Decoder::SetThreadCount(int)
+{
 }
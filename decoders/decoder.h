@@ -1,11 +1,260 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #ifndef DECODER_H
 #define DECODER_H
 
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QString>
+
+#include "rendering/pixelformats.h"
+
+/**
+ * @brief The DecoderParams struct
+ *
+ * Everything a Decoder needs to know to open a stream and conform its output for the rest of the pipeline. Sent to
+ * Decoder::Open().
+ */
+struct DecoderParams {
+  DecoderParams();
+
+  /**
+   * @brief File to open
+   */
+  QString filename;
+
+  /**
+   * @brief Index of the stream in the file to decode
+   */
+  int stream_index;
+
+  /**
+   * @brief For image sequences that don't start at 0, the index where it does start. Leave as 0 for all other media.
+   */
+  int start_number;
+
+  /**
+   * @brief Interlacing mode of a video stream (a VideoInterlacingMode value)
+   *
+   * If this is not VIDEO_PROGRESSIVE, video frames will be deinterlaced.
+   */
+  int video_interlacing;
+
+  /**
+   * @brief Whether planar YUV video can be retrieved as-is
+   *
+   * If **TRUE** and the stream is in a supported planar YUV format, frames are retrieved in that format for the GPU to
+   * convert to RGB. Otherwise (or if the format isn't supported) frames are converted to RGBA on the CPU.
+   */
+  bool video_native_yuv;
+
+  /**
+   * @brief Amount to divide the width and height of video frames by (1 for full resolution)
+   *
+   * Used for reduced resolution playback. width() and height() return the divided size.
+   */
+  int video_divider;
+
+  /**
+   * @brief Number of threads to decode with, or 0 to let FFmpeg decide
+   *
+   * Usually set from the DecodeScheduler allocation so concurrent decoders don't oversubscribe the CPU.
+   */
+  int threads;
+
+  /**
+   * @brief Sample rate to conform audio to
+   */
+  int audio_sample_rate;
+
+  /**
+   * @brief Speed to play audio at (1.0 being normal speed)
+   */
+  double audio_speed;
 
+  /**
+   * @brief Whether to preserve pitch if audio_speed is not 1.0
+   *
+   * If **TRUE**, audio is time-stretched. If **FALSE**, audio is resampled which will change its pitch.
+   */
+  bool audio_maintain_pitch;
+};
+
+/**
+ * @brief The Decoder class
+ *
+ * An abstract interface for decoding a single stream of a media file into frames ready for the rest of the pipeline
+ * (RGBA or, if requested, planar YUV for video and stereo planar float for audio).
+ *
+ * Decoder has no knowledge of Clips, Sequences, threads or OpenGL. It's intended to be driven by a Cacher (which
+ * handles queueing and threading) but can be used on its own, e.g. for benchmarking decode performance.
+ *
+ * Functions returning an `int` return an FFmpeg error code (>= 0 on success, a negative error code on failure).
+ * AVERROR_EOF is returned when the end of the stream has been reached, which is not technically an error.
+ *
+ * Decoder is not thread-safe. Each Decoder should only be used from one thread at a time.
+ */
 class Decoder
 {
 public:
   Decoder();
+
+  virtual ~Decoder();
+
+  /**
+   * @brief Open a stream for decoding
+   *
+   * @param params
+   *
+   * Parameters describing which stream to open and how its output should be conformed
+   *
+   * @param error
+   *
+   * If not `nullptr`, set to a human-readable error if the stream couldn't be opened.
+   *
+   * @return
+   *
+   * **TRUE** if the stream was opened successfully and is ready for decoding.
+   */
+  virtual bool Open(const DecoderParams& params, QString* error = nullptr) = 0;
+
+  /**
+   * @brief Close the stream and free any resources opened by Open()
+   *
+   * Safe to call if the Decoder isn't open.
+   */
+  virtual void Close() = 0;
+
+  /**
+   * @brief Returns whether the Decoder has been opened successfully
+   */
+  virtual bool IsOpen() = 0;
+
+  /**
+   * @brief Seek the stream
+   *
+   * After seeking, the next frame retrieved will be at or before `timestamp` (if the media seeks accurately).
+   *
+   * @param timestamp
+   *
+   * Timestamp to seek to in terms of time_base()
+   */
+  virtual void Seek(int64_t timestamp) = 0;
+
+  /**
+   * @brief Retrieve the next frame in the stream
+   *
+   * @param f
+   *
+   * An allocated AVFrame to receive the frame. Any data already referenced by it will be unreferenced.
+   */
+  virtual int RetrieveFrame(AVFrame* f) = 0;
+
+  /**
+   * @brief Retrieve a frame at or before a timestamp
+   *
+   * Seeks if necessary (and only if necessary) and returns the first frame that is at or before `timestamp`. Calling
+   * RetrieveFrame() afterwards will continue from this frame. If no frame at or before `timestamp` exists (e.g. the
+   * stream starts late), the earliest frame available is returned instead.
+   *
+   * @param timestamp
+   *
+   * Timestamp of the desired frame in terms of time_base()
+   *
+   * @param f
+   *
+   * An allocated AVFrame to receive the frame. Any data already referenced by it will be unreferenced.
+   */
+  virtual int RetrieveFrameAt(int64_t timestamp, AVFrame* f) = 0;
+
+  /**
+   * @brief Hint which direction frames are going to be requested in
+   *
+   * Decoders that decode ahead of time (e.g. ImageSequenceDecoder) use this to decode backwards during reversed
+   * playback. Does nothing by default.
+   *
+   * @param reversed
+   *
+   * **TRUE** if frames will be requested in descending timestamp order
+   */
+  virtual void SetReversed(bool reversed);
+
+  /**
+   * @brief Skip decoding some frames of a video stream
+   *
+   * Used when not every frame is going to be shown, e.g. while scrubbing or shuttling quickly. Skipped frames simply
+   * never come out of RetrieveFrame(). Decoders that can't skip frames (e.g. ImageSequenceDecoder, where every image
+   * is a keyframe) ignore this.
+   *
+   * After decoding with AVDISCARD_NONKEY, the frames following the last keyframe were never decoded, so the next frame
+   * must be retrieved with RetrieveFrameAt() to resume decoding every frame.
+   *
+   * @param discard
+   *
+   * AVDISCARD_DEFAULT to decode every frame, AVDISCARD_NONREF to skip frames no other frame depends on, or
+   * AVDISCARD_NONKEY to only decode keyframes
+   */
+  virtual void SetFrameDiscard(AVDiscard discard);
+
+  /**
+   * @brief Change how many threads the decoder uses
+   *
+   * Used when DecodeScheduler shares the cores out differently while the decoder is open. A codec's thread count can't
+   * be changed while it's decoding, so decoders apply it the next time they seek. Does nothing by default.
+   *
+   * @param threads
+   *
+   * Number of threads to decode with, or 0 to let the decoder decide
+   */
+  virtual void SetThreadCount(int threads);
+
+  /**
+   * @brief Width of a video stream's frames
+   */
+  virtual int width() = 0;
+
+  /**
+   * @brief Height of a video stream's frames
+   */
+  virtual int height() = 0;
+
+  /**
+   * @brief Time base of the stream's timestamps
+   */
+  virtual AVRational time_base() = 0;
+
+  /**
+   * @brief Timestamp of the start of the stream (or AV_NOPTS_VALUE if unknown)
+   */
+  virtual int64_t start_time() = 0;
+
+  /**
+   * @brief Pixel format that video frames will be retrieved in
+   *
+   * If frames are retrieved in planar YUV (see DecoderParams::video_native_yuv), this is the format they should be
+   * converted to instead.
+   */
+  virtual olive::PixelFormat pixel_format() = 0;
 };
 
-#endif // DECODER_H
\ No newline at end of file
+#endif // DECODER_H
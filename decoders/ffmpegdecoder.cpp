@@ -1,6 +1,611 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #include "ffmpegdecoder.h"
 
-FFmpegDecoder::FFmpegDecoder()
+#ifndef __STDC_FORMAT_MACROS
+// For some reason the Windows AppVeyor build fails to find PRIx64 without this definition and including
+// <inttypes.h> Maybe something to do with the GCC version being used? Either way, that's why it's here.
+#define __STDC_FORMAT_MACROS 1
+#endif
+
+#include <inttypes.h>
+
+extern "C" {
+#include <libavfilter/buffersrc.h>
+#include <libavfilter/buffersink.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
+}
+
+#include <QtMath>
+
+#include "project/footage.h"
+#include "global/debug.h"
+
+const AVSampleFormat kDestSampleFmt = AV_SAMPLE_FMT_FLTP;
+
+/**
+ * @brief Returns whether frames in this pixel format can be uploaded as-is and converted to RGB on the GPU
+ *
+ * Supports 8 to 16-bit planar YUV with one plane per component (e.g. yuv420p, yuv422p10le, yuv444p12le). Formats with
+ * alpha, interleaved chroma (e.g. nv12) or MSB-aligned samples (e.g. p010) are converted on the CPU instead.
+ */
+bool IsNativeYUVFormat(AVPixelFormat pix_fmt) {
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+
+  if (desc == nullptr
+      || desc->nb_components != 3
+      || !(desc->flags & AV_PIX_FMT_FLAG_PLANAR)
+      || (desc->flags & (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_BE))) {
+    return false;
+  }
+
+  int depth = desc->comp[0].depth;
+  if (depth < 8 || depth > 16) {
+    return false;
+  }
+
+  int bytes_per_sample = (depth > 8) ? 2 : 1;
+
+  for (int i=0;i<3;i++) {
+    const AVComponentDescriptor& comp = desc->comp[i];
+
+    if (comp.plane != i
+        || comp.depth != depth
+        || comp.step != bytes_per_sample
+        || comp.offset != 0
+        || comp.shift != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+FFmpegDecoder::FFmpegDecoder() :
+  ctx_(nullptr),
+  pkt_(nullptr),
+  frame_(nullptr),
+  thread_count_(0),
+  pixel_format_(olive::PIX_FMT_RGBA8),
+  output_width_(0),
+  output_height_(0)
+{
+}
+
+FFmpegDecoder::~FFmpegDecoder()
+{
+  Close();
+}
+
+bool FFmpegDecoder::Open(const DecoderParams &params, QString *error)
+{
+  Close();
+
+  // lease file and decoder handles from the pool, which will re-use the ones a previous decoder left open if it can
+  ctx_ = olive::decoder_pool.Lease(params.filename,
+                                   params.stream_index,
+                                   params.start_number,
+                                   params.threads,
+                                   error);
+  if (ctx_ == nullptr) {
+    return false;
+  }
+
+  // a context from the pool may have been opened with a different thread count, it's changed on the next seek so a
+  // decoder continuing from where the last lessee left off doesn't have to start over
+  thread_count_ = params.threads;
+
+  params_ = params;
+
+  pkt_ = av_packet_alloc();
+  frame_ = av_frame_alloc();
+
+  SetupFilterGraph(params);
+
+  // unless we can continue from where the last lessee stopped, whatever it left in a re-used filter stack is stale
+  if (ctx_->last_pts == AV_NOPTS_VALUE) {
+    ResetFilterGraph();
+  }
+
+  return true;
+}
+
+void FFmpegDecoder::Close()
+{
+  if (ctx_ == nullptr) {
+    return;
+  }
+
+  av_frame_free(&frame_);
+  av_packet_free(&pkt_);
+
+  // the next lessee expects every frame to be decoded
+  SetFrameDiscard(AVDISCARD_DEFAULT);
+
+  // hand the file and decoder back to the pool so another decoder using the same file can pick them up
+  olive::decoder_pool.Return(ctx_);
+  ctx_ = nullptr;
+}
+
+bool FFmpegDecoder::IsOpen()
+{
+  return (ctx_ != nullptr);
+}
+
+void FFmpegDecoder::Seek(int64_t timestamp)
+{
+  avcodec_flush_buffers(ctx_->codec_ctx);
+  olive::decoder_pool.SetThreadCount(ctx_, thread_count_);
+  av_seek_frame(ctx_->format_ctx, ctx_->stream_index, timestamp, AVSEEK_FLAG_BACKWARD);
+  ResetFilterGraph();
+
+  // we don't know exactly where the decoder is anymore
+  ctx_->last_pts = AV_NOPTS_VALUE;
+}
+
+void FFmpegDecoder::SeekToKeyframe(const PacketIndexEntry &keyframe)
+{
+  avcodec_flush_buffers(ctx_->codec_ctx);
+  olive::decoder_pool.SetThreadCount(ctx_, thread_count_);
+
+  const AVInputFormat* format = ctx_->format_ctx->iformat;
+
+  // seeking by byte offset goes straight to the packet, but not every demuxer supports it
+  bool seeked = false;
+  if (keyframe.pos >= 0 && !(format->flags & AVFMT_NO_BYTE_SEEK)) {
+    seeked = (av_seek_frame(ctx_->format_ctx, ctx_->stream_index, keyframe.pos, AVSEEK_FLAG_BYTE) >= 0);
+  }
+
+  // otherwise seek to the keyframe's exact timestamp, which demuxers with their own index resolve precisely
+  if (!seeked) {
+    int64_t ts = ((format->flags & AVFMT_SEEK_TO_PTS) || keyframe.dts == AV_NOPTS_VALUE) ? keyframe.pts : keyframe.dts;
+    av_seek_frame(ctx_->format_ctx, ctx_->stream_index, ts, AVSEEK_FLAG_BACKWARD);
+  }
+
+  ResetFilterGraph();
+
+  ctx_->last_pts = AV_NOPTS_VALUE;
+}
+
+int FFmpegDecoder::RetrieveFrame(AVFrame *f)
+{
+  // error codes from FFmpeg
+  int retrieve_code;
+  int read_code = 0;
+  int send_code;
+
+  av_frame_unref(f);
+
+  // loop to pull frames from the AVFilter stack
+  while ((retrieve_code = av_buffersink_get_frame(ctx_->buffersink_ctx, f)) == AVERROR(EAGAIN)) {
+
+    // retrieve frame from decoder
+    read_code = RetrieveFrameFromDecoder(frame_);
+
+    if (read_code >= 0) {
+
+      // we retrieved a decoded frame, which we will send to the AVFilter stack to convert to the pipeline's format
+      // (with other adjustments if necessary)
+
+      if ((send_code = av_buffersrc_add_frame_flags(ctx_->buffersrc_ctx, frame_, AV_BUFFERSRC_FLAG_KEEP_REF)) < 0) {
+        qCritical() << "Failed to add frame to buffer source." << send_code;
+        retrieve_code = send_code;
+        break;
+      }
+
+      ctx_->filter_graph_fed = true;
+
+    } else {
+
+      // AVERROR_EOF means we've reached the end of the file, not technically an error, but it's useful to know that
+      // there are no more frames in this file
+      if (read_code != AVERROR_EOF) {
+        qCritical() << "Failed to read frame." << read_code;
+      }
+      retrieve_code = read_code;
+      break;
+    }
+  }
+
+  // keep track of where a video decoder is in case the pool hands it to another decoder later (audio timestamps
+  // coming out of the filter stack may be in a different timebase, so we don't track those)
+  if (retrieve_code >= 0 && ctx_->stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    ctx_->last_pts = f->pts;
+  } else {
+    ctx_->last_pts = AV_NOPTS_VALUE;
+  }
+
+  return retrieve_code;
+}
+
+int FFmpegDecoder::RetrieveFrameAt(int64_t timestamp, AVFrame *f)
+{
+  // get the value of one second in terms of the stream's timebase
+  int64_t second_pts = qRound64(av_q2d(av_inv_q(time_base())));
+
+  // If the decoder stopped shortly before this timestamp (e.g. it was handed over from the previous half of a razor
+  // cut), it's faster to keep decoding from where it left off than to seek
+  if (ctx_->last_pts != AV_NOPTS_VALUE
+      && timestamp > ctx_->last_pts
+      && timestamp <= ctx_->last_pts + second_pts) {
+    return RetrieveFrame(f);
+  }
+
+  int retrieve_code;
+
+  // If we have an index of this stream, we know exactly which keyframe to decode from
+  if (ctx_->packet_index != nullptr) {
+    const PacketIndexEntry* keyframe = ctx_->packet_index->GetKeyframeFor(timestamp);
+
+    if (keyframe != nullptr) {
+      SeekToKeyframe(*keyframe);
+
+      retrieve_code = RetrieveFrame(f);
+
+      if (retrieve_code < 0 || f->pts <= timestamp) {
+        return retrieve_code;
+      }
+
+      // the demuxer didn't land where the index said it would, fall back to seeking without it
+      qWarning() << "Packet index seek landed after target" << timestamp << "- got" << f->pts;
+    }
+  }
+
+  int64_t seek_ts = timestamp;
+  int64_t zero = 0;
+  bool seeked_to_zero;
+
+  // Some formats don't seek reliably to the last keyframe, as a result we need to seek in a loop to ensure we
+  // get a frame prior to the timestamp
+  do {
+
+    // If we already seeked to a timestamp of zero, there's no further we can go, so we have to exit the loop if so
+    seeked_to_zero = (seek_ts == 0);
+
+    Seek(seek_ts);
+
+    retrieve_code = RetrieveFrame(f);
+
+    seek_ts = qMax(zero, seek_ts - second_pts);
+
+  } while (retrieve_code >= 0 && f->pts > timestamp && !seeked_to_zero);
+
+  return retrieve_code;
+}
+
+void FFmpegDecoder::SetFrameDiscard(AVDiscard discard)
+{
+  if (ctx_->codec_ctx->skip_frame == discard) {
+    return;
+  }
+
+  ctx_->codec_ctx->skip_frame = discard;
+
+  // frames already sent to the decoder were decoded (or skipped) with the previous setting, so make sure the next
+  // RetrieveFrameAt() seeks rather than continuing from here
+  ctx_->last_pts = AV_NOPTS_VALUE;
+}
+
+void FFmpegDecoder::SetThreadCount(int threads)
+{
+  thread_count_ = threads;
+}
+
+int FFmpegDecoder::width()
+{
+  return output_width_;
+}
+
+int FFmpegDecoder::height()
+{
+  return output_height_;
+}
+
+AVRational FFmpegDecoder::time_base()
+{
+  return ctx_->stream->time_base;
+}
+
+int64_t FFmpegDecoder::start_time()
+{
+  return ctx_->stream->start_time;
+}
+
+olive::PixelFormat FFmpegDecoder::pixel_format()
+{
+  return pixel_format_;
+}
+
+const AVFrame *FFmpegDecoder::last_decoded_frame()
+{
+  return frame_;
+}
+
+void FFmpegDecoder::SetupFilterGraph(const DecoderParams &params)
+{
+  AVStream* stream = ctx_->stream;
+  AVCodecContext* codecCtx = ctx_->codec_ctx;
+
+  // determine whether the filter graph the decoder already has (if any) was built the same way we need it
+  QString filter_signature;
+  bool native_yuv = false;
+  if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    native_yuv = params.video_native_yuv && IsNativeYUVFormat(static_cast<AVPixelFormat>(stream->codecpar->format));
+
+    // reduced resolution frames are kept at an even size so subsampled chroma planes line up
+    if (params.video_divider > 1) {
+      output_width_ = qMax(2, (stream->codecpar->width / params.video_divider) & ~1);
+      output_height_ = qMax(2, (stream->codecpar->height / params.video_divider) & ~1);
+    } else {
+      output_width_ = stream->codecpar->width;
+      output_height_ = stream->codecpar->height;
+    }
+
+    filter_signature = QString("video:%1:%2:%3").arg(QString::number(params.video_interlacing),
+                                                     QString::number(native_yuv),
+                                                     QString::number(params.video_divider));
+  } else {
+    filter_signature = QString("audio:%1:%2:%3").arg(QString::number(params.audio_speed, 'f', 10),
+                                                     QString::number(params.audio_maintain_pitch),
+                                                     QString::number(params.audio_sample_rate));
+  }
+
+  bool reuse_filter_graph = (ctx_->filter_graph != nullptr && ctx_->filter_signature == filter_signature);
+
+  AVFilterGraph* filter_graph = ctx_->filter_graph;
+  AVFilterContext* buffersrc_ctx = ctx_->buffersrc_ctx;
+  AVFilterContext* buffersink_ctx = ctx_->buffersink_ctx;
+
+  if (!reuse_filter_graph) {
+    if (filter_graph != nullptr) {
+      avfilter_graph_free(&filter_graph);
+    }
+
+    // allocate filtergraph
+    filter_graph = avfilter_graph_alloc();
+    if (filter_graph == nullptr) {
+      qCritical() << "Could not create filtergraph";
+    }
+
+    ctx_->filter_graph_fed = false;
+  }
+
+  char filter_args[512];
+
+  if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    AVPixelFormat possible_pix_fmts[] = {
+      AV_PIX_FMT_RGBA,
+      AV_PIX_FMT_RGBA64,
+      AV_PIX_FMT_NONE
+    };
+
+    AVPixelFormat pix_fmt = avcodec_find_best_pix_fmt_of_list(possible_pix_fmts,
+                                                              static_cast<AVPixelFormat>(stream->codecpar->format),
+                                                              1,
+                                                              nullptr);
+
+    if (pix_fmt == AV_PIX_FMT_RGBA) {
+      qDebug() << "This is an 8-bit image.";
+      pixel_format_ = olive::PIX_FMT_RGBA8;
+    } else {
+      qDebug() << "This is an HDR image.";
+      pixel_format_ = olive::PIX_FMT_RGBA16;
+    }
+
+    // keep planar YUV as it is, the GPU converts it to pixel_format_ later
+    if (native_yuv) {
+      pix_fmt = static_cast<AVPixelFormat>(stream->codecpar->format);
+    }
+
+    if (!reuse_filter_graph) {
+      snprintf(filter_args, sizeof(filter_args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
+               stream->codecpar->width,
+               stream->codecpar->height,
+               stream->codecpar->format,
+               stream->time_base.num,
+               stream->time_base.den,
+               stream->codecpar->sample_aspect_ratio.num,
+               stream->codecpar->sample_aspect_ratio.den
+               );
+
+      avfilter_graph_create_filter(&buffersrc_ctx, avfilter_get_by_name("buffer"), "in", filter_args, nullptr, filter_graph);
+      avfilter_graph_create_filter(&buffersink_ctx, avfilter_get_by_name("buffersink"), "out", nullptr, nullptr, filter_graph);
+
+      AVFilterContext* last_filter = buffersrc_ctx;
+
+      if (params.video_interlacing != VIDEO_PROGRESSIVE) {
+        AVFilterContext* yadif_filter;
+        snprintf(filter_args, sizeof(filter_args), "mode=3:parity=%d", ((params.video_interlacing == VIDEO_TOP_FIELD_FIRST) ? 0 : 1)); // there's a CUDA version if we start using nvdec/nvenc
+        avfilter_graph_create_filter(&yadif_filter, avfilter_get_by_name("yadif"), "yadif", filter_args, nullptr, filter_graph);
+
+        avfilter_link(last_filter, 0, yadif_filter, 0);
+        last_filter = yadif_filter;
+      }
+
+      if (output_width_ != stream->codecpar->width || output_height_ != stream->codecpar->height) {
+        AVFilterContext* scale_filter;
+        snprintf(filter_args, sizeof(filter_args), "w=%d:h=%d:flags=fast_bilinear", output_width_, output_height_);
+        avfilter_graph_create_filter(&scale_filter, avfilter_get_by_name("scale"), "scale", filter_args, nullptr, filter_graph);
+
+        avfilter_link(last_filter, 0, scale_filter, 0);
+        last_filter = scale_filter;
+      }
+
+      const char* chosen_format = av_get_pix_fmt_name(pix_fmt);
+      snprintf(filter_args, sizeof(filter_args), "pix_fmts=%s", chosen_format);
+
+      AVFilterContext* format_conv;
+      avfilter_graph_create_filter(&format_conv, avfilter_get_by_name("format"), "fmt", filter_args, nullptr, filter_graph);
+      avfilter_link(last_filter, 0, format_conv, 0);
+
+      avfilter_link(format_conv, 0, buffersink_ctx, 0);
+
+      avfilter_graph_config(filter_graph, nullptr);
+
+      // yadif outputs each frame using the ones around it
+      ctx_->filter_graph_stateful = (params.video_interlacing != VIDEO_PROGRESSIVE);
+    }
+
+  } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
+    if (codecCtx->channel_layout == 0) codecCtx->channel_layout = av_get_default_channel_layout(stream->codecpar->channels);
+
+    if (!reuse_filter_graph) {
+      snprintf(filter_args, sizeof(filter_args), "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%" PRIx64,
+               stream->time_base.num,
+               stream->time_base.den,
+               stream->codecpar->sample_rate,
+               av_get_sample_fmt_name(codecCtx->sample_fmt),
+               codecCtx->channel_layout
+               );
+
+      avfilter_graph_create_filter(&buffersrc_ctx, avfilter_get_by_name("abuffer"), "in", filter_args, nullptr, filter_graph);
+      avfilter_graph_create_filter(&buffersink_ctx, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, filter_graph);
+
+      enum AVSampleFormat sample_fmts[] = { kDestSampleFmt,  static_cast<AVSampleFormat>(-1) };
+      if (av_opt_set_int_list(buffersink_ctx, "sample_fmts", sample_fmts, -1, AV_OPT_SEARCH_CHILDREN) < 0) {
+        qCritical() << "Could not set output sample format";
+      }
+
+      int64_t channel_layouts[] = { AV_CH_LAYOUT_STEREO, static_cast<AVSampleFormat>(-1) };
+      if (av_opt_set_int_list(buffersink_ctx, "channel_layouts", channel_layouts, -1, AV_OPT_SEARCH_CHILDREN) < 0) {
+        qCritical() << "Could not set output sample format";
+      }
+
+      int target_sample_rate = params.audio_sample_rate;
+
+      double playback_speed = params.audio_speed;
+
+      if (qFuzzyCompare(playback_speed, 1.0)) {
+        avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
+      } else if (params.audio_maintain_pitch) {
+        AVFilterContext* previous_filter = buffersrc_ctx;
+        AVFilterContext* last_filter = buffersrc_ctx;
+
+        char speed_param[10];
+
+        double base = (playback_speed > 1.0) ? 2.0 : 0.5;
+
+        double speedlog = log(playback_speed) / log(base);
+        int whole2 = qFloor(speedlog);
+        speedlog -= whole2;
+
+        if (whole2 > 0) {
+          snprintf(speed_param, sizeof(speed_param), "%f", base);
+          for (int i=0;i<whole2;i++) {
+            AVFilterContext* tempo_filter = nullptr;
+            avfilter_graph_create_filter(&tempo_filter, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, filter_graph);
+            avfilter_link(previous_filter, 0, tempo_filter, 0);
+            previous_filter = tempo_filter;
+          }
+        }
+
+        snprintf(speed_param, sizeof(speed_param), "%f", qPow(base, speedlog));
+        last_filter = nullptr;
+        avfilter_graph_create_filter(&last_filter, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, filter_graph);
+        avfilter_link(previous_filter, 0, last_filter, 0);
+
+        avfilter_link(last_filter, 0, buffersink_ctx, 0);
+      } else {
+        target_sample_rate = qRound64(target_sample_rate / playback_speed);
+        avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
+      }
+
+      int sample_rates[] = { target_sample_rate, 0 };
+      if (av_opt_set_int_list(buffersink_ctx, "sample_rates", sample_rates, 0, AV_OPT_SEARCH_CHILDREN) < 0) {
+        qCritical() << "Could not set output sample rates";
+      }
+
+      avfilter_graph_config(filter_graph, nullptr);
+
+      // resampling and atempo both hold on to samples between frames
+      ctx_->filter_graph_stateful = true;
+    }
+  }
+
+  // the filter stack is kept with the decoder context so the next decoder for this stream can re-use it
+  ctx_->filter_graph = filter_graph;
+  ctx_->buffersrc_ctx = buffersrc_ctx;
+  ctx_->buffersink_ctx = buffersink_ctx;
+  ctx_->filter_signature = filter_signature;
+}
+
+void FFmpegDecoder::ResetFilterGraph()
 {
+  if (!ctx_->filter_graph_fed) {
+    return;
+  }
+
+  if (ctx_->filter_graph_stateful) {
+    // there's no way to flush a stateful filter without ending its stream, so build a new stack instead
+    avfilter_graph_free(&ctx_->filter_graph);
+    SetupFilterGraph(params_);
+  } else {
+    // pull out any frames still waiting in the stack
+    while (av_buffersink_get_frame(ctx_->buffersink_ctx, frame_) >= 0) {
+      av_frame_unref(frame_);
+    }
+
+    ctx_->filter_graph_fed = false;
+  }
+}
+
+int FFmpegDecoder::RetrieveFrameFromDecoder(AVFrame* f) {
+  int result = 0;
+  int receive_ret;
+
+  // do we need to retrieve a new packet for a new frame?
+  av_frame_unref(f);
+  while ((receive_ret = avcodec_receive_frame(ctx_->codec_ctx, f)) == AVERROR(EAGAIN)) {
+    int read_ret = 0;
+    do {
+      if (pkt_->buf != nullptr) {
+        av_packet_unref(pkt_);
+      }
+      read_ret = av_read_frame(ctx_->format_ctx, pkt_);
+    } while (read_ret >= 0 && pkt_->stream_index != ctx_->stream_index);
+
+    if (read_ret >= 0) {
+      int send_ret = avcodec_send_packet(ctx_->codec_ctx, pkt_);
+      if (send_ret < 0) {
+        qCritical() << "Failed to send packet to decoder." << send_ret;
+        return send_ret;
+      }
+    } else {
+      if (read_ret == AVERROR_EOF) {
+        int send_ret = avcodec_send_packet(ctx_->codec_ctx, nullptr);
+        if (send_ret < 0) {
+          qCritical() << "Failed to send packet to decoder." << send_ret;
+          return send_ret;
+        }
+      } else {
+        qCritical() << "Could not read frame." << read_ret;
+        return read_ret; // skips trying to find a frame at all
+      }
+    }
+  }
+  if (receive_ret < 0) {
+    if (receive_ret != AVERROR_EOF) qCritical() << "Failed to receive packet from decoder." << receive_ret;
+    result = receive_ret;
+  }
 
+  return result;
 }
@@ -1,11 +1,146 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
 #ifndef FFMPEGDECODER_H
 #define FFMPEGDECODER_H
 
+#include "decoders/decoder.h"
+#include "rendering/decoderpool.h"
 
-class FFmpegDecoder
+/**
+ * @brief The FFmpegDecoder class
+ *
+ * Decoder implementation using libavformat/libavcodec for demuxing and decoding, and libavfilter for conforming the
+ * decoded frames (pixel format conversion and deinterlacing for video, sample format conversion and speed changes for
+ * audio).
+ *
+ * The file and decoder handles are leased from olive::decoder_pool in Open() and returned to it in Close(), so
+ * consecutive FFmpegDecoder objects opening the same stream will re-use the same handles (and filter stack if it was
+ * built with the same parameters). Anything the previous lessee left in the filter stack is discarded unless the new
+ * lessee continues decoding from where it stopped.
+ */
+class FFmpegDecoder : public Decoder
 {
 public:
   FFmpegDecoder();
+
+  virtual ~FFmpegDecoder() override;
+
+  virtual bool Open(const DecoderParams& params, QString* error = nullptr) override;
+  virtual void Close() override;
+  virtual bool IsOpen() override;
+
+  virtual void Seek(int64_t timestamp) override;
+
+  virtual int RetrieveFrame(AVFrame* f) override;
+  virtual int RetrieveFrameAt(int64_t timestamp, AVFrame* f) override;
+
+  virtual void SetFrameDiscard(AVDiscard discard) override;
+  virtual void SetThreadCount(int threads) override;
+
+  virtual int width() override;
+  virtual int height() override;
+  virtual AVRational time_base() override;
+  virtual int64_t start_time() override;
+  virtual olive::PixelFormat pixel_format() override;
+
+  /**
+   * @brief Returns the last raw frame that came out of the decoder (before the filter stack)
+   *
+   * Some audio operations (e.g. stitching reversed audio together) need the timing information of the source frame
+   * rather than the conformed one.
+   */
+  const AVFrame* last_decoded_frame();
+
+private:
+  /**
+   * @brief Internal function to set up the AVFilter stack for the current stream
+   *
+   * Re-uses the filter stack the decoder context already has if it was built with the same parameters.
+   */
+  void SetupFilterGraph(const DecoderParams& params);
+
+  /**
+   * @brief Internal function to discard everything the filter stack holds from before a seek
+   *
+   * Stateful filter stacks (see DecoderContext::filter_graph_stateful) are rebuilt, others are drained.
+   */
+  void ResetFilterGraph();
+
+  /**
+   * @brief Internal function to seek directly to a keyframe from the stream's PacketIndex
+   */
+  void SeekToKeyframe(const PacketIndexEntry& keyframe);
+
+  /**
+   * @brief Retrieve frame from decoder
+   *
+   * Retrieves the next decoded frame from the decoder. Depending on the source media, this frame may or may not be
+   * suitable for usage later in the pipeline as it may or may not be the correct pixel/sample format. For a suitable
+   * frame for the pipeline, use RetrieveFrame() instead (which in turn uses this function anyway).
+   *
+   * @param f
+   *
+   * Frame buffer to decode frame into
+   *
+   * @return
+   *
+   * FFmpeg error code (>= 0 on success, a negative error code on failure)
+   */
+  int RetrieveFrameFromDecoder(AVFrame* f);
+
+  /**
+   * @brief Decoder context leased from olive::decoder_pool, or `nullptr` if the decoder isn't open
+   */
+  DecoderContext* ctx_;
+
+  /**
+   * @brief Parameters the decoder was opened with, kept to rebuild the filter stack after a seek
+   */
+  DecoderParams params_;
+
+  /**
+   * @brief FFmpeg packet - used for media decoding
+   */
+  AVPacket* pkt_;
+
+  /**
+   * @brief Raw decoded frame before it goes through the AVFilter stack
+   */
+  AVFrame* frame_;
+
+  /**
+   * @brief Number of threads the codec should be using, applied to the decoder context on the next seek
+   */
+  int thread_count_;
+
+  /**
+   * @brief Pixel format video frames are conformed to
+   */
+  olive::PixelFormat pixel_format_;
+
+  /**
+   * @brief Size video frames are scaled to (see DecoderParams::video_divider)
+   */
+  int output_width_;
+  int output_height_;
 };
 
-#endif // FFMPEGDECODER_H
\ No newline at end of file
+#endif // FFMPEGDECODER_H
@@ -0,0 +1,479 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "imagesequencedecoder.h"
+
+extern "C" {
+#include <libswscale/swscale.h>
+}
+
+#include <QCoreApplication>
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QDebug>
+
+#include "rendering/decoderpool.h"
+#include "rendering/framepool.h"
+
+// the longest filename an image in a sequence can have (the same limit FFmpeg's image2 demuxer uses)
+const int kMaxImageFilenameLength = 1024;
+
+/**
+ * @brief Thread pool shared by all image sequence decoders
+ */
+QThreadPool* ImageSequenceThreadPool() {
+  static QThreadPool pool;
+  return &pool;
+}
+
+/**
+ * @brief Decode a single image file and convert it to a certain pixel format and size
+ *
+ * @return
+ *
+ * FFmpeg error code (>= 0 on success, a negative error code on failure)
+ */
+int DecodeImage(const char* filename, int width, int height, AVPixelFormat pix_fmt, AVFrame* dst) {
+  AVFormatContext* fmt_ctx = nullptr;
+
+  int ret = avformat_open_input(&fmt_ctx, filename, nullptr, nullptr);
+  if (ret < 0) {
+    return ret;
+  }
+
+  if (fmt_ctx->nb_streams < 1) {
+    avformat_close_input(&fmt_ctx);
+    return AVERROR_INVALIDDATA;
+  }
+
+  AVCodec* codec = avcodec_find_decoder(fmt_ctx->streams[0]->codecpar->codec_id);
+  AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+  AVPacket* pkt = av_packet_alloc();
+  AVFrame* src = av_frame_alloc();
+
+  // each image is already decoded on its own thread, so the codec doesn't need any of its own
+  AVDictionary* opts = nullptr;
+  av_dict_set(&opts, "threads", "1", 0);
+
+  // an image file is one packet
+  if (codec == nullptr) {
+    ret = AVERROR_DECODER_NOT_FOUND;
+  } else if ((ret = avcodec_parameters_to_context(codec_ctx, fmt_ctx->streams[0]->codecpar)) >= 0
+             && (ret = avcodec_open2(codec_ctx, codec, &opts)) >= 0
+             && (ret = av_read_frame(fmt_ctx, pkt)) >= 0
+             && (ret = avcodec_send_packet(codec_ctx, pkt)) >= 0) {
+    ret = avcodec_receive_frame(codec_ctx, src);
+
+    // some decoders only output the frame once they've been flushed
+    if (ret == AVERROR(EAGAIN)) {
+      avcodec_send_packet(codec_ctx, nullptr);
+      ret = avcodec_receive_frame(codec_ctx, src);
+    }
+  }
+
+  av_dict_free(&opts);
+
+  if (ret >= 0) {
+    // convert to the pipeline's format the same way libavfilter's format filter would
+    SwsContext* sws_ctx = sws_getContext(src->width,
+                                         src->height,
+                                         static_cast<AVPixelFormat>(src->format),
+                                         width,
+                                         height,
+                                         pix_fmt,
+                                         SWS_BICUBIC,
+                                         nullptr,
+                                         nullptr,
+                                         nullptr);
+
+    av_frame_copy_props(dst, src);
+    dst->format = pix_fmt;
+    dst->width = width;
+    dst->height = height;
+
+    if (sws_ctx == nullptr) {
+      ret = AVERROR(EINVAL);
+    } else if ((ret = olive::frame_pool.GetFrameBuffer(dst)) >= 0) {
+      sws_scale(sws_ctx, src->data, src->linesize, 0, src->height, dst->data, dst->linesize);
+    }
+
+    sws_freeContext(sws_ctx);
+  }
+
+  av_frame_free(&src);
+  av_packet_free(&pkt);
+  avcodec_free_context(&codec_ctx);
+  avformat_close_input(&fmt_ctx);
+
+  return ret;
+}
+
+/**
+ * @brief The ImageSequenceJob class
+ *
+ * Decodes one image of a sequence on the shared thread pool for an ImageSequenceDecoder.
+ */
+class ImageSequenceJob : public QRunnable {
+public:
+  ImageSequenceJob(ImageSequenceDecoder* decoder, const QByteArray& filename, int64_t index) :
+    decoder_(decoder),
+    filename_(filename),
+    index_(index),
+    frame_(nullptr),
+    result_(0),
+    finished_(false),
+    cancelled_(false)
+  {
+    // the decoder manages the lifetime of its jobs
+    setAutoDelete(false);
+  }
+
+  virtual ~ImageSequenceJob() override {
+    olive::frame_pool.Release(frame_);
+  }
+
+  virtual void run() override {
+    decoder_->lock_.lock();
+    bool cancelled = cancelled_;
+    decoder_->lock_.unlock();
+
+    AVFrame* frame = nullptr;
+    int result = AVERROR_EXIT;
+
+    // don't bother decoding if the decoder has moved elsewhere since this job was queued
+    if (!cancelled) {
+      frame = olive::frame_pool.Get();
+
+      result = DecodeImage(filename_.constData(),
+                           decoder_->width_,
+                           decoder_->height_,
+                           decoder_->av_pixel_format_,
+                           frame);
+
+      if (result >= 0) {
+        frame->pts = index_;
+      } else {
+        olive::frame_pool.Release(frame);
+        frame = nullptr;
+
+        // like the image2 demuxer, a missing image is the end of the sequence
+        if (result == AVERROR(ENOENT)) {
+          result = AVERROR_EOF;
+        } else {
+          qWarning() << "Failed to decode image" << filename_ << result;
+        }
+      }
+    }
+
+    decoder_->lock_.lock();
+    frame_ = frame;
+    result_ = result;
+    finished_ = true;
+    decoder_->job_finished_.wakeAll();
+    decoder_->lock_.unlock();
+  }
+
+  ImageSequenceDecoder* decoder_;
+  QByteArray filename_;
+  int64_t index_;
+
+  // the following are protected by the decoder's lock
+  AVFrame* frame_;
+  int result_;
+  bool finished_;
+  bool cancelled_;
+};
+
+ImageSequenceDecoder::ImageSequenceDecoder() :
+  start_number_(0),
+  image_count_(0),
+  width_(0),
+  height_(0),
+  time_base_({0, 1}),
+  start_time_(AV_NOPTS_VALUE),
+  pixel_format_(olive::PIX_FMT_RGBA8),
+  av_pixel_format_(AV_PIX_FMT_RGBA),
+  read_ahead_(0),
+  reversed_(false),
+  index_(-1),
+  open_(false)
+{
+}
+
+ImageSequenceDecoder::~ImageSequenceDecoder()
+{
+  Close();
+}
+
+bool ImageSequenceDecoder::IsImageSequence(const QString &filename)
+{
+  char buf[kMaxImageFilenameLength];
+  return (av_get_frame_filename2(buf, sizeof(buf), filename.toUtf8().constData(), 0, 0) >= 0);
+}
+
+bool ImageSequenceDecoder::Open(const DecoderParams &params, QString *error)
+{
+  Close();
+
+  if (!IsImageSequence(params.filename)) {
+    if (error != nullptr) {
+      *error = QCoreApplication::translate("ImageSequenceDecoder", "%1 is not an image sequence").arg(params.filename);
+    }
+    return false;
+  }
+
+  // open the sequence with the image2 demuxer to get its properties exactly as FFmpegDecoder would see them (the
+  // context goes back to the pool afterwards, so this is usually free)
+  DecoderContext* ctx = olive::decoder_pool.Lease(params.filename,
+                                                  params.stream_index,
+                                                  params.start_number,
+                                                  params.threads,
+                                                  error);
+  if (ctx == nullptr) {
+    return false;
+  }
+
+  AVStream* stream = ctx->stream;
+
+  if (stream->codecpar->codec_type != AVMEDIA_TYPE_VIDEO) {
+    olive::decoder_pool.Return(ctx);
+    if (error != nullptr) {
+      *error = QCoreApplication::translate("ImageSequenceDecoder", "%1 is not a video stream").arg(params.filename);
+    }
+    return false;
+  }
+
+  width_ = stream->codecpar->width;
+  height_ = stream->codecpar->height;
+
+  // images are scaled down as they're converted for reduced resolution playback
+  if (params.video_divider > 1) {
+    width_ = qMax(2, (width_ / params.video_divider) & ~1);
+    height_ = qMax(2, (height_ / params.video_divider) & ~1);
+  }
+  time_base_ = stream->time_base;
+  start_time_ = stream->start_time;
+
+  // the image2 demuxer sets the duration to the amount of images
+  image_count_ = (stream->duration > 0) ? stream->duration : INT64_MAX;
+
+  AVPixelFormat possible_pix_fmts[] = {
+    AV_PIX_FMT_RGBA,
+    AV_PIX_FMT_RGBA64,
+    AV_PIX_FMT_NONE
+  };
+
+  av_pixel_format_ = avcodec_find_best_pix_fmt_of_list(possible_pix_fmts,
+                                                       static_cast<AVPixelFormat>(stream->codecpar->format),
+                                                       1,
+                                                       nullptr);
+
+  pixel_format_ = (av_pixel_format_ == AV_PIX_FMT_RGBA) ? olive::PIX_FMT_RGBA8 : olive::PIX_FMT_RGBA16;
+
+  olive::decoder_pool.Return(ctx);
+
+  pattern_ = params.filename.toUtf8();
+  start_number_ = params.start_number;
+  SetThreadCount(params.threads);
+  reversed_ = false;
+  index_ = -1;
+  open_ = true;
+
+  return true;
+}
+
+void ImageSequenceDecoder::Close()
+{
+  if (!open_) {
+    return;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  QMap<int64_t, ImageSequenceJob*>::iterator i;
+  for (i=jobs_.begin();i!=jobs_.end();i++) {
+    DiscardJob(i.value());
+  }
+  jobs_.clear();
+
+  // jobs still running reference this decoder, so we have to wait for them
+  FreeFinishedJobs();
+  while (!cancelled_jobs_.isEmpty()) {
+    job_finished_.wait(&lock_);
+    FreeFinishedJobs();
+  }
+
+  open_ = false;
+}
+
+bool ImageSequenceDecoder::IsOpen()
+{
+  return open_;
+}
+
+void ImageSequenceDecoder::Seek(int64_t timestamp)
+{
+  // the next image retrieved will be the one at this timestamp
+  index_ = timestamp - 1;
+}
+
+int ImageSequenceDecoder::RetrieveFrame(AVFrame *f)
+{
+  return RetrieveImage(index_ + 1, f);
+}
+
+int ImageSequenceDecoder::RetrieveFrameAt(int64_t timestamp, AVFrame *f)
+{
+  // every image is a "keyframe", so the frame at or before the timestamp is the image at that timestamp
+  return RetrieveImage(qBound(int64_t(0), timestamp, image_count_ - 1), f);
+}
+
+void ImageSequenceDecoder::SetReversed(bool reversed)
+{
+  reversed_ = reversed;
+}
+
+void ImageSequenceDecoder::SetThreadCount(int threads)
+{
+  // every image is decoded on its own, so the new amount of images in flight applies from the next read-ahead
+  read_ahead_ = qMax(2, (threads > 0) ? threads : QThread::idealThreadCount());
+}
+
+int ImageSequenceDecoder::width()
+{
+  return width_;
+}
+
+int ImageSequenceDecoder::height()
+{
+  return height_;
+}
+
+AVRational ImageSequenceDecoder::time_base()
+{
+  return time_base_;
+}
+
+int64_t ImageSequenceDecoder::start_time()
+{
+  return start_time_;
+}
+
+olive::PixelFormat ImageSequenceDecoder::pixel_format()
+{
+  return pixel_format_;
+}
+
+int ImageSequenceDecoder::RetrieveImage(int64_t index, AVFrame *f)
+{
+  av_frame_unref(f);
+
+  if (index < 0 || index >= image_count_) {
+    return AVERROR_EOF;
+  }
+
+  index_ = index;
+
+  QMutexLocker locker(&lock_);
+
+  ReadAhead(index);
+
+  ImageSequenceJob* job = jobs_.value(index);
+
+  // ReadAhead() doesn't queue anything if the pattern couldn't produce a filename for this image
+  if (job == nullptr) {
+    qWarning() << "Failed to get filename of image" << index << "from" << pattern_;
+    return AVERROR(EINVAL);
+  }
+
+  while (!job->finished_) {
+    job_finished_.wait(&lock_);
+  }
+
+  if (job->result_ < 0) {
+    return job->result_;
+  }
+
+  return av_frame_ref(f, job->frame_);
+}
+
+void ImageSequenceDecoder::ReadAhead(int64_t index)
+{
+  FreeFinishedJobs();
+
+  int64_t step = reversed_ ? -1 : 1;
+
+  // keep the images we're about to need, and the last one in case it gets requested again
+  QMap<int64_t, ImageSequenceJob*>::iterator i = jobs_.begin();
+  while (i != jobs_.end()) {
+    int64_t distance = (i.key() - index) * step;
+
+    if (distance < -1 || distance > read_ahead_) {
+      DiscardJob(i.value());
+      i = jobs_.erase(i);
+    } else {
+      i++;
+    }
+  }
+
+  // queue any images that aren't being decoded yet, the one needed now first
+  for (int j=0;j<=read_ahead_;j++) {
+    int64_t image = index + j * step;
+
+    if (image < 0 || image >= image_count_) {
+      break;
+    }
+
+    if (!jobs_.contains(image)) {
+      char filename[kMaxImageFilenameLength];
+
+      if (av_get_frame_filename2(filename, sizeof(filename), pattern_.constData(), start_number_ + int(image), 0) < 0) {
+        break;
+      }
+
+      ImageSequenceJob* job = new ImageSequenceJob(this, QByteArray(filename), image);
+      jobs_.insert(image, job);
+
+      ImageSequenceThreadPool()->start(job, (j == 0) ? 1 : 0);
+    }
+  }
+}
+
+void ImageSequenceDecoder::DiscardJob(ImageSequenceJob *job)
+{
+  if (job->finished_) {
+    delete job;
+  } else {
+    job->cancelled_ = true;
+    cancelled_jobs_.append(job);
+  }
+}
+
+void ImageSequenceDecoder::FreeFinishedJobs()
+{
+  for (int i=0;i<cancelled_jobs_.size();i++) {
+    if (cancelled_jobs_.at(i)->finished_) {
+      delete cancelled_jobs_.at(i);
+      cancelled_jobs_.removeAt(i);
+      i--;
+    }
+  }
+}
@@ -0,0 +1,170 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef IMAGESEQUENCEDECODER_H
+#define IMAGESEQUENCEDECODER_H
+
+#include <QMap>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+
+#include "decoders/decoder.h"
+
+class ImageSequenceJob;
+
+/**
+ * @brief The ImageSequenceDecoder class
+ *
+ * Decoder implementation for image sequences (footage with a `%Nd` pattern in its URL). FFmpeg's image2 demuxer reads
+ * and decodes one image at a time, which for large PNG/TIFF/DPX frames is far too slow for real-time playback even on
+ * machines with many cores. Since every image in a sequence is independent, ImageSequenceDecoder instead decodes
+ * several upcoming images at once on a shared thread pool and hands them back in order.
+ *
+ * The amount of images decoded ahead is the thread count in DecoderParams (or the core count if it's 0). Read-ahead
+ * follows the direction set with SetReversed().
+ *
+ * Timestamps match those of the image2 demuxer (the index of the image in the sequence in terms of the stream's
+ * timebase), so the two can be used interchangeably. Only video is supported and frames are always converted to RGBA.
+ */
+class ImageSequenceDecoder : public Decoder
+{
+public:
+  ImageSequenceDecoder();
+
+  virtual ~ImageSequenceDecoder() override;
+
+  /**
+   * @brief Returns whether a filename is an image sequence pattern this decoder can open
+   */
+  static bool IsImageSequence(const QString& filename);
+
+  virtual bool Open(const DecoderParams& params, QString* error = nullptr) override;
+  virtual void Close() override;
+  virtual bool IsOpen() override;
+
+  virtual void Seek(int64_t timestamp) override;
+
+  virtual int RetrieveFrame(AVFrame* f) override;
+  virtual int RetrieveFrameAt(int64_t timestamp, AVFrame* f) override;
+
+  virtual void SetReversed(bool reversed) override;
+  virtual void SetThreadCount(int threads) override;
+
+  virtual int width() override;
+  virtual int height() override;
+  virtual AVRational time_base() override;
+  virtual int64_t start_time() override;
+  virtual olive::PixelFormat pixel_format() override;
+
+private:
+  /**
+   * @brief Internal function to retrieve the image at an index, decoding it now if it isn't already being decoded
+   */
+  int RetrieveImage(int64_t index, AVFrame* f);
+
+  /**
+   * @brief Internal function to queue decoding of the images after `index` and drop those no longer needed
+   *
+   * lock_ must be locked.
+   */
+  void ReadAhead(int64_t index);
+
+  /**
+   * @brief Internal function to free a job, or cancel it and free it later if it's still running
+   *
+   * lock_ must be locked.
+   */
+  void DiscardJob(ImageSequenceJob* job);
+
+  /**
+   * @brief Internal function to free cancelled jobs that have finished
+   *
+   * lock_ must be locked.
+   */
+  void FreeFinishedJobs();
+
+  /**
+   * @brief Filename pattern of the sequence
+   */
+  QByteArray pattern_;
+
+  /**
+   * @brief Number of the first image in the sequence
+   */
+  int start_number_;
+
+  /**
+   * @brief Amount of images in the sequence (INT64_MAX if unknown)
+   */
+  int64_t image_count_;
+
+  int width_;
+  int height_;
+  AVRational time_base_;
+  int64_t start_time_;
+  olive::PixelFormat pixel_format_;
+
+  /**
+   * @brief FFmpeg pixel format matching pixel_format_
+   */
+  AVPixelFormat av_pixel_format_;
+
+  /**
+   * @brief Amount of images to decode ahead
+   */
+  int read_ahead_;
+
+  /**
+   * @brief Whether images are being requested in descending order
+   */
+  bool reversed_;
+
+  /**
+   * @brief Index of the last image retrieved (-1 if none)
+   */
+  int64_t index_;
+
+  /**
+   * @brief Jobs around the current index keyed by image index, either running or finished
+   */
+  QMap<int64_t, ImageSequenceJob*> jobs_;
+
+  /**
+   * @brief Cancelled jobs that were still running and need to be freed when they finish
+   */
+  QVector<ImageSequenceJob*> cancelled_jobs_;
+
+  /**
+   * @brief Lock for the jobs, also locked by the jobs themselves when they finish
+   */
+  QMutex lock_;
+
+  /**
+   * @brief Signalled by jobs when they finish
+   */
+  QWaitCondition job_finished_;
+
+  bool open_;
+
+  friend class ImageSequenceJob;
+};
+
+#endif // IMAGESEQUENCEDECODER_H
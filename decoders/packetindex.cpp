@@ -0,0 +1,165 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "packetindex.h"
+
+#include <QFile>
+#include <QDataStream>
+#include <algorithm>
+
+#include "global/path.h"
+
+// identifies index files and their version, bump if the file format changes
+const quint32 kPacketIndexMagic = 0x4F504931; // "OPI1"
+
+PacketIndex::PacketIndex()
+{
+}
+
+void PacketIndex::Append(const AVPacket *pkt)
+{
+  PacketIndexEntry entry;
+  entry.pts = pkt->pts;
+  entry.dts = pkt->dts;
+  entry.pos = pkt->pos;
+  entry.keyframe = (pkt->flags & AV_PKT_FLAG_KEY);
+
+  entries_.append(entry);
+
+  // keyframes without a timestamp can't be looked up
+  if (entry.keyframe && entry.pts != AV_NOPTS_VALUE) {
+
+    // keyframes are almost always already in order, so this is usually an append
+    QVector<int>::iterator it = std::upper_bound(keyframes_.begin(), keyframes_.end(), entry.pts,
+                                                 [this](int64_t pts, int index) {
+      return pts < entries_.at(index).pts;
+    });
+
+    keyframes_.insert(it, entries_.size() - 1);
+  }
+}
+
+bool PacketIndex::IsEmpty() const
+{
+  return keyframes_.isEmpty();
+}
+
+const PacketIndexEntry *PacketIndex::GetKeyframeFor(int64_t pts) const
+{
+  // find the first keyframe after pts, the one before it is the one we want
+  QVector<int>::const_iterator it = std::upper_bound(keyframes_.constBegin(), keyframes_.constEnd(), pts,
+                                                     [this](int64_t pts, int index) {
+    return pts < entries_.at(index).pts;
+  });
+
+  if (it == keyframes_.constBegin()) {
+    return nullptr;
+  }
+
+  --it;
+
+  return &entries_.at(*it);
+}
+
+bool PacketIndex::Load(const QString &filename)
+{
+  QFile f(filename);
+  if (!f.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  QDataStream stream(&f);
+
+  quint32 magic;
+  qint32 count;
+  stream >> magic >> count;
+
+  if (magic != kPacketIndexMagic || count < 0) {
+    return false;
+  }
+
+  entries_.resize(count);
+
+  for (int i=0;i<count;i++) {
+    PacketIndexEntry& entry = entries_[i];
+
+    qint64 pts, dts, pos;
+    quint8 keyframe;
+
+    stream >> pts >> dts >> pos >> keyframe;
+
+    entry.pts = pts;
+    entry.dts = dts;
+    entry.pos = pos;
+    entry.keyframe = keyframe;
+  }
+
+  if (stream.status() != QDataStream::Ok) {
+    entries_.clear();
+    keyframes_.clear();
+    return false;
+  }
+
+  UpdateKeyframes();
+
+  return true;
+}
+
+bool PacketIndex::Save(const QString &filename) const
+{
+  QFile f(filename);
+  if (!f.open(QFile::WriteOnly)) {
+    return false;
+  }
+
+  QDataStream stream(&f);
+
+  stream << kPacketIndexMagic << qint32(entries_.size());
+
+  for (int i=0;i<entries_.size();i++) {
+    const PacketIndexEntry& entry = entries_.at(i);
+
+    stream << qint64(entry.pts) << qint64(entry.dts) << qint64(entry.pos) << quint8(entry.keyframe);
+  }
+
+  return (stream.status() == QDataStream::Ok);
+}
+
+QString PacketIndex::GetPath(const QString &hash, int stream_index)
+{
+  return QDir(get_data_dir().filePath("previews")).filePath(QString("%1i%2").arg(hash, QString::number(stream_index)));
+}
+
+void PacketIndex::UpdateKeyframes()
+{
+  keyframes_.clear();
+
+  for (int i=0;i<entries_.size();i++) {
+    const PacketIndexEntry& entry = entries_.at(i);
+
+    if (entry.keyframe && entry.pts != AV_NOPTS_VALUE) {
+      keyframes_.append(i);
+    }
+  }
+
+  std::stable_sort(keyframes_.begin(), keyframes_.end(), [this](int a, int b) {
+    return entries_.at(a).pts < entries_.at(b).pts;
+  });
+}
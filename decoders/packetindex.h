@@ -0,0 +1,125 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PACKETINDEX_H
+#define PACKETINDEX_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QString>
+#include <QVector>
+
+/**
+ * @brief The PacketIndexEntry struct
+ *
+ * Information about one packet of a stream as it was read from the file.
+ */
+struct PacketIndexEntry {
+  int64_t pts;
+  int64_t dts;
+  int64_t pos;
+  bool keyframe;
+};
+
+/**
+ * @brief The PacketIndex class
+ *
+ * A list of every packet in a video stream (in file order) used for frame-accurate seeking. Seeking to a timestamp
+ * with FFmpeg alone doesn't guarantee landing on a keyframe before it, which previously required seeking back
+ * repeatedly until a frame before the target came out of the decoder. With the index, the keyframe that a timestamp
+ * belongs to can be looked up directly and seeked to in one step.
+ *
+ * Indexes are built by PreviewGenerator when footage is imported and stored in the previews directory alongside the
+ * thumbnails and waveforms (see GetPath()).
+ */
+class PacketIndex {
+public:
+  PacketIndex();
+
+  /**
+   * @brief Add a packet to the end of the index
+   */
+  void Append(const AVPacket* pkt);
+
+  /**
+   * @brief Returns whether the index contains any usable keyframes
+   */
+  bool IsEmpty() const;
+
+  /**
+   * @brief Find the keyframe that needs to be decoded from to get the frame at `pts`
+   *
+   * @return
+   *
+   * The last keyframe with a timestamp at or before `pts`, or `nullptr` if there isn't one.
+   */
+  const PacketIndexEntry* GetKeyframeFor(int64_t pts) const;
+
+  /**
+   * @brief Load an index saved with Save()
+   *
+   * @return
+   *
+   * **TRUE** if the file was loaded successfully.
+   */
+  bool Load(const QString& filename);
+
+  /**
+   * @brief Save this index to a file
+   *
+   * @return
+   *
+   * **TRUE** if the file was saved successfully.
+   */
+  bool Save(const QString& filename) const;
+
+  /**
+   * @brief Get the path an index for a certain stream of a file is stored at
+   *
+   * @param hash
+   *
+   * The file's hash from get_file_hash()
+   *
+   * @param stream_index
+   *
+   * The index of the stream in the file
+   */
+  static QString GetPath(const QString& hash, int stream_index);
+
+private:
+  /**
+   * @brief Internal function to rebuild keyframes_ after entries_ has changed
+   */
+  void UpdateKeyframes();
+
+  /**
+   * @brief All packets in file order
+   */
+  QVector<PacketIndexEntry> entries_;
+
+  /**
+   * @brief Indices of keyframes in entries_, sorted by timestamp for binary searching
+   */
+  QVector<int> keyframes_;
+};
+
+#endif // PACKETINDEX_H
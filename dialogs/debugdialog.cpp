@@ -26,6 +26,9 @@
 #include <QEvent>
 
 #include "global/debug.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/framecache.h"
+#include "rendering/framepool.h"
 
 DebugDialog* olive::DebugDialog = nullptr;
 
@@ -36,6 +39,10 @@ DebugDialog::DebugDialog(QWidget *parent) : QDialog(parent) {
   textEdit->setWordWrapMode(QTextOption::NoWrap);
   layout->addWidget(textEdit);
 
+  stats_label = new QLabel(this);
+  stats_label->setTextInteractionFlags(Qt::TextSelectableByMouse);
+  layout->addWidget(stats_label);
+
   Retranslate();
 }
 
@@ -47,6 +54,31 @@ void DebugDialog::Retranslate()
 void DebugDialog::update_log() {
   textEdit->setHtml(get_debug_str());
   textEdit->verticalScrollBar()->setValue(textEdit->verticalScrollBar()->maximum());
+
+  update_stats();
+}
+
+void DebugDialog::update_stats()
+{
+  QStringList stats;
+
+  stats.append(tr("Frame pool: %1% hit rate, %2 MB resident, %3 MB idle").arg(
+                 QString::number(qRound(olive::frame_pool.HitRate() * 100.0)),
+                 QString::number(olive::frame_pool.ResidentBytes() / 1048576),
+                 QString::number(olive::frame_pool.IdleBytes() / 1048576)));
+
+  stats.append(tr("Frame cache: %1% hit rate, %2 hits, %3 misses, %4 MB resident").arg(
+                 QString::number(qRound(olive::frame_cache.HitRate() * 100.0)),
+                 QString::number(olive::frame_cache.Hits()),
+                 QString::number(olive::frame_cache.Misses()),
+                 QString::number(olive::frame_cache.ResidentBytes() / 1048576)));
+
+  stats.append(tr("Framebuffer pool: %1% hit rate, %2 in use, %3 MB resident").arg(
+                 QString::number(qRound(olive::framebuffer_pool.HitRate() * 100.0)),
+                 QString::number(olive::framebuffer_pool.InUseCount()),
+                 QString::number(olive::framebuffer_pool.ResidentBytes() / 1048576)));
+
+  stats_label->setText(stats.join("\n"));
 }
 
 void DebugDialog::changeEvent(QEvent *e)
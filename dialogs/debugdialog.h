@@ -22,13 +22,14 @@
 #define DEBUGDIALOG_H
 
 #include <QDialog>
+#include <QLabel>
 #include <QTextEdit>
 
 /**
  * @brief The DebugDialog class
  *
- * A dialog to display the current debug output. This dialog is omnipresent and shown and hidden when the user wants
- * to see it. For efficiency, it will not update if it's hidden.
+ * A dialog to display the current debug output along with statistics of the playback caches and pools. This dialog is
+ * omnipresent and shown and hidden when the user wants to see it. For efficiency, it will not update if it's hidden.
  */
 class DebugDialog : public QDialog {
   Q_OBJECT
@@ -49,7 +50,7 @@ public:
   void Retranslate();
 public slots:
   /**
-   * @brief Update the visual log with the debug text from get_debug_str()
+   * @brief Update the visual log with the debug text from get_debug_str(), and the cache and pool statistics
    */
   void update_log();
 protected:
@@ -63,10 +64,20 @@ protected:
    */
   virtual void showEvent(QShowEvent* event) override;
 private:
+  /**
+   * @brief Internal function to update stats_label with the current cache and pool statistics
+   */
+  void update_stats();
+
   /**
    * @brief Display widget for the debug dialog.
    */
   QTextEdit* textEdit;
+
+  /**
+   * @brief Display widget for the cache and pool statistics
+   */
+  QLabel* stats_label;
 };
 
 namespace olive {
@@ -413,6 +413,12 @@ void PreferencesDialog::accept() {
   olive::config.upcoming_queue_type = upcoming_queue_type->currentIndex();
   olive::config.previous_queue_size = previous_queue_spinbox->value();
   olive::config.previous_queue_type = previous_queue_type->currentIndex();
+  olive::config.lookahead_frames = lookahead_spinbox->value();
+  olive::config.frame_cache_size = frame_cache_spinbox->value();
+  olive::config.composite_cache_size = composite_cache_spinbox->value();
+  olive::config.framebuffer_pool_size = framebuffer_pool_spinbox->value();
+  olive::config.nested_cache_size = nested_cache_spinbox->value();
+  olive::config.reverse_buffer_size = reverse_buffer_spinbox->value();
 
   // Audio settings may require the audio device to be re-initiated.
   if (olive::config.preferred_audio_output != audio_output_devices->currentData().toString()
@@ -967,6 +973,42 @@ void PreferencesDialog::setup_ui() {
   previous_queue_type->addItem(tr("seconds"));
   previous_queue_type->setCurrentIndex(olive::config.previous_queue_type);
   memory_usage_layout->addWidget(previous_queue_type, 1, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Open Clips Ahead:"), playback_tab), 2, 0);
+  lookahead_spinbox = new QSpinBox(playback_tab);
+  lookahead_spinbox->setRange(0, 1000);
+  lookahead_spinbox->setValue(olive::config.lookahead_frames);
+  memory_usage_layout->addWidget(lookahead_spinbox, 2, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("frames"), playback_tab), 2, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Frame Cache:"), playback_tab), 3, 0);
+  frame_cache_spinbox = new QSpinBox(playback_tab);
+  frame_cache_spinbox->setRange(0, 262144);
+  frame_cache_spinbox->setValue(olive::config.frame_cache_size);
+  memory_usage_layout->addWidget(frame_cache_spinbox, 3, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("MB"), playback_tab), 3, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Composite Cache:"), playback_tab), 4, 0);
+  composite_cache_spinbox = new QSpinBox(playback_tab);
+  composite_cache_spinbox->setRange(0, 262144);
+  composite_cache_spinbox->setValue(olive::config.composite_cache_size);
+  memory_usage_layout->addWidget(composite_cache_spinbox, 4, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("MB"), playback_tab), 4, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Framebuffer Pool:"), playback_tab), 5, 0);
+  framebuffer_pool_spinbox = new QSpinBox(playback_tab);
+  framebuffer_pool_spinbox->setRange(0, 65536);
+  framebuffer_pool_spinbox->setValue(olive::config.framebuffer_pool_size);
+  memory_usage_layout->addWidget(framebuffer_pool_spinbox, 5, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("MB"), playback_tab), 5, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Nested Sequence Cache:"), playback_tab), 6, 0);
+  nested_cache_spinbox = new QSpinBox(playback_tab);
+  nested_cache_spinbox->setRange(0, 65536);
+  nested_cache_spinbox->setValue(olive::config.nested_cache_size);
+  memory_usage_layout->addWidget(nested_cache_spinbox, 6, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("MB"), playback_tab), 6, 2);
+  memory_usage_layout->addWidget(new QLabel(tr("Reverse Playback Buffer:"), playback_tab), 7, 0);
+  reverse_buffer_spinbox = new QSpinBox(playback_tab);
+  reverse_buffer_spinbox->setRange(0, 262144);
+  reverse_buffer_spinbox->setValue(olive::config.reverse_buffer_size);
+  memory_usage_layout->addWidget(reverse_buffer_spinbox, 7, 1);
+  memory_usage_layout->addWidget(new QLabel(tr("MB"), playback_tab), 7, 2);
   playback_tab_layout->addWidget(memory_usage_group);
 
   tabWidget->addTab(playback_tab, tr("Playback"));
@@ -227,6 +227,36 @@ private:
    */
   QComboBox* previous_queue_type;
 
+  /**
+   * @brief UI widget for editing the amount of frames clips are opened ahead of the playhead
+   */
+  QSpinBox* lookahead_spinbox;
+
+  /**
+   * @brief UI widget for editing the size of the frame cache shared by all clips
+   */
+  QSpinBox* frame_cache_spinbox;
+
+  /**
+   * @brief UI widget for editing the size of the cache of composited sequence frames
+   */
+  QSpinBox* composite_cache_spinbox;
+
+  /**
+   * @brief UI widget for editing the size of the pool of idle clip framebuffers
+   */
+  QSpinBox* framebuffer_pool_spinbox;
+
+  /**
+   * @brief UI widget for editing the size of the cache of nested sequence frames
+   */
+  QSpinBox* nested_cache_spinbox;
+
+  /**
+   * @brief UI widget for editing the memory shared by all clips for reversed playback
+   */
+  QSpinBox* reverse_buffer_spinbox;
+
   /**
    * @brief UI widget for editing the size of textboxes in the EffectControls panel
    */
@@ -114,7 +114,13 @@ void TimecodeEffect::redraw(double timecode) {
   Sequence* sequence = parent_clip->track()->sequence();
 
   if (tc_select->GetValueAt(timecode).toBool()) {
-    display_timecode = prepend_text->GetStringAt(timecode) + frame_to_timecode(sequence->playhead,
+    // derive the sequence frame from the timecode rather than the playhead since the frame being rendered isn't
+    // necessarily the one at the playhead (e.g. when rendering into the composite cache)
+    long sequence_frame = qRound(timecode * sequence->frame_rate)
+        - parent_clip->clip_in(true)
+        + parent_clip->timeline_in(true);
+
+    display_timecode = prepend_text->GetStringAt(timecode) + frame_to_timecode(sequence_frame,
                                                                                olive::config.timecode_view,
                                                                                sequence->frame_rate);
   } else {
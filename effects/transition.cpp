@@ -55,6 +55,7 @@ Transition::Transition(Clip *c) :
   }
 
   connect(length_field, SIGNAL(Changed()), this, SLOT(UpdateMaximumLength()));
+  connect(length_field, SIGNAL(Changed()), this, SLOT(InvalidateClipIndex()));
 }
 
 OldEffectNodePtr Transition::copy(Clip *c) {
@@ -143,6 +144,14 @@ void Transition::UpdateMaximumLength()
   length_field->SetMaximum(maximum_length);
 }
 
+void Transition::InvalidateClipIndex()
+{
+  // shared transitions extend their clips on the timeline, so their length changes where the clips are active
+  if (parent_clip != nullptr && parent_clip->track() != nullptr && parent_clip->track()->sequence() != nullptr) {
+    parent_clip->track()->sequence()->InvalidateClipIndex();
+  }
+}
+
 long Transition::GetMaximumEmptySpaceOnClip(Clip *c)
 {
   long maximum_transition_length = c->length();
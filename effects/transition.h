@@ -57,6 +57,7 @@ private:
 
 private slots:
   void UpdateMaximumLength();
+  void InvalidateClipIndex();
   long GetMaximumEmptySpaceOnClip(Clip* c);
 };
 
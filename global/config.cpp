@@ -61,6 +61,12 @@ Config::Config()
     previous_queue_type(olive::FRAME_QUEUE_TYPE_FRAMES),
     upcoming_queue_size(0.5),
     upcoming_queue_type(olive::FRAME_QUEUE_TYPE_SECONDS),
+    frame_cache_size(1024),
+    composite_cache_size(1024),
+    framebuffer_pool_size(512),
+    nested_cache_size(256),
+    reverse_buffer_size(1024),
+    lookahead_frames(24),
     loop(false),
     seek_also_selects(false),
     auto_seek_to_beginning(true),
@@ -80,6 +86,7 @@ Config::Config()
     default_sequence_audio_frequency(48000),
     default_sequence_audio_channel_layout(3),
     playback_bit_depth(olive::PIX_FMT_RGBA16F),
+    playback_resolution_divider(1),
     export_bit_depth(olive::PIX_FMT_RGBA32F),
     dont_use_proxies_on_export(true),
     maximum_recent_projects(10),
@@ -181,6 +188,24 @@ void Config::load(QString path) {
         } else if (stream.name() == "UpcomingFrameQueueType") {
           stream.readNext();
           upcoming_queue_type = stream.text().toInt();
+        } else if (stream.name() == "FrameCacheSize") {
+          stream.readNext();
+          frame_cache_size = stream.text().toInt();
+        } else if (stream.name() == "CompositeCacheSize") {
+          stream.readNext();
+          composite_cache_size = stream.text().toInt();
+        } else if (stream.name() == "FramebufferPoolSize") {
+          stream.readNext();
+          framebuffer_pool_size = stream.text().toInt();
+        } else if (stream.name() == "NestedCacheSize") {
+          stream.readNext();
+          nested_cache_size = stream.text().toInt();
+        } else if (stream.name() == "ReverseBufferSize") {
+          stream.readNext();
+          reverse_buffer_size = stream.text().toInt();
+        } else if (stream.name() == "LookaheadFrames") {
+          stream.readNext();
+          lookahead_frames = stream.text().toInt();
         } else if (stream.name() == "Loop") {
           stream.readNext();
           loop = (stream.text() == "1");
@@ -262,6 +287,9 @@ void Config::load(QString path) {
         } else if (stream.name() == "PlaybackBitDepth") {
           stream.readNext();
           playback_bit_depth = stream.text().toInt();
+        } else if (stream.name() == "PlaybackResolutionDivider") {
+          stream.readNext();
+          playback_resolution_divider = qMax(1, stream.text().toInt());
         } else if (stream.name() == "ExportBitDepth") {
           stream.readNext();
           export_bit_depth = stream.text().toInt();
@@ -324,6 +352,12 @@ void Config::save(QString path) {
   stream.writeTextElement("PreviousFrameQueueType", QString::number(previous_queue_type));
   stream.writeTextElement("UpcomingFrameQueueSize", QString::number(upcoming_queue_size));
   stream.writeTextElement("UpcomingFrameQueueType", QString::number(upcoming_queue_type));
+  stream.writeTextElement("FrameCacheSize", QString::number(frame_cache_size));
+  stream.writeTextElement("CompositeCacheSize", QString::number(composite_cache_size));
+  stream.writeTextElement("FramebufferPoolSize", QString::number(framebuffer_pool_size));
+  stream.writeTextElement("NestedCacheSize", QString::number(nested_cache_size));
+  stream.writeTextElement("ReverseBufferSize", QString::number(reverse_buffer_size));
+  stream.writeTextElement("LookaheadFrames", QString::number(lookahead_frames));
   stream.writeTextElement("Loop", QString::number(loop));
   stream.writeTextElement("SeekAlsoSelects", QString::number(seek_also_selects));
   stream.writeTextElement("AutoSeekToBeginning", QString::number(auto_seek_to_beginning));
@@ -351,6 +385,7 @@ void Config::save(QString path) {
   stream.writeTextElement("DefaultSequenceAudioFrequency", QString::number(default_sequence_audio_frequency));
   stream.writeTextElement("DefaultSequenceAudioLayout", QString::number(default_sequence_audio_channel_layout));
   stream.writeTextElement("PlaybackBitDepth", QString::number(playback_bit_depth));
+  stream.writeTextElement("PlaybackResolutionDivider", QString::number(playback_resolution_divider));
   stream.writeTextElement("ExportBitDepth", QString::number(export_bit_depth));
   stream.writeTextElement("DontUseProxiesOnExport", QString::number(dont_use_proxies_on_export));
   stream.writeTextElement("LockedPanels", QString::number(locked_panels));
@@ -392,6 +392,61 @@ struct Config {
    */
   int upcoming_queue_type;
 
+  /**
+   * @brief Frame cache size
+   *
+   * Memory in megabytes shared by every clip for keeping decoded video frames around after they've left a clip's
+   * frame queue (including frames of clips that have since closed), so playing or seeking back over them doesn't need
+   * to decode them again. See FrameCache.
+   *
+   * Set to 0 to disable the frame cache.
+   */
+  int frame_cache_size;
+
+  /**
+   * @brief Composite cache size
+   *
+   * Memory in megabytes for keeping final composited frames of sequences around, so frames that are shown again (or
+   * were rendered ahead of time with Render In to Out) only need to be blitted rather than composed again. See
+   * CompositeCache.
+   *
+   * Set to 0 to disable the composite cache.
+   */
+  int composite_cache_size;
+
+  /**
+   * @brief Framebuffer pool size
+   *
+   * Memory in megabytes of VRAM to keep idle clip framebuffers around in for re-use. See FramebufferPool.
+   */
+  int framebuffer_pool_size;
+
+  /**
+   * @brief Nested sequence cache size
+   *
+   * Memory in megabytes of VRAM to keep composited frames of nested sequences in for re-use. See NestCache.
+   */
+  int nested_cache_size;
+
+  /**
+   * @brief Reverse playback buffer size
+   *
+   * Memory in megabytes shared by all video clips for the GOPs they hold in memory during reversed playback (see
+   * DecodeScheduler::ReverseBufferBytes()).
+   */
+  int reverse_buffer_size;
+
+  /**
+   * @brief Look-ahead frames
+   *
+   * Clips are opened and their first frame decoded this many frames before the playhead reaches them (in the current
+   * playback direction, multiplied by the playback speed), so that playback doesn't stall at edit points while files
+   * open. Clips are closed again if the playhead moves away before reaching them.
+   *
+   * Set to 0 to only open clips once they're reached.
+   */
+  int lookahead_frames;
+
   /**
    * @brief Loop
    *
@@ -599,6 +654,14 @@ struct Config {
    */
   int playback_bit_depth;
 
+  /**
+   * @brief Playback resolution divider
+   *
+   * Viewers render at the sequence's resolution divided by this (1 for full, 2, 4 or 8 for 1/2, 1/4 or 1/8), and
+   * video is decoded at the same fraction of its resolution. Exports always use full resolution.
+   */
+  int playback_resolution_divider;
+
   /**
    * @brief Export bit depth (an index of olive::rendering::bit_depths)
    */
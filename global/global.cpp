@@ -33,6 +33,11 @@
 #include "global/timing.h"
 #include "global/clipboard.h"
 #include "rendering/audio.h"
+#include "rendering/decoderpool.h"
+#include "rendering/framecache.h"
+#include "rendering/compositecache.h"
+#include "rendering/framepool.h"
+#include "rendering/stillimagecache.h"
 #include "dialogs/demonotice.h"
 #include "dialogs/preferencesdialog.h"
 #include "dialogs/exportdialog.h"
@@ -285,6 +290,13 @@ void OliveGlobal::ClearProject()
   // clear project contents (footage, sequences, etc.)
   olive::project_model.clear();
 
+  // close any files that were left open for re-use
+  olive::decoder_pool.Clear();
+  olive::frame_pool.Clear();
+  olive::still_image_cache.Clear();
+  olive::frame_cache.Clear();
+  olive::composite_cache.Clear();
+
   // clear undo stack
   olive::undo_stack.clear();
 
@@ -178,6 +178,9 @@ public:
   virtual GLuint process_superimpose(QOpenGLContext *ctx, double timecode);
   virtual void process_audio(double timecode_start, double timecode_end, float **samples, int nb_samples, int nb_channels, int type);
 
+  // enable effect to update constantly (its output changes over time even if its fields don't)
+  virtual bool AlwaysUpdate();
+
   virtual void gizmo_draw(double timecode, GLTextureCoords& coords);
   void gizmo_move(EffectGizmo* sender, int x_movement, int y_movement, double timecode, bool done);
   void gizmo_world_to_screen(const QMatrix4x4 &matrix, const QMatrix4x4 &projection);
@@ -252,9 +255,6 @@ protected:
   int tex_width_;
   int tex_height_;
 
-  // enable effect to update constantly
-  virtual bool AlwaysUpdate();
-
 private:
   bool isOpen;
   QVector<NodeIO*> rows;
@@ -210,7 +210,22 @@ SOURCES += \
     decoders/ffmpegdecoder.cpp \
     decoders/decoder.cpp \
     nodes/nodeedge.cpp \
-    ui/nodeedgeui.cpp
+    ui/nodeedgeui.cpp \
+    rendering/decoderpool.cpp \
+    decoders/packetindex.cpp \
+    rendering/framepool.cpp \
+    rendering/decodescheduler.cpp \
+    rendering/stillimagecache.cpp \
+    decoders/imagesequencedecoder.cpp \
+    rendering/framecache.cpp \
+    rendering/audioconformer.cpp \
+    rendering/compositecache.cpp \
+    timeline/clipindex.cpp \
+    rendering/framebufferpool.cpp \
+    rendering/shadercache.cpp \
+    rendering/ociocache.cpp \
+    rendering/nestcache.cpp \
+    rendering/pixeluploadring.cpp
 
 HEADERS += \
     nodes/node.h \
@@ -378,7 +393,22 @@ HEADERS += \
     decoders/decoder.h \
     timeline/tracktypes.h \
     nodes/nodeedge.h \
-    ui/nodeedgeui.h
+    ui/nodeedgeui.h \
+    rendering/decoderpool.h \
+    decoders/packetindex.h \
+    rendering/framepool.h \
+    rendering/decodescheduler.h \
+    rendering/stillimagecache.h \
+    decoders/imagesequencedecoder.h \
+    rendering/framecache.h \
+    rendering/audioconformer.h \
+    rendering/compositecache.h \
+    timeline/clipindex.h \
+    rendering/framebufferpool.h \
+    rendering/shadercache.h \
+    rendering/ociocache.h \
+    rendering/nestcache.h \
+    rendering/pixeluploadring.h
 
 FORMS +=
 
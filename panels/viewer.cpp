@@ -51,6 +51,7 @@ extern "C" {
 #include "undo/undostack.h"
 #include "ui/audiomonitor.h"
 #include "rendering/renderfunctions.h"
+#include "rendering/renderthread.h"
 #include "ui/viewercontainer.h"
 #include "ui/labelslider.h"
 #include "ui/timelineheader.h"
@@ -65,6 +66,7 @@ extern "C" {
 Viewer::Viewer(QWidget *parent) :
   Panel(parent),
   playing(false),
+  scrubbing(false),
   media(nullptr),
   seq(nullptr),
   created_sequence(false),
@@ -436,6 +438,16 @@ void Viewer::update_viewer() {
   update_end_timecode();
 }
 
+void Viewer::render_in_to_out()
+{
+  if (seq != nullptr) {
+    long in = seq->using_workarea ? seq->workarea_in : 0;
+    long out = seq->using_workarea ? seq->workarea_out : seq->GetEndFrame();
+
+    viewer_widget_->get_renderer()->render_range(seq.get(), in, out);
+  }
+}
+
 void Viewer::prev_cut()
 {
   if (seq != nullptr
@@ -891,6 +903,8 @@ void Viewer::set_sequence(SequencePtr s) {
 
   reset_all_audio();
 
+  viewer_widget_->get_renderer()->stop_range_render();
+
   viewer_widget_->wait_until_render_is_paused();
 
   // If we had a current sequence open, close it
@@ -73,6 +73,9 @@ public:
   void play(bool in_to_out = false);
   void pause();
   bool playing;
+
+  // TRUE while the user is dragging the playhead, when showing something quickly matters more than the exact frame
+  bool scrubbing;
   long playhead_start;
   qint64 start_msecs;
   QTimer playback_updater;
@@ -126,6 +129,12 @@ public slots:
   void prev_cut();
   void next_cut();
 
+  /**
+   * @brief Render the frames between the in and out points (or the whole sequence if there aren't any) in the
+   * background so they play back from the composite cache
+   */
+  void render_in_to_out();
+
 
 private slots:
   void update_playhead();
@@ -28,6 +28,7 @@
 #include "global/config.h"
 #include "global/path.h"
 #include "global/debug.h"
+#include "decoders/packetindex.h"
 
 #include <QPainter>
 #include <QPixmap>
@@ -35,6 +36,7 @@
 #include <QTreeWidgetItem>
 #include <QSemaphore>
 #include <QFile>
+#include <QFileInfo>
 #include <QDir>
 
 QSemaphore sem(5); // only 5 preview generators can run at one time
@@ -525,6 +527,80 @@ void PreviewGenerator::generate_waveform() {
   delete [] codec_ctx;
 }
 
+QVector<int> PreviewGenerator::get_streams_to_index(const QString &hash)
+{
+  // returns the file indices of video streams that would benefit from a packet index but don't have one yet
+  QVector<int> streams;
+
+  // formats without a single file to seek in (e.g. image sequences) can't use an index
+  if (fmt_ctx_->iformat->flags & AVFMT_NOFILE) {
+    return streams;
+  }
+
+  for (int i=0;i<footage_->video_tracks.size();i++) {
+    const FootageStream& ms = footage_->video_tracks.at(i);
+
+    if (ms.infinite_length) {
+      continue;
+    }
+
+    // every frame of an intra-only codec is a keyframe, so seeking is already accurate
+    const AVCodecDescriptor* desc = avcodec_descriptor_get(fmt_ctx_->streams[ms.file_index]->codecpar->codec_id);
+    if (desc != nullptr && (desc->props & AV_CODEC_PROP_INTRA_ONLY)) {
+      continue;
+    }
+
+    if (!QFileInfo::exists(PacketIndex::GetPath(hash, ms.file_index))) {
+      streams.append(ms.file_index);
+    }
+  }
+
+  return streams;
+}
+
+void PreviewGenerator::generate_packet_index(const QString &hash, const QVector<int> &streams)
+{
+  // generate_waveform() may have already read through the file, so start from the beginning again
+  int64_t start = (fmt_ctx_->start_time == AV_NOPTS_VALUE) ? 0 : fmt_ctx_->start_time;
+  if (av_seek_frame(fmt_ctx_, -1, start, AVSEEK_FLAG_BACKWARD) < 0) {
+    qWarning() << "Failed to rewind" << footage_->name << "for indexing";
+    return;
+  }
+
+  QVector<PacketIndex*> indexes(int(fmt_ctx_->nb_streams), nullptr);
+  for (int i=0;i<streams.size();i++) {
+    indexes[streams.at(i)] = new PacketIndex();
+  }
+
+  // only demux here, there's no need to decode anything
+  AVPacket* packet = av_packet_alloc();
+
+  int read_ret = 0;
+  while (!cancelled_ && (read_ret = av_read_frame(fmt_ctx_, packet)) >= 0) {
+    if (packet->stream_index < indexes.size() && indexes.at(packet->stream_index) != nullptr) {
+      indexes.at(packet->stream_index)->Append(packet);
+    }
+    av_packet_unref(packet);
+  }
+
+  av_packet_free(&packet);
+
+  // only save complete indexes
+  bool complete = (!cancelled_ && read_ret == AVERROR_EOF);
+  if (!cancelled_ && !complete) {
+    qWarning() << "Failed to read packet for indexing" << read_ret;
+  }
+
+  for (int i=0;i<indexes.size();i++) {
+    if (indexes.at(i) != nullptr) {
+      if (complete) {
+        indexes.at(i)->Save(PacketIndex::GetPath(hash, i));
+      }
+      delete indexes.at(i);
+    }
+  }
+}
+
 QString PreviewGenerator::get_thumbnail_path(const QString& hash, const FootageStream& ms) {
   return data_dir_.filePath(QString("%1t%2").arg(hash, QString::number(ms.file_index)));
 }
@@ -572,10 +648,13 @@ void PreviewGenerator::run() {
       // see if we already have data for this
       QString hash = get_file_hash(footage_->url);
 
-      if (retrieve_preview(hash)) {
+      bool generate_previews = retrieve_preview(hash);
+      QVector<int> streams_to_index = get_streams_to_index(hash);
+
+      if (generate_previews || !streams_to_index.isEmpty()) {
         sem.acquire();
 
-        if (!cancelled_) {
+        if (!cancelled_ && generate_previews) {
           generate_waveform();
 
           if (!cancelled_) {
@@ -596,6 +675,10 @@ void PreviewGenerator::run() {
           }
         }
 
+        if (!cancelled_ && !streams_to_index.isEmpty()) {
+          generate_packet_index(hash, streams_to_index);
+        }
+
         sem.release();
       }
     }
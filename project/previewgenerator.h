@@ -48,6 +48,8 @@ private:
   void parse_media();
   bool retrieve_preview(const QString &hash);
   void generate_waveform();
+  QVector<int> get_streams_to_index(const QString& hash);
+  void generate_packet_index(const QString& hash, const QVector<int>& streams);
   void finalize_media();
   void invalidate_media(const QString& error_msg);
   QString get_thumbnail_path(const QString &hash, const FootageStream &ms);
@@ -0,0 +1,344 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "audioconformer.h"
+
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+
+#include "decoders/ffmpegdecoder.h"
+#include "global/path.h"
+
+const char kConformedAudioMagic[4] = {'O', 'C', 'A', 'F'};
+const qint32 kConformedAudioVersion = 1;
+
+/**
+ * @brief Header at the start of every conformed audio file, followed directly by the interleaved samples
+ */
+struct ConformedAudioHeader {
+  char magic[4];
+  qint32 version;
+  qint32 sample_rate;
+  qint32 channels;
+  qint64 sample_count;
+};
+
+ConformedAudio::ConformedAudio() :
+  data_(nullptr),
+  sample_count_(0),
+  channels_(0),
+  sample_rate_(0)
+{}
+
+ConformedAudio::~ConformedAudio()
+{
+  // closing also unmaps the file
+  file_.close();
+}
+
+bool ConformedAudio::Open(const QString &path)
+{
+  file_.setFileName(path);
+
+  if (!file_.open(QFile::ReadOnly)) {
+    return false;
+  }
+
+  ConformedAudioHeader header;
+
+  if (file_.read(reinterpret_cast<char*>(&header), sizeof(header)) != sizeof(header)
+      || memcmp(header.magic, kConformedAudioMagic, sizeof(header.magic)) != 0
+      || header.version != kConformedAudioVersion
+      || header.channels <= 0
+      || header.sample_count <= 0) {
+    file_.close();
+    return false;
+  }
+
+  qint64 data_size = header.sample_count * header.channels * qint64(sizeof(float));
+
+  // a file that's shorter than its header says wasn't finished
+  if (file_.size() < qint64(sizeof(header)) + data_size) {
+    file_.close();
+    return false;
+  }
+
+  uchar* map = file_.map(sizeof(header), data_size);
+
+  if (map == nullptr) {
+    qWarning() << "Failed to map conformed audio" << path << file_.errorString();
+    file_.close();
+    return false;
+  }
+
+  data_ = reinterpret_cast<const float*>(map);
+  sample_count_ = header.sample_count;
+  channels_ = header.channels;
+  sample_rate_ = header.sample_rate;
+
+  return true;
+}
+
+const float *ConformedAudio::data() const
+{
+  return data_;
+}
+
+int64_t ConformedAudio::sample_count() const
+{
+  return sample_count_;
+}
+
+int ConformedAudio::channels() const
+{
+  return channels_;
+}
+
+int ConformedAudio::sample_rate() const
+{
+  return sample_rate_;
+}
+
+AudioConformer::AudioConformer() :
+  cancelled_(false)
+{}
+
+void AudioConformer::run()
+{
+  lock_.lock();
+
+  while (!cancelled_) {
+    if (queue_.isEmpty()) {
+      wait_cond_.wait(&lock_);
+      continue;
+    }
+
+    // leave the job in the queue while it's conformed so Get() doesn't queue it again
+    Job job = queue_.first();
+
+    lock_.unlock();
+
+    bool success = Conform(job);
+
+    lock_.lock();
+
+    queue_.removeFirst();
+
+    if (!success && !cancelled_) {
+      failed_.insert(job.path);
+    }
+  }
+
+  lock_.unlock();
+}
+
+ConformedAudioPtr AudioConformer::Get(const QString &filename, int stream_index, int sample_rate)
+{
+  QMutexLocker locker(&lock_);
+
+  QString path = GetPath(filename, stream_index, sample_rate);
+
+  ConformedAudioPtr conformed = files_.value(path);
+
+  if (conformed != nullptr || failed_.contains(path)) {
+    return conformed;
+  }
+
+  for (int i=0;i<queue_.size();i++) {
+    if (queue_.at(i).path == path) {
+      return nullptr;
+    }
+  }
+
+  // the stream may have been conformed in a previous session
+  if (QFileInfo::exists(path)) {
+    conformed = std::make_shared<ConformedAudio>();
+
+    if (conformed->Open(path)) {
+      files_.insert(path, conformed);
+      return conformed;
+    }
+
+    QFile::remove(path);
+  }
+
+  Job job;
+  job.filename = filename;
+  job.stream_index = stream_index;
+  job.sample_rate = sample_rate;
+  job.path = path;
+
+  queue_.append(job);
+
+  wait_cond_.wakeAll();
+
+  return nullptr;
+}
+
+void AudioConformer::Cancel()
+{
+  lock_.lock();
+  cancelled_ = true;
+  wait_cond_.wakeAll();
+  lock_.unlock();
+
+  wait();
+}
+
+QString AudioConformer::GetPath(const QString &filename, int stream_index, int sample_rate)
+{
+  return get_data_dir().filePath(QString("conformed/%1_%2_%3").arg(get_file_hash(filename),
+                                                                   QString::number(stream_index),
+                                                                   QString::number(sample_rate)));
+}
+
+bool AudioConformer::Conform(const Job &job)
+{
+  QFileInfo(job.path).dir().mkpath(".");
+
+  // write to a temporary file first so a partially conformed stream is never mistaken for a finished one
+  QString temp_path = job.path + ".tmp";
+
+  QFile file(temp_path);
+
+  if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+    qWarning() << "Failed to open" << temp_path << "for conforming audio" << file.errorString();
+    return false;
+  }
+
+  DecoderParams params;
+  params.filename = job.filename;
+  params.stream_index = job.stream_index;
+  params.audio_sample_rate = job.sample_rate;
+
+  FFmpegDecoder decoder;
+
+  QString error;
+  if (!decoder.Open(params, &error)) {
+    qWarning() << "Failed to open" << job.filename << "for conforming audio" << error;
+    file.close();
+    QFile::remove(temp_path);
+    return false;
+  }
+
+  int64_t stream_start = qMax(static_cast<int64_t>(0), decoder.start_time());
+  double timebase = av_q2d(decoder.time_base());
+
+  // the decoder may have been leased from the pool in the middle of the stream
+  decoder.Seek(stream_start);
+
+  ConformedAudioHeader header;
+  memcpy(header.magic, kConformedAudioMagic, sizeof(header.magic));
+  header.version = kConformedAudioVersion;
+  header.sample_rate = job.sample_rate;
+  header.channels = 0;
+  header.sample_count = 0;
+
+  // placeholder until we know how many samples there are
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+  AVFrame* frame = av_frame_alloc();
+  QVector<float> interleaved;
+  bool first_frame = true;
+  bool success = true;
+  int ret = 0;
+
+  while (!cancelled_ && (ret = decoder.RetrieveFrame(frame)) >= 0) {
+    int channels = frame->channels;
+    int start_sample = 0;
+
+    if (first_frame) {
+      header.channels = channels;
+
+      // line the first sample up with the start of the stream, the same as CacheAudioWorker() does when decoding live
+      const AVFrame* source_frame = decoder.last_decoded_frame();
+
+      if (source_frame->pts != AV_NOPTS_VALUE) {
+        int64_t offset = qRound64(double(source_frame->pts - stream_start) * timebase * job.sample_rate);
+
+        if (offset > 0) {
+          interleaved.fill(0.0f, int(offset * channels));
+          file.write(reinterpret_cast<const char*>(interleaved.constData()), interleaved.size() * qint64(sizeof(float)));
+          header.sample_count += offset;
+        } else {
+          start_sample = int(qMin(int64_t(frame->nb_samples), -offset));
+        }
+      }
+
+      first_frame = false;
+    }
+
+    int nb_samples = frame->nb_samples - start_sample;
+
+    if (nb_samples <= 0) {
+      continue;
+    }
+
+    interleaved.resize(nb_samples * channels);
+
+    for (int i=0;i<nb_samples;i++) {
+      for (int j=0;j<channels;j++) {
+        interleaved[i*channels+j] = reinterpret_cast<float*>(frame->data[j])[start_sample + i];
+      }
+    }
+
+    qint64 bytes = interleaved.size() * qint64(sizeof(float));
+
+    if (file.write(reinterpret_cast<const char*>(interleaved.constData()), bytes) != bytes) {
+      qWarning() << "Failed to write conformed audio" << temp_path << file.errorString();
+      success = false;
+      break;
+    }
+
+    header.sample_count += nb_samples;
+  }
+
+  if (!cancelled_ && success && ret != AVERROR_EOF) {
+    success = false;
+  }
+
+  av_frame_free(&frame);
+  decoder.Close();
+
+  if (cancelled_ || !success || header.sample_count == 0) {
+    file.close();
+    QFile::remove(temp_path);
+    return false;
+  }
+
+  file.seek(0);
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  file.close();
+
+  QFile::remove(job.path);
+
+  if (!QFile::rename(temp_path, job.path)) {
+    qWarning() << "Failed to move conformed audio to" << job.path;
+    QFile::remove(temp_path);
+    return false;
+  }
+
+  qInfo() << "Conformed audio stream" << job.stream_index << "of" << job.filename << "-" << header.sample_count << "samples";
+
+  return true;
+}
+
+AudioConformer olive::audio_conformer;
@@ -0,0 +1,174 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef AUDIOCONFORMER_H
+#define AUDIOCONFORMER_H
+
+#include <memory>
+#include <QThread>
+#include <QFile>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+
+/**
+ * @brief The ConformedAudio class
+ *
+ * A read-only, memory-mapped audio stream that was conformed by AudioConformer. Samples are interleaved 32-bit floats
+ * at a fixed sample rate, with sample 0 at the start time of the source stream, so any point in the stream can be
+ * read directly without seeking or decoding.
+ */
+class ConformedAudio {
+public:
+  ConformedAudio();
+
+  /**
+   * @brief ConformedAudio Destructor
+   *
+   * Unmaps and closes the file.
+   */
+  ~ConformedAudio();
+
+  /**
+   * @brief Open and map a file written by AudioConformer
+   *
+   * @return
+   *
+   * **TRUE** if the file was complete and could be mapped.
+   */
+  bool Open(const QString& path);
+
+  /**
+   * @brief Interleaved samples, sample_count() * channels() floats in total
+   */
+  const float* data() const;
+
+  /**
+   * @brief Number of samples per channel
+   */
+  int64_t sample_count() const;
+
+  int channels() const;
+
+  int sample_rate() const;
+
+private:
+  QFile file_;
+
+  const float* data_;
+
+  int64_t sample_count_;
+
+  int channels_;
+
+  int sample_rate_;
+};
+
+using ConformedAudioPtr = std::shared_ptr<ConformedAudio>;
+
+/**
+ * @brief The AudioConformer class
+ *
+ * Decoding audio live in Cacher::CacheAudioWorker() means every seek, direction change or speed change restarts the
+ * decoder (and reversed playback decodes every second of audio several times over). AudioConformer decodes each audio
+ * stream once in the background into a stereo 32-bit float file at the playback sample rate (in the data directory),
+ * which Cachers then map into memory with ConformedAudio and read from directly.
+ *
+ * Streams are conformed on request by Get(), which returns nothing until the stream's file is ready so the Cacher can
+ * keep decoding live in the meantime.
+ *
+ * All public functions are thread-safe.
+ */
+class AudioConformer : public QThread {
+  Q_OBJECT
+public:
+  AudioConformer();
+
+  virtual void run() override;
+
+  /**
+   * @brief Get the conformed version of an audio stream
+   *
+   * If the stream hasn't been conformed at this sample rate yet, it's queued to be conformed in the background.
+   *
+   * @return
+   *
+   * The mapped stream, or `nullptr` if it isn't ready (or couldn't be conformed).
+   */
+  ConformedAudioPtr Get(const QString& filename, int stream_index, int sample_rate);
+
+  /**
+   * @brief Stop conforming and wait for the thread to exit
+   *
+   * Any partially conformed stream is discarded.
+   */
+  void Cancel();
+
+private:
+  struct Job {
+    QString filename;
+    int stream_index;
+    int sample_rate;
+    QString path;
+  };
+
+  /**
+   * @brief Internal function to get the location a stream is conformed to
+   */
+  static QString GetPath(const QString& filename, int stream_index, int sample_rate);
+
+  /**
+   * @brief Internal function that decodes a whole stream into its conformed file
+   *
+   * @return
+   *
+   * **TRUE** if the file was written completely.
+   */
+  bool Conform(const Job& job);
+
+  /**
+   * @brief Streams that have been mapped so far, keyed by path
+   */
+  QHash<QString, ConformedAudioPtr> files_;
+
+  /**
+   * @brief Streams waiting to be conformed, the first one is the one currently being conformed
+   */
+  QVector<Job> queue_;
+
+  /**
+   * @brief Paths of streams that failed to conform, so they aren't retried every time a clip opens
+   */
+  QSet<QString> failed_;
+
+  QMutex lock_;
+
+  QWaitCondition wait_cond_;
+
+  bool cancelled_;
+};
+
+namespace olive {
+extern AudioConformer audio_conformer;
+}
+
+#endif // AUDIOCONFORMER_H
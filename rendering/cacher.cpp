@@ -37,6 +37,10 @@
 #include "project/projectelements.h"
 #include "rendering/audio.h"
 #include "rendering/renderfunctions.h"
+#include "rendering/framepool.h"
+#include "rendering/decodescheduler.h"
+#include "rendering/framecache.h"
+#include "rendering/stillimagecache.h"
 #include "global/timing.h"
 #include "global/config.h"
 #include "global/global.h"
@@ -48,6 +52,13 @@
 
 const AVSampleFormat kDestSampleFmt = AV_SAMPLE_FMT_FLTP;
 
+// hard limit on the frames in each of the two GOP buffers used during reversed video playback, their memory is limited
+// by olive::config.reverse_buffer_size (see DecodeScheduler::ReverseBufferBytes())
+const int kMaxReverseFrames = 300;
+
+// shuttle speed from which only frames that other frames depend on are decoded (most of the others wouldn't be shown)
+const int kFastShuttleSpeed = 2;
+
 double samples_to_seconds(int nb_samples, int nb_channels, int sample_rate) {
   return (double(nb_samples) / double(nb_channels) / double(sample_rate));
 }
@@ -160,6 +171,13 @@ void Cacher::CacheAudioWorker() {
     timeline_out = temp;
   }
 
+  // conformed audio is read from memory rather than decoded
+  if (conformed_audio_ != nullptr) {
+    CacheConformedAudio(timeline_in, timeline_out, target_frame, frame_skip, last_fr);
+    WakeAudioWakeObject();
+    return;
+  }
+
   while (true) {
     AVFrame* frame;
     int nb_samples = INT_MAX;
@@ -183,10 +201,13 @@ void Cacher::CacheAudioWorker() {
         }
       }
     } else if (clip->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
-      double timebase = av_q2d(stream->time_base);
+      double timebase = av_q2d(decoder_->time_base());
 
       frame = queue_.at(0);
 
+      // raw frame from the decoder before conversion, used for timing information
+      const AVFrame* source_frame = ffmpeg_decoder_.last_decoded_frame();
+
       // retrieve frame
       bool new_frame = false;
       while ((frame_sample_index_ == -1 || frame_sample_index_ >= nb_samples) && nb_samples > 0) {
@@ -196,11 +217,10 @@ void Cacher::CacheAudioWorker() {
           int loop = 0;
 
           if (reverse_audio && !audio_just_reset) {
-            avcodec_flush_buffers(codecCtx);
             reached_end = false;
-            int64_t backtrack_seek = qMax(reverse_target_ - static_cast<int64_t>(av_q2d(av_inv_q(stream->time_base))),
+            int64_t backtrack_seek = qMax(reverse_target_ - static_cast<int64_t>(av_q2d(av_inv_q(decoder_->time_base()))),
                                           static_cast<int64_t>(0));
-            av_seek_frame(formatCtx, stream->index, backtrack_seek, AVSEEK_FLAG_BACKWARD);
+            decoder_->Seek(backtrack_seek);
 #ifdef AUDIOWARNINGS
             if (backtrack_seek == 0) {
               dout << "backtracked to 0";
@@ -209,45 +229,22 @@ void Cacher::CacheAudioWorker() {
           }
 
           do {
-            av_frame_unref(frame);
-
-            int ret;
-
-            while ((ret = av_buffersink_get_frame(buffersink_ctx, frame)) == AVERROR(EAGAIN)) {
-              ret = RetrieveFrameFromDecoder(frame_);
-              if (ret >= 0) {
-                if ((ret = av_buffersrc_add_frame_flags(buffersrc_ctx, frame_, AV_BUFFERSRC_FLAG_KEEP_REF)) < 0) {
-                  qCritical() << "Could not feed filtergraph -" << ret;
-                  break;
-                }
-              } else {
-                if (ret == AVERROR_EOF) {
-#ifdef AUDIOWARNINGS
-                  dout << "reached EOF while reading";
-#endif
-                  // TODO revise usage of reached_end in audio
-                  if (!reverse_audio) {
-                    reached_end = true;
-                  } else {
-                  }
-                } else {
-                  qWarning() << "Raw audio frame data could not be retrieved." << ret;
-                  reached_end = true;
-                }
-                break;
-              }
-            }
+            int ret = decoder_->RetrieveFrame(frame);
 
             if (ret < 0) {
               if (ret != AVERROR_EOF) {
-                qCritical() << "Could not pull from filtergraph";
+                qCritical() << "Could not pull from filtergraph" << ret;
                 reached_end = true;
                 break;
               } else {
 #ifdef AUDIOWARNINGS
                 dout << "reached EOF while pulling from filtergraph";
 #endif
-                if (!reverse_audio) break;
+                // TODO revise usage of reached_end in audio
+                if (!reverse_audio) {
+                  reached_end = true;
+                  break;
+                }
               }
             }
 
@@ -260,7 +257,7 @@ void Cacher::CacheAudioWorker() {
                     dout << "starting rev_frame";
 #endif
                     rev_frame->nb_samples = 0;
-                    rev_frame->pts = frame_->pkt_pts;
+                    rev_frame->pts = source_frame->pkt_pts;
                   }
                   int offset = rev_frame->nb_samples * av_get_bytes_per_sample(static_cast<AVSampleFormat>(rev_frame->format)) * rev_frame->channels;
 #ifdef AUDIOWARNINGS
@@ -273,19 +270,19 @@ void Cacher::CacheAudioWorker() {
                       (frame->nb_samples * av_get_bytes_per_sample(static_cast<AVSampleFormat>(frame->format)) * frame->channels)
                       );
 #ifdef AUDIOWARNINGS
-                  dout << "pts:" << frame_->pts << "dur:" << frame_->pkt_duration << "rev_target:" << reverse_target << "offset:" << offset << "limit:" << rev_frame->linesize[0];
+                  dout << "pts:" << source_frame->pts << "dur:" << source_frame->pkt_duration << "rev_target:" << reverse_target << "offset:" << offset << "limit:" << rev_frame->linesize[0];
 #endif
                 }
 
                 rev_frame->nb_samples += frame->nb_samples;
 
-                if ((frame_->pts >= reverse_target_) || (ret == AVERROR_EOF)) {
+                if ((source_frame->pts >= reverse_target_) || (ret == AVERROR_EOF)) {
                   /*
 #ifdef AUDIOWARNINGS
-                  dout << "time for the end of rev cache" << rev_frame->nb_samples << clip->rev_target << frame_->pts << frame_->pkt_duration << frame_->nb_samples;
-                  dout << "diff:" << (frame_->pkt_pts + frame_->pkt_duration) - clip->rev_target;
+                  dout << "time for the end of rev cache" << rev_frame->nb_samples << clip->rev_target << source_frame->pts << source_frame->pkt_duration << source_frame->nb_samples;
+                  dout << "diff:" << (source_frame->pkt_pts + source_frame->pkt_duration) - clip->rev_target;
 #endif
-                  int cutoff = qRound64((((frame_->pkt_pts + frame_->pkt_duration) - reverse_target) * timebase) * audio_output->format().sampleRate());
+                  int cutoff = qRound64((((source_frame->pkt_pts + source_frame->pkt_duration) - reverse_target) * timebase) * audio_output->format().sampleRate());
                   if (cutoff > 0) {
 #ifdef AUDIOWARNINGS
                     dout << "cut off" << cutoff << "samples (rate:" << audio_output->format().sampleRate() << ")";
@@ -329,7 +326,7 @@ void Cacher::CacheAudioWorker() {
               dout << "loop" << loop;
 #endif
             } else {
-              frame->pts = frame_->pts;
+              frame->pts = source_frame->pts;
               break;
             }
           } while (true);
@@ -352,7 +349,7 @@ void Cacher::CacheAudioWorker() {
           // get precise sample offset for the elected clip_in from this audio frame
           double target_sts = playhead_to_clip_seconds(clip, audio_target_frame);
 
-          int64_t stream_start = qMax(static_cast<int64_t>(0), stream->start_time);
+          int64_t stream_start = qMax(static_cast<int64_t>(0), decoder_->start_time());
           double frame_sts = ((frame->pts - stream_start) * timebase);
 
           int nb_samples = qRound64((target_sts - frame_sts)*current_audio_freq());
@@ -475,6 +472,103 @@ void Cacher::CacheAudioWorker() {
   WakeAudioWakeObject();
 }
 
+void Cacher::CacheConformedAudio(long timeline_in, long timeline_out, long target_frame, long frame_skip, double frame_rate)
+{
+  const float* samples = conformed_audio_->data();
+  int64_t sample_count = conformed_audio_->sample_count();
+  int channels = conformed_audio_->channels();
+  int rate = current_audio_freq();
+
+  // how many samples of the conformed stream to move through for every sample played
+  double step = clip->speed().value
+      * clip->media()->to_footage()->speed
+      * qMax(1, qAbs(playback_speed_))
+      * (double(conformed_audio_->sample_rate()) / double(rate));
+
+  if (IsReversed()) {
+    step = -step;
+  }
+
+  if (audio_buffer_write == 0) {
+    // audio was reset, start from the sample at the playhead (or the clip's first sample if it hasn't been reached)
+    audio_buffer_write = get_buffer_offset_from_frame(frame_rate, qMax(timeline_in, target_frame));
+
+    // The buffer starts at the clip's first frame in the playback direction if the playhead hasn't reached it yet. In
+    // reverse that's the clip's last frame, which playhead_to_clip_seconds() doesn't clamp to, so clamp the playhead to
+    // the clip here so the stream position matches the frame the buffer starts at.
+    long start_frame = qBound(clip->timeline_in(true), audio_target_frame, clip->timeline_out(true) - 1);
+    conformed_position_ = playhead_to_clip_seconds(clip, start_frame) * conformed_audio_->sample_rate();
+
+    if (frame_skip > 0) {
+      qint64 target = get_buffer_offset_from_frame(frame_rate, qMax(timeline_in + frame_skip, target_frame));
+      conformed_position_ += double((target - audio_buffer_write) / channels) * step;
+      audio_buffer_write = target;
+    }
+  }
+
+  // if the output has already played past where we were going to write, skip ahead to where it is now
+  qint64 offset = audio_ibuffer_read - audio_buffer_write;
+  if (offset > 0) {
+    conformed_position_ += double(offset / channels) * step;
+    audio_buffer_write += offset;
+  }
+
+  qint64 buffer_timeline_out = get_buffer_offset_from_frame(frame_rate, timeline_out);
+
+  while (!audio_reset_) {
+    qint64 buffer_end = qMin(audio_ibuffer_read+(audio_ibuffer_size>>1), buffer_timeline_out);
+
+    int nb_samples = int(qMin(qint64(frame_->nb_samples), (buffer_end - audio_buffer_write) / channels));
+
+    if (nb_samples <= 0) {
+      break;
+    }
+
+    for (int i=0;i<nb_samples;i++) {
+      // interpolate between the two nearest samples, anything outside the stream is silent
+      int64_t index = static_cast<int64_t>(floor(conformed_position_));
+      float t = float(conformed_position_ - double(index));
+
+      for (int j=0;j<channels;j++) {
+        float a = (index >= 0 && index < sample_count) ? samples[index*channels+j] : 0.0f;
+        float b = (index+1 >= 0 && index+1 < sample_count) ? samples[(index+1)*channels+j] : 0.0f;
+
+        reinterpret_cast<float*>(frame_->data[j])[i] = a + (b - a) * t;
+      }
+
+      conformed_position_ += step;
+    }
+
+    apply_audio_effects(clip,
+                        samples_to_seconds(audio_buffer_write, 2, rate)
+                          + audio_ibuffer_timecode
+                          + (double(clip->clip_in(true))/clip->track()->sequence()->frame_rate)
+                          - (double(timeline_in)/frame_rate),
+                        frame_,
+                        nb_samples,
+                        channels,
+                        nests_);
+
+    // mix audio into internal buffer
+    audio_write_lock.lock();
+
+    for (int i=0;i<nb_samples;i++) {
+      for (int j=0;j<channels;j++) {
+        audio_ibuffer[audio_buffer_write%audio_ibuffer_size] += reinterpret_cast<float*>(frame_->data[j])[i];
+
+        audio_buffer_write++;
+      }
+    }
+
+    audio_write_lock.unlock();
+
+    if (scrubbing_) {
+      if (audio_thread != nullptr) audio_thread->notifyReceiver();
+      break;
+    }
+  }
+}
+
 bool Cacher::IsReversed()
 {
   // Here, the Clip reverse and reversed playback speed cancel each other out to produce normal playback
@@ -496,97 +590,79 @@ void Cacher::CacheVideoWorker() {
       // main thread waits until cacher starts fully, wake it up here
       WakeMainThread();
 
-      AVFrame* still_image_frame;
+      AVFrame* still_image_frame = olive::frame_pool.Get();
 
-      if (RetrieveFrameAndProcess(&still_image_frame) >= 0) {
+      // if another clip has already decoded this image, share its frame rather than decoding it again
+      if (olive::still_image_cache.GetFrame(still_image_key_, still_image_frame)) {
 
-        queue_.lock();
         queue_.append(still_image_frame);
-        queue_.unlock();
 
         SetRetrievedFrame(still_image_frame);
-      }
 
-    }
+      } else {
 
-  } else {
-    // this media is not a still image and will require more complex caching
+        olive::frame_pool.Release(still_image_frame);
 
-    // main thread waits until cacher starts fully, wake it up here
-    WakeMainThread();
+        if (RetrieveFrameAndProcess(&still_image_frame) >= 0) {
 
-    // determine if this media is reversed, which will affect how the queue is constructed
-    bool reversed = IsReversed();
+          olive::still_image_cache.AddFrame(still_image_key_, still_image_frame);
 
-    // get the timestamp we want in terms of the media's timebase
-    int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
+          queue_.append(still_image_frame);
 
-    // get the value of one second in terms of the media's timebase
-    int64_t second_pts = seconds_to_timestamp(clip, 1); // FIXME: possibly magic number?
+          SetRetrievedFrame(still_image_frame);
 
-    // check which range of frames we have in the queue
-    int64_t earliest_pts = INT64_MAX;
-    int64_t latest_pts = INT64_MIN;
-    int frames_greater_than_target = 0;
+        } else {
 
-    for (int i=0;i<queue_.size();i++) {
-      // cache earliest and latest timestamps in the queue
-      earliest_pts = qMin(earliest_pts, queue_.at(i)->pts);
-      latest_pts = qMax(latest_pts, queue_.at(i)->pts);
+          olive::frame_pool.Release(still_image_frame);
+
+        }
 
-      // count upcoming frames
-      if (queue_.at(i)->pts > target_pts) {
-        frames_greater_than_target++;
       }
-    }
 
-    // If we have to seek ahead, we may want to re-use the frame we retrieved later in the pipeline.
-    AVFrame* decoded_frame;
-    bool have_existing_frame_to_use = false;
-    bool seeked_to_zero = false;
+    }
 
-    // check if the frame is within this queue or if we'll have to seek elsewhere to get it
-    // (we check for one second of time after latest_pts, because if it's within that range it'll likely be faster to
-    // play up to that frame than seek to it)
-    if (target_pts < earliest_pts || target_pts > latest_pts + second_pts || queue_.size() == 0) {
-      // we need to seek to retrieve this frame
+  } else if (IsReversed()) {
 
-      int retrieve_code;
-      int64_t seek_ts = target_pts;
-      int64_t zero = 0;
+    // main thread waits until cacher starts fully, wake it up here
+    WakeMainThread();
 
-      // Some formats don't seek reliably to the last keyframe, as a result we need to seek in a loop to ensure we
-      // get a frame prior to the timestamp
-      do {
+    // reversed media is decoded a GOP at a time rather than with the queue settings below
+    decoder_->SetReversed(true);
+    SetFrameDiscard(qAbs(playback_speed_) >= kFastShuttleSpeed ? AVDISCARD_NONREF : AVDISCARD_DEFAULT);
+    decoder_seek_pts_ = AV_NOPTS_VALUE;
+    CacheReverseVideoWorker(seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_)));
 
-        // if we already allocated a frame here, we'd better free it
-        if (have_existing_frame_to_use) {
-          av_frame_free(&decoded_frame);
-        }
+  } else {
+    // this media is not a still image and will require more complex caching
 
-        // If we already seeked to a timestamp of zero, there's no further we can go, so we have to exit the loop if so
-        seeked_to_zero = (seek_ts == 0);
+    // main thread waits until cacher starts fully, wake it up here
+    WakeMainThread();
 
-        avcodec_flush_buffers(codecCtx);
-        av_seek_frame(formatCtx, clip->media_stream_index(), seek_ts, AVSEEK_FLAG_BACKWARD);
+    // we're playing forwards, so any GOP decoded ahead for reversed playback is no longer needed
+    ClearReverseBuffer();
+    decoder_->SetReversed(false);
 
-        retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+    // when shuttling quickly, most frames wouldn't be shown anyway
+    AVDiscard discard = (qAbs(playback_speed_) >= kFastShuttleSpeed) ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    SetFrameDiscard(discard);
 
-        //qDebug() << "Target:" << target_pts << "Seek:" << seek_ts << "Frame:" << decoded_frame->pts;
+    // get the timestamp we want in terms of the media's timebase
+    int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
 
-        seek_ts = qMax(zero, seek_ts - second_pts);
+    // get the value of one second in terms of the media's timebase
+    int64_t second_pts = seconds_to_timestamp(clip, 1); // FIXME: possibly magic number?
 
-        have_existing_frame_to_use = true;
-      } while (retrieve_code >= 0 && decoded_frame->pts > target_pts && !seeked_to_zero);
+    // check which range of frames we have in the queue (the queue is ordered by timestamp)
+    int64_t earliest_pts = INT64_MAX;
+    int64_t latest_pts = INT64_MIN;
+    int frames_greater_than_target = 0;
 
-      // also we assume none of the frames in the queue are usable
-      queue_.lock();
-      queue_.clear();
-      queue_.unlock();
+    if (!queue_.isEmpty()) {
+      earliest_pts = queue_.first()->pts;
+      latest_pts = queue_.last()->pts;
 
-      // reset upcoming frame count and latest pts for later calculations
-      frames_greater_than_target = 0;
-      latest_pts = INT64_MIN;
+      // count upcoming frames
+      frames_greater_than_target = queue_.size() - queue_.upperBound(target_pts);
     }
 
     // get values on old frames to remove from the queue
@@ -602,22 +678,10 @@ void Cacher::CacheVideoWorker() {
     int64_t maximum_ts;
 
     // Get queue configuration
-    int previous_queue_type, upcoming_queue_type;
-    double previous_queue_size, upcoming_queue_size;
-
-    // For reversed playback, we flip the queue stats as "upcoming" frames are going to be played before the "previous"
-    // frames now
-    if (reversed) {
-      previous_queue_type = olive::config.upcoming_queue_type;
-      previous_queue_size = olive::config.upcoming_queue_size;
-      upcoming_queue_type = olive::config.previous_queue_type;
-      upcoming_queue_size = olive::config.previous_queue_size;
-    } else {
-      previous_queue_type = olive::config.previous_queue_type;
-      previous_queue_size = olive::config.previous_queue_size;
-      upcoming_queue_type = olive::config.upcoming_queue_type;
-      upcoming_queue_size = olive::config.upcoming_queue_size;
-    }
+    int previous_queue_type = olive::config.previous_queue_type;
+    double previous_queue_size = olive::config.previous_queue_size;
+    int upcoming_queue_type = olive::config.upcoming_queue_type;
+    double upcoming_queue_size = olive::config.upcoming_queue_size;
 
     // Determine "previous" queue statistics
     if (previous_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
@@ -636,6 +700,35 @@ void Cacher::CacheVideoWorker() {
       maximum_ts = qRound(target_pts + second_pts * upcoming_queue_size);
     }
 
+    bool use_earliest_frame = false;
+
+    // check if the frame is within this queue or if we'll have to seek elsewhere to get it
+    // (we check for one second of time after latest_pts, because if it's within that range it'll likely be faster to
+    // play up to that frame than seek to it)
+    if (target_pts < earliest_pts || target_pts > latest_pts + second_pts || queue_.size() == 0) {
+      // we need to seek to retrieve this frame (the decoder will decide whether it actually needs to seek or can just
+      // continue from where it is). The seek happens on the first retrieval in the loop below, so nothing gets decoded
+      // if the frame cache already has all the frames we need.
+      decoder_seek_pts_ = target_pts;
+
+      // also we assume none of the frames in the queue are usable
+      queue_.clear();
+
+      // reset upcoming frame count and latest pts for later calculations
+      frames_greater_than_target = 0;
+      latest_pts = INT64_MIN;
+
+      // frames of this media decoded recently (even by a clip that has since closed) may still be in the frame cache,
+      // in which case they can be shown right away and decoding only has to continue after them
+      if (RestoreFromFrameCache(target_pts, upcoming_queue_type, maximum_ts)) {
+        SetRetrievedFrame(queue_.first());
+
+        latest_pts = queue_.last()->pts;
+        frames_greater_than_target = queue_.size() - queue_.upperBound(target_pts);
+        decoder_seek_pts_ = latest_pts;
+      }
+    }
+
     // if we already have the maximum number of upcoming frames, don't bother running the retrieving any frames at all
     bool start_loop = true;
     if ((upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES && frames_greater_than_target >= maximum_ts)
@@ -650,13 +743,49 @@ void Cacher::CacheVideoWorker() {
       do {
 
         // retrieve raw RGBA frame from decoder + filter stack
-        int retrieve_code = 0;
+        AVFrame* decoded_frame;
+        int retrieve_code;
 
-        // if we retrieved a perfectly good frame earlier by checking the seek, use that here
-        if (!have_existing_frame_to_use) {
-          retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+        // set if this is a keyframe to show until the decoder reaches the target frame
+        bool approximate_frame = false;
+
+        if (decoder_seek_pts_ != AV_NOPTS_VALUE) {
+          // when scrubbing, only decode the keyframe at first so that something can be shown right away (it can take
+          // a while to decode from there to the target in long GOP media)
+          bool keyframe_only = (keyframe_seek_ && retrieved_frame == nullptr);
+
+          if (keyframe_only) {
+            SetFrameDiscard(AVDISCARD_NONKEY);
+          }
+
+          decoded_frame = olive::frame_pool.Get();
+
+          frame_cache_previous_pts_ = AV_NOPTS_VALUE;
+          retrieve_code = decoder_->RetrieveFrameAt(decoder_seek_pts_, decoded_frame);
+
+          decoder_seek_pts_ = AV_NOPTS_VALUE;
+
+          if (keyframe_only) {
+            SetFrameDiscard(discard);
+
+            if (retrieve_code >= 0 && decoded_frame->pts != AV_NOPTS_VALUE) {
+              approximate_frame = (decoded_frame->pts < target_pts);
+
+              // no other frames were decoded after the keyframe, so seek back to it to decode them
+              decoder_seek_pts_ = decoded_frame->pts;
+            }
+          }
+
+          if (retrieve_code >= 0) {
+            // If we still got a frame after the target timestamp, it means this was somehow the earliest frame we could
+            // get
+            use_earliest_frame = (decoded_frame->pts > target_pts);
+          } else {
+            olive::frame_pool.Release(decoded_frame);
+            retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+          }
         } else {
-          have_existing_frame_to_use = false;
+          retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
         }
 
         if (retrieve_code < 0 && retrieve_code != AVERROR_EOF) {
@@ -665,20 +794,28 @@ void Cacher::CacheVideoWorker() {
           // again, an EOF isn't an "error" but will how we add frames (see below)
 
           qCritical() << "Failed to retrieve frame from buffersink." << retrieve_code;
+          frame_cache_previous_pts_ = AV_NOPTS_VALUE;
           break;
 
         } else if (decoded_frame->pts != AV_NOPTS_VALUE) {
 
-          // check if this frame exceeds the minimum timestamp
-          if (previous_queue_type == olive::FRAME_QUEUE_TYPE_SECONDS
-              && decoded_frame->pts < minimum_ts) {
+          AddToFrameCache(decoded_frame);
+
+          if (!queue_.isEmpty() && decoded_frame->pts <= queue_.last()->pts) {
+
+            // we already have this frame from the frame cache
+            olive::frame_pool.Release(decoded_frame);
+
+          } else if (previous_queue_type == olive::FRAME_QUEUE_TYPE_SECONDS
+                     && decoded_frame->pts < minimum_ts
+                     && !approximate_frame) {
 
-            // if so, we don't need it
-            av_frame_free(&decoded_frame);
+            // this frame is older than the minimum timestamp, so we don't need it
+            olive::frame_pool.Release(decoded_frame);
 
           } else {
 
-            if (retrieved_frame == nullptr) {
+            if (retrieved_frame == nullptr || retrieved_frame_approximate_) {
               if (decoded_frame->pts == target_pts) {
 
                 // We retrieved the exact frame we're looking for
@@ -691,54 +828,45 @@ void Cacher::CacheVideoWorker() {
 
                   SetRetrievedFrame(queue_.last());
 
-                } else if (seeked_to_zero) {
+                } else if (use_earliest_frame) {
 
                   // If this flag is set but we still got a frame after the target timestamp, it means this was somehow
                   // the earliest frame we could get
                   SetRetrievedFrame(decoded_frame);
-                  seeked_to_zero = false;
+                  use_earliest_frame = false;
 
                 }
 
+              } else if (approximate_frame) {
+
+                SetRetrievedFrame(decoded_frame, true);
+
               }
             }
 
             // add the frame to the queue
-            queue_.lock();
             queue_.append(decoded_frame);
-            queue_.unlock();
 
-            // check the amount of previous frames in the queue by using the current queue size for if we need to
-            // remove any old entries (assumes the queue is chronological)
+            // check the amount of previous frames in the queue for if we need to remove any old entries
             if (previous_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
 
-              int previous_frame_count = 0;
-
-              if (decoded_frame->pts < target_pts) {
-                // if this frame is before the target frame, make sure we don't add too many of them
-                previous_frame_count = queue_.size();
-              } else {
-                // if this frame is after the target frame, clean up any previous frames before it
-                // TODO is there a faster way to do this?
-
-                for (int i=0;i<queue_.size();i++) {
-                  if (queue_.at(i)->pts > target_pts) {
-                    break;
-                  } else {
-                    previous_frame_count++;
-                  }
-                }
-
-              }
+              // the queue is chronological, so every frame up to the first one after the target is a previous frame
+              int previous_frame_count = queue_.upperBound(target_pts);
 
               // remove frames while the amount of previous frames exceeds the maximum
               while (previous_frame_count > minimum_ts) {
-                queue_.lock();
                 queue_.removeFirst();
-                queue_.unlock();
                 previous_frame_count--;
               }
 
+            } else if (!approximate_frame) {
+
+              // remove frames that have fallen behind the minimum timestamp (a keyframe we've only just started showing
+              // is likely to be behind it too, but is kept until the frames after it come in)
+              while (!queue_.isEmpty() && queue_.first()->pts < minimum_ts) {
+                queue_.removeFirst();
+              }
+
             }
 
             // check if the queue is full according to olive::CurrentConfig
@@ -769,9 +897,12 @@ void Cacher::CacheVideoWorker() {
           // if a frame has no timestamp (pts == AV_NOPTS_VALUE), we assume it's an invalid frame and don't use it
 
           qWarning() << clip->name() << "frame had no PTS value";
-          av_frame_free(&decoded_frame);
+          olive::frame_pool.Release(decoded_frame);
+          frame_cache_previous_pts_ = AV_NOPTS_VALUE;
 
-          if (retrieve_code == AVERROR_EOF && retrieved_frame == nullptr && !queue_.isEmpty()) {
+          if (retrieve_code == AVERROR_EOF
+              && (retrieved_frame == nullptr || retrieved_frame_approximate_)
+              && !queue_.isEmpty()) {
             // if we reached the end of the file, it's not an error but there are no more frames to retrieve
             // some formats EOF before the end of the duration that Olive calculates. In this event, we simply
             // return the last frame we retrieved
@@ -793,6 +924,20 @@ void Cacher::CacheVideoWorker() {
 
     }
 
+    // if decoding stopped short of the target without being interrupted by another request, the approximate frame is
+    // as good as it gets
+    if (!interrupt_ && retrieved_frame_approximate_) {
+      retrieve_lock_.lock();
+      retrieved_frame_approximate_ = false;
+      retrieve_lock_.unlock();
+    }
+
+    // during playback, copy the frames about to be shown into the clip's upload ring so the render thread only has to
+    // transfer them into the texture
+    if (playback_speed_ != 0) {
+      StageUpcomingFrames(target_pts);
+    }
+
   }
 
   // For some reason we couldn't get the frame, we should wake up the RenderThread anyway
@@ -802,6 +947,224 @@ void Cacher::CacheVideoWorker() {
   }
 }
 
+void Cacher::CacheReverseVideoWorker(int64_t target_pts)
+{
+  // the memory budget is shared with every other video clip, so our share changes as clips open and close
+  reverse_frame_limit_ = int(qBound(int64_t(2),
+                                    olive::decode_scheduler.ReverseBufferBytes(this) / reverse_frame_bytes_,
+                                    int64_t(kMaxReverseFrames)));
+
+  // check whether the frame is within the GOP we're currently serving
+  bool in_queue = (!queue_.isEmpty()
+                   && queue_.first()->pts <= target_pts
+                   && target_pts <= queue_.last()->pts);
+
+  if (!in_queue) {
+    QVector<AVFrame*> frames;
+
+    if (!reverse_buffer_.isEmpty()
+        && reverse_buffer_.first()->pts <= target_pts
+        && target_pts < reverse_buffer_end_) {
+
+      // the target has moved into the GOP we decoded ahead of time
+      frames = reverse_buffer_;
+      reverse_buffer_.clear();
+
+    } else {
+
+      // we've jumped somewhere else entirely, decode the GOP containing the target now
+      ClearReverseBuffer();
+      DecodeReverseSpan(target_pts, frames, false);
+
+    }
+
+    queue_.clear();
+
+    for (int i=0;i<frames.size();i++) {
+      queue_.append(frames.at(i));
+    }
+  }
+
+  if (queue_.isEmpty()) {
+    return;
+  }
+
+  // if the stream starts after the target, the earliest frame is the best we can do
+  SetRetrievedFrame(queue_.at(qMax(0, queue_.upperBound(target_pts) - 1)));
+
+  // decode the previous GOP while the render thread works backwards through this one
+  int64_t prefetch_end = queue_.first()->pts;
+
+  if (reverse_buffer_end_ != prefetch_end) {
+    ClearReverseBuffer();
+
+    interrupt_ = false;
+
+    if (DecodeReverseSpan(prefetch_end - 1, reverse_buffer_, true)) {
+
+      // if we're at the start of the stream, the earliest frame we got back is already in the queue
+      while (!reverse_buffer_.isEmpty() && reverse_buffer_.last()->pts >= prefetch_end) {
+        olive::frame_pool.Release(reverse_buffer_.takeLast());
+      }
+
+      reverse_buffer_end_ = prefetch_end;
+
+    }
+  }
+}
+
+bool Cacher::DecodeReverseSpan(int64_t last_pts, QVector<AVFrame *> &frames, bool interruptible)
+{
+  // seeks to the keyframe before last_pts and retrieves it
+  AVFrame* decoded_frame = olive::frame_pool.Get();
+  frame_cache_previous_pts_ = AV_NOPTS_VALUE;
+  int retrieve_code = decoder_->RetrieveFrameAt(last_pts, decoded_frame);
+
+  while (retrieve_code >= 0) {
+
+    AddToFrameCache(decoded_frame);
+
+    if (decoded_frame->pts == AV_NOPTS_VALUE) {
+
+      // frames without a timestamp can't be ordered, so we can't use them
+      olive::frame_pool.Release(decoded_frame);
+
+    } else if (decoded_frame->pts > last_pts && !frames.isEmpty()) {
+
+      // we've reached the end of the span
+      olive::frame_pool.Release(decoded_frame);
+      return true;
+
+    } else {
+
+      frames.append(decoded_frame);
+
+      // keep the buffer bounded, the frames nearest to last_pts are the ones needed first
+      if (frames.size() > reverse_frame_limit_) {
+        olive::frame_pool.Release(frames.takeFirst());
+      }
+
+      // the earliest frame in the stream is after last_pts, so there's nothing else to decode
+      if (decoded_frame->pts > last_pts) {
+        return true;
+      }
+
+    }
+
+    if (interruptible && interrupt_) {
+      for (int i=0;i<frames.size();i++) {
+        olive::frame_pool.Release(frames.at(i));
+      }
+      frames.clear();
+      return false;
+    }
+
+    retrieve_code = RetrieveFrameAndProcess(&decoded_frame);
+  }
+
+  olive::frame_pool.Release(decoded_frame);
+
+  if (retrieve_code != AVERROR_EOF) {
+    qCritical() << "Failed to retrieve frame for reverse playback." << retrieve_code;
+
+    for (int i=0;i<frames.size();i++) {
+      olive::frame_pool.Release(frames.at(i));
+    }
+    frames.clear();
+    return false;
+  }
+
+  return true;
+}
+
+void Cacher::ClearReverseBuffer()
+{
+  for (int i=0;i<reverse_buffer_.size();i++) {
+    olive::frame_pool.Release(reverse_buffer_.at(i));
+  }
+  reverse_buffer_.clear();
+
+  reverse_buffer_end_ = AV_NOPTS_VALUE;
+}
+
+bool Cacher::RestoreFromFrameCache(int64_t target_pts, int upcoming_queue_type, int64_t maximum_ts)
+{
+  if (frame_cache_key_.isEmpty()) {
+    return false;
+  }
+
+  AVFrame* frame = olive::frame_pool.Get();
+  int64_t next_pts;
+
+  if (!olive::frame_cache.Get(frame_cache_key_, target_pts, frame, &next_pts)) {
+    olive::frame_pool.Release(frame);
+    return false;
+  }
+
+  queue_.append(frame);
+
+  // follow the frames that were decoded after this one for as long as there's room for upcoming frames (every frame
+  // after the one shown at target_pts is later than target_pts)
+  int upcoming_frames = 0;
+
+  while (next_pts != AV_NOPTS_VALUE) {
+    if (upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES) {
+      if (upcoming_frames >= maximum_ts) {
+        break;
+      }
+    } else if (queue_.last()->pts > maximum_ts) {
+      break;
+    }
+
+    frame = olive::frame_pool.Get();
+
+    if (!olive::frame_cache.Get(frame_cache_key_, next_pts, frame, &next_pts)) {
+      olive::frame_pool.Release(frame);
+      break;
+    }
+
+    queue_.append(frame);
+    upcoming_frames++;
+  }
+
+  return true;
+}
+
+void Cacher::AddToFrameCache(AVFrame *f)
+{
+  if (frame_cache_key_.isEmpty()) {
+    return;
+  }
+
+  if (f->pts == AV_NOPTS_VALUE) {
+    // we can't tell which frames this one is between, so don't link the next frame to the one before it
+    frame_cache_previous_pts_ = AV_NOPTS_VALUE;
+    return;
+  }
+
+  olive::frame_cache.Add(frame_cache_key_, f, frame_cache_previous_pts_);
+
+  // frames are only known to follow each other directly if the decoder isn't skipping any
+  frame_cache_previous_pts_ = (frame_discard_ == AVDISCARD_DEFAULT) ? f->pts : AV_NOPTS_VALUE;
+}
+
+void Cacher::StageUpcomingFrames(int64_t target_pts)
+{
+  for (int i=queue_.upperBound(target_pts);i<queue_.size() && !interrupt_;i++) {
+    AVFrame* frame = queue_.at(i);
+
+    // planar YUV frames are uploaded a plane at a time to be converted on the GPU, so they aren't staged
+    if (!(av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format))->flags & AV_PIX_FMT_FLAG_RGB)) {
+      break;
+    }
+
+    // the render thread has already moved past anything before the target, so those slots can be reused
+    if (!upload_ring_.Stage(frame->pts, frame, frame->height, target_pts)) {
+      break;
+    }
+  }
+}
+
 void Cacher::Reset() {
   // if we seek to a whole other place in the timeline, we'll need to reset the cache with new values
   if (clip->media() == nullptr) {
@@ -814,43 +1177,71 @@ void Cacher::Reset() {
     }
   } else {
 
-    const FootageStream* ms = clip->media_stream();
-    if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-      // flush ffmpeg codecs
-      avcodec_flush_buffers(codecCtx);
+    if (clip->type() == olive::kTypeAudio) {
       reached_end = false;
 
       // seek (target_frame represents timeline timecode in frames, not clip timecode)
 
-      int64_t timestamp = qRound64(playhead_to_clip_seconds(clip, playhead_) / av_q2d(stream->time_base));
+      int64_t timestamp = qRound64(playhead_to_clip_seconds(clip, playhead_) / av_q2d(decoder_->time_base()));
 
       bool temp_reverse = (playback_speed_ < 0);
       if (clip->reversed() != temp_reverse) {
         reverse_target_ = timestamp;
-        timestamp -= av_q2d(av_inv_q(stream->time_base));
+        timestamp -= av_q2d(av_inv_q(decoder_->time_base()));
 #ifdef AUDIOWARNINGS
         dout << "seeking to" << timestamp << "(originally" << reverse_target << ")";
       } else {
         dout << "reset called; seeking to" << timestamp;
 #endif
       }
-      av_seek_frame(formatCtx, ms->file_index, timestamp, AVSEEK_FLAG_BACKWARD);
+
+      // flush ffmpeg codecs and seek (conformed audio doesn't use the decoder)
+      if (conformed_audio_ == nullptr) {
+        decoder_->Seek(timestamp);
+      }
       audio_target_frame = playhead_;
       frame_sample_index_ = -1;
     }
   }
 }
 
-void Cacher::SetRetrievedFrame(AVFrame *f)
+void Cacher::SetRetrievedFrame(AVFrame *f, bool approximate)
 {
-  if (retrieved_frame == nullptr) {
+  if (retrieved_frame == nullptr || (retrieved_frame_approximate_ && f != nullptr)) {
     retrieve_lock_.lock();
     retrieved_frame = f;
+    retrieved_pts_ = (f != nullptr) ? f->pts : 0;
+    retrieved_frame_approximate_ = approximate;
+    approximate_playhead_ = playhead_;
     retrieve_wait_.wakeAll();
     retrieve_lock_.unlock();
   }
 }
 
+void Cacher::SetFrameDiscard(AVDiscard discard)
+{
+  if (frame_discard_ == discard) {
+    return;
+  }
+
+  // frames decoded while skipping non-reference frames have gaps between them, so the queue can't be trusted to have
+  // the exact frame at a timestamp anymore
+  if (frame_discard_ == AVDISCARD_NONREF) {
+    queue_.clear();
+    ClearReverseBuffer();
+  }
+
+  // after only decoding keyframes, the decoder has to seek before it can decode every frame again
+  if (frame_discard_ == AVDISCARD_NONKEY && !queue_.isEmpty()) {
+    decoder_seek_pts_ = queue_.last()->pts;
+  }
+
+  frame_discard_ = discard;
+  frame_cache_previous_pts_ = AV_NOPTS_VALUE;
+
+  decoder_->SetFrameDiscard(discard);
+}
+
 void Cacher::WakeMainThread()
 {
   main_thread_lock_.lock();
@@ -860,13 +1251,15 @@ void Cacher::WakeMainThread()
 
 Cacher::Cacher(Clip* c) :
   clip(c),
+  decoder_(&ffmpeg_decoder_),
+  decode_threads_(0),
   frame_(nullptr),
-  pkt(nullptr),
-  formatCtx(nullptr),
-  opts(nullptr),
-  filter_graph(nullptr),
-  codecCtx(nullptr),
-  is_valid_state_(false)
+  conformed_position_(0),
+  is_valid_state_(false),
+  frame_discard_(AVDISCARD_DEFAULT),
+  retrieved_frame_approximate_(false),
+  approximate_playhead_(0),
+  keyframe_seek_(false)
 {}
 
 void Cacher::OpenWorker() {
@@ -877,6 +1270,13 @@ void Cacher::OpenWorker() {
     audio_buffer_write = 0;
   }
   reached_end = false;
+  reverse_buffer_end_ = AV_NOPTS_VALUE;
+  reverse_frame_limit_ = 2;
+  reverse_frame_bytes_ = 1;
+  decoder_seek_pts_ = AV_NOPTS_VALUE;
+  frame_cache_previous_pts_ = AV_NOPTS_VALUE;
+  frame_discard_ = AVDISCARD_DEFAULT;
+  retrieved_frame_approximate_ = false;
 
   if (clip->media() == nullptr) {
     if (clip->type() == olive::kTypeAudio) {
@@ -896,147 +1296,91 @@ void Cacher::OpenWorker() {
     // opens file resource for FFmpeg and prepares Clip struct for playback
     Footage* m = clip->media()->to_footage();
 
-    // byte array for retrieving raw bytes from QString URL
-    QByteArray ba;
-
     // do we have a proxy?
+    QString filename;
     if ((!olive::Global->is_exporting() || !olive::config.dont_use_proxies_on_export)
         && m->proxy
         && !m->proxy_path.isEmpty()
         && QFileInfo::exists(m->proxy_path)) {
-      ba = m->proxy_path.toUtf8();
+      filename = m->proxy_path;
     } else {
-      ba = m->url.toUtf8();
+      filename = m->url;
     }
 
-    const char* filename = ba.constData();
     const FootageStream* ms = clip->media_stream();
 
-    // for image sequences that don't start at 0, set the index where it does start
-    AVDictionary* format_opts = nullptr;
-    if (m->start_number > 0) {
-      av_dict_set(&format_opts, "start_number", QString::number(m->start_number).toUtf8(), 0);
-    }
-
-    formatCtx = nullptr;
-    int errCode = avformat_open_input(
-          &formatCtx,
-          filename,
-          nullptr,
-          &format_opts
-          );
-    if (errCode != 0) {
-      char err[1024];
-      av_strerror(errCode, err, 1024);
-      qCritical() << "Could not open" << filename << "-" << err;
-      olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
-      return;
+    DecoderParams params;
+    params.filename = filename;
+    params.stream_index = ms->file_index;
+    params.start_number = m->start_number;
+    params.video_interlacing = ms->video_interlacing;
+    params.video_native_yuv = !olive::config.use_software_fallback;
+    params.video_divider = olive::Global->is_exporting() ? 1 : olive::config.playback_resolution_divider;
+    params.threads = decode_threads_;
+    params.audio_sample_rate = current_audio_freq();
+    params.audio_speed = clip->speed().value * m->speed;
+    params.audio_maintain_pitch = clip->speed().maintain_audio_pitch;
+
+    // image sequences are decoded in parallel, everything else goes through FFmpeg's demuxers directly
+    if (clip->type() == olive::kTypeVideo
+        && !ms->infinite_length
+        && params.video_interlacing == VIDEO_PROGRESSIVE
+        && ImageSequenceDecoder::IsImageSequence(filename)) {
+      decoder_ = &image_sequence_decoder_;
+    } else {
+      decoder_ = &ffmpeg_decoder_;
     }
 
-    errCode = avformat_find_stream_info(formatCtx, nullptr);
-    if (errCode < 0) {
-      char err[1024];
-      av_strerror(errCode, err, 1024);
-      qCritical() << "Could not open" << filename << "-" << err;
-      olive::MainWindow->statusBar()->showMessage(tr("Could not open %1 - %2").arg(filename, err));
+    QString error;
+    if (!decoder_->Open(params, &error)) {
+      olive::MainWindow->statusBar()->showMessage(error);
       return;
     }
 
-    av_dump_format(formatCtx, 0, filename, 0);
-
-    stream = formatCtx->streams[ms->file_index];
-    codec = avcodec_find_decoder(stream->codecpar->codec_id);
-    codecCtx = avcodec_alloc_context3(codec);
-    avcodec_parameters_to_context(codecCtx, stream->codecpar);
-
-    opts = nullptr;
-
-    // enable multithreading on decoding
-    av_dict_set(&opts, "threads", "auto", 0);
-
-    // enable extra optimization code on h264 (not even sure if they help)
-    if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
-      av_dict_set(&opts, "tune", "fastdecode", 0);
-      av_dict_set(&opts, "tune", "zerolatency", 0);
-    }
-
-    // Open codec
-    if (avcodec_open2(codecCtx, codec, &opts) < 0) {
-      qCritical() << "Could not open codec";
-    }
-
-    // allocate filtergraph
-    filter_graph = avfilter_graph_alloc();
-    if (filter_graph == nullptr) {
-      qCritical() << "Could not create filtergraph";
-    }
-    char filter_args[512];
-
-    if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
-      snprintf(filter_args, sizeof(filter_args), "video_size=%dx%d:pix_fmt=%d:time_base=%d/%d:pixel_aspect=%d/%d",
-               stream->codecpar->width,
-               stream->codecpar->height,
-               stream->codecpar->format,
-               stream->time_base.num,
-               stream->time_base.den,
-               stream->codecpar->sample_aspect_ratio.num,
-               stream->codecpar->sample_aspect_ratio.den
-               );
-
-      avfilter_graph_create_filter(&buffersrc_ctx, avfilter_get_by_name("buffer"), "in", filter_args, nullptr, filter_graph);
-      avfilter_graph_create_filter(&buffersink_ctx, avfilter_get_by_name("buffersink"), "out", nullptr, nullptr, filter_graph);
-
-      AVFilterContext* last_filter = buffersrc_ctx;
-
-      char filter_args[100];
-
-      if (ms->video_interlacing != VIDEO_PROGRESSIVE) {
-        AVFilterContext* yadif_filter;
-        snprintf(filter_args, sizeof(filter_args), "mode=3:parity=%d", ((ms->video_interlacing == VIDEO_TOP_FIELD_FIRST) ? 0 : 1)); // there's a CUDA version if we start using nvdec/nvenc
-        avfilter_graph_create_filter(&yadif_filter, avfilter_get_by_name("yadif"), "yadif", filter_args, nullptr, filter_graph);
-
-        avfilter_link(last_filter, 0, yadif_filter, 0);
-        last_filter = yadif_filter;
-      }
-
-      AVPixelFormat possible_pix_fmts[] = {
-        AV_PIX_FMT_RGBA,
-        AV_PIX_FMT_RGBA64,
-        AV_PIX_FMT_NONE
-      };
-
-      AVPixelFormat pix_fmt = avcodec_find_best_pix_fmt_of_list(possible_pix_fmts,
-                                                                static_cast<AVPixelFormat>(stream->codecpar->format),
-                                                                1,
-                                                                nullptr);
-
-      if (pix_fmt == AV_PIX_FMT_RGBA) {
-        qDebug() << "This is an 8-bit image.";
-        media_pixel_format_ = olive::PIX_FMT_RGBA8;
+    if (clip->type() == olive::kTypeVideo) {
+      media_pixel_format_ = decoder_->pixel_format();
+
+      // still images are decoded once and shared between every clip using them
+      if (ms->infinite_length) {
+        still_image_key_ = StillImageCache::GetKey(filename,
+                                                   ms->file_index,
+                                                   media_pixel_format_,
+                                                   params.video_native_yuv,
+                                                   params.video_divider);
+        frame_cache_key_.clear();
       } else {
-        qDebug() << "This is an HDR image.";
-        media_pixel_format_ = olive::PIX_FMT_RGBA16;
+        still_image_key_.clear();
+        frame_cache_key_ = FrameCache::GetKey(params, media_pixel_format_);
       }
 
-      const char* chosen_format = av_get_pix_fmt_name(pix_fmt);
-      snprintf(filter_args, sizeof(filter_args), "pix_fmts=%s", chosen_format);
+      // size the queue for the most frames the user's queue settings can ask for (the queue is ordered by media
+      // timestamps, so clip speed doesn't change how many frames fit in a given amount of seconds)
+      if (!ms->infinite_length) {
+        double frame_rate = qMax(ms->video_frame_rate, 1.0);
 
-      AVFilterContext* format_conv;
-      avfilter_graph_create_filter(&format_conv, avfilter_get_by_name("format"), "fmt", filter_args, nullptr, filter_graph);
-      avfilter_link(last_filter, 0, format_conv, 0);
+        int previous_frames = (olive::config.previous_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES)
+            ? qCeil(olive::config.previous_queue_size)
+            : qCeil(olive::config.previous_queue_size * frame_rate);
 
-      avfilter_link(format_conv, 0, buffersink_ctx, 0);
+        int upcoming_frames = (olive::config.upcoming_queue_type == olive::FRAME_QUEUE_TYPE_FRAMES)
+            ? qCeil(olive::config.upcoming_queue_size)
+            : qCeil(olive::config.upcoming_queue_size * frame_rate);
 
-      avfilter_graph_config(filter_graph, nullptr);
-
-    } else if (stream->codecpar->codec_type == AVMEDIA_TYPE_AUDIO) {
-      if (codecCtx->channel_layout == 0) codecCtx->channel_layout = av_get_default_channel_layout(stream->codecpar->channels);
+        // reversed playback holds a whole GOP in the queue, bounded by memory rather than the queue settings (the
+        // queue's capacity can't change once it's in use, so it has room for the most frames a GOP can ever have)
+        reverse_frame_bytes_ = qMax(int64_t(1), int64_t(decoder_->width())
+                                    * decoder_->height()
+                                    * olive::pixel_formats.at(media_pixel_format_).bytes_per_pixel);
 
+        // leave room for the target frame and some variance in the stream's frame rate
+        queue_.reserve(qMax(previous_frames + upcoming_frames + 8, kMaxReverseFrames));
+      }
+    } else {
       // set up cache
-      queue_.append(av_frame_alloc());
+      queue_.append(olive::frame_pool.Get());
 
       if (true) {
-        AVFrame* reverse_frame = av_frame_alloc();
+        AVFrame* reverse_frame = olive::frame_pool.Get();
 
         reverse_frame->format = kDestSampleFmt;
         reverse_frame->nb_samples = current_audio_freq()*10;
@@ -1047,78 +1391,28 @@ void Cacher::OpenWorker() {
         queue_.append(reverse_frame);
       }
 
-      snprintf(filter_args, sizeof(filter_args), "time_base=%d/%d:sample_rate=%d:sample_fmt=%s:channel_layout=0x%" PRIx64,
-               stream->time_base.num,
-               stream->time_base.den,
-               stream->codecpar->sample_rate,
-               av_get_sample_fmt_name(codecCtx->sample_fmt),
-               codecCtx->channel_layout
-               );
-
-      avfilter_graph_create_filter(&buffersrc_ctx, avfilter_get_by_name("abuffer"), "in", filter_args, nullptr, filter_graph);
-      avfilter_graph_create_filter(&buffersink_ctx, avfilter_get_by_name("abuffersink"), "out", nullptr, nullptr, filter_graph);
-
-      enum AVSampleFormat sample_fmts[] = { kDestSampleFmt,  static_cast<AVSampleFormat>(-1) };
-      if (av_opt_set_int_list(buffersink_ctx, "sample_fmts", sample_fmts, -1, AV_OPT_SEARCH_CHILDREN) < 0) {
-        qCritical() << "Could not set output sample format";
-      }
-
-      int64_t channel_layouts[] = { AV_CH_LAYOUT_STEREO, static_cast<AVSampleFormat>(-1) };
-      if (av_opt_set_int_list(buffersink_ctx, "channel_layouts", channel_layouts, -1, AV_OPT_SEARCH_CHILDREN) < 0) {
-        qCritical() << "Could not set output sample format";
+      // read from a conformed copy of the stream if there is one, unless it needs to be time-stretched which still has
+      // to be done while decoding
+      if (!params.audio_maintain_pitch || qFuzzyCompare(params.audio_speed, 1.0)) {
+        conformed_audio_ = olive::audio_conformer.Get(filename, ms->file_index, params.audio_sample_rate);
       }
 
-      int target_sample_rate = current_audio_freq();
-
-      double playback_speed_ = clip->speed().value * m->speed;
-
-      if (qFuzzyCompare(playback_speed_, 1.0)) {
-        avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
-      } else if (clip->speed().maintain_audio_pitch) {
-        AVFilterContext* previous_filter = buffersrc_ctx;
-        AVFilterContext* last_filter = buffersrc_ctx;
-
-        char speed_param[10];
-
-        double base = (playback_speed_ > 1.0) ? 2.0 : 0.5;
-
-        double speedlog = log(playback_speed_) / log(base);
-        int whole2 = qFloor(speedlog);
-        speedlog -= whole2;
-
-        if (whole2 > 0) {
-          snprintf(speed_param, sizeof(speed_param), "%f", base);
-          for (int i=0;i<whole2;i++) {
-            AVFilterContext* tempo_filter = nullptr;
-            avfilter_graph_create_filter(&tempo_filter, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, filter_graph);
-            avfilter_link(previous_filter, 0, tempo_filter, 0);
-            previous_filter = tempo_filter;
-          }
+      if (conformed_audio_ != nullptr) {
+        frame_ = av_frame_alloc();
+        frame_->format = kDestSampleFmt;
+        frame_->channels = conformed_audio_->channels();
+        frame_->channel_layout = av_get_default_channel_layout(frame_->channels);
+        frame_->sample_rate = current_audio_freq();
+        frame_->nb_samples = 2048;
+        if (av_frame_get_buffer(frame_, 0)) {
+          qCritical() << "Could not allocate buffer for conformed audio";
+          conformed_audio_.reset();
+          av_frame_free(&frame_);
         }
-
-        snprintf(speed_param, sizeof(speed_param), "%f", qPow(base, speedlog));
-        last_filter = nullptr;
-        avfilter_graph_create_filter(&last_filter, avfilter_get_by_name("atempo"), "atempo", speed_param, nullptr, filter_graph);
-        avfilter_link(previous_filter, 0, last_filter, 0);
-
-        avfilter_link(last_filter, 0, buffersink_ctx, 0);
-      } else {
-        target_sample_rate = qRound64(target_sample_rate / playback_speed_);
-        avfilter_link(buffersrc_ctx, 0, buffersink_ctx, 0);
-      }
-
-      int sample_rates[] = { target_sample_rate, 0 };
-      if (av_opt_set_int_list(buffersink_ctx, "sample_rates", sample_rates, 0, AV_OPT_SEARCH_CHILDREN) < 0) {
-        qCritical() << "Could not set output sample rates";
       }
 
-      avfilter_graph_config(filter_graph, nullptr);
-
       audio_reset_ = true;
     }
-
-    pkt = av_packet_alloc();
-    frame_ = av_frame_alloc();
   }
 
   qInfo() << "Clip opened on track" << clip->track();
@@ -1138,42 +1432,23 @@ void Cacher::CacheWorker() {
 
 void Cacher::CloseWorker() {
   retrieved_frame = nullptr;
-  queue_.lock();
   queue_.clear();
-  queue_.unlock();
+  ClearReverseBuffer();
 
   if (frame_ != nullptr) {
     av_frame_free(&frame_);
     frame_ = nullptr;
   }
 
-  if (pkt != nullptr) {
-    av_packet_free(&pkt);
-    pkt = nullptr;
-  }
+  conformed_audio_.reset();
 
-  if (clip->media() != nullptr && clip->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
-    if (filter_graph != nullptr) {
-      avfilter_graph_free(&filter_graph);
-      filter_graph = nullptr;
+  if (decoder_->IsOpen()) {
+    // still images only have one frame, so rewind for whichever clip uses this decoder's handles next
+    if (clip->type() == olive::kTypeVideo && clip->media_stream()->infinite_length) {
+      decoder_->Seek(0);
     }
 
-    if (codecCtx != nullptr) {
-      avcodec_close(codecCtx);
-      avcodec_free_context(&codecCtx);
-      codecCtx = nullptr;
-    }
-
-    if (opts != nullptr) {
-      av_dict_free(&opts);
-    }
-
-    // protection for get_timebase()
-    stream = nullptr;
-
-    if (formatCtx != nullptr) {
-      avformat_close_input(&formatCtx);
-    }
+    decoder_->Close();
   }
 
   qInfo() << "Clip closed on track" << clip->track();
@@ -1194,6 +1469,10 @@ void Cacher::run() {
     if (!caching_) {
       break;
     } else if (is_valid_state_) {
+      // pick up any change to our share of the cores since the last request (see DecodeScheduler)
+      decode_threads_ = olive::decode_scheduler.Threads(this);
+      decoder_->SetThreadCount(decode_threads_);
+
       CacheWorker();
     } else {
       // main thread waits until cacher starts fully, but the cacher can't run, so we just wake it up here
@@ -1205,6 +1484,8 @@ void Cacher::run() {
 
   CloseWorker();
 
+  olive::decode_scheduler.Unregister(this);
+
   clip->state_change_lock.unlock();
 
   clip->cache_lock.unlock();
@@ -1218,7 +1499,11 @@ void Cacher::Open()
   caching_ = true;
   queued_ = false;
 
-  start((clip->type() == olive::kTypeVideo) ? QThread::HighPriority : QThread::TimeCriticalPriority);
+  // get a share of the CPU from the decode scheduler rather than assuming we're the only decoder running
+  DecodeAllocation allocation = olive::decode_scheduler.Register(this, clip->type(), 0);
+  decode_threads_ = allocation.threads;
+
+  start(allocation.priority);
 }
 
 void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playback_speed)
@@ -1231,10 +1516,18 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   if (clip->media_stream() != nullptr
       && queue_.size() > 0
       && clip->media_stream()->infinite_length) {
-    retrieved_frame = queue_.at(0);
+    retrieved_frame = queue_.at(0, &retrieved_pts_);
     return;
   }
 
+  // let the decode scheduler know how soon this clip's frames are needed (e.g. if it was opened ahead of time)
+  olive::decode_scheduler.Update(this,
+                                 qMax(0.0, double(clip->timeline_in(true) - playhead) / clip->track()->sequence()->frame_rate));
+
+  // while scrubbing or shuttling quickly, it's more important to show something quickly than to show the exact frame
+  // (see CacheVideoWorker())
+  keyframe_seek_ = (scrubbing || qAbs(playback_speed) >= kFastShuttleSpeed);
+
   playhead_ = playhead;
   nests_ = nests;
   scrubbing_ = scrubbing;
@@ -1244,30 +1537,30 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   bool wait_for_cacher_to_respond = true;
 
   if (clip->media() != nullptr) {
-    // see if we already have this frame
+    // see if we already have this frame (either with the exact timestamp or a close timestamp that we'll assume is
+    // different due to a rounding error)
     retrieve_lock_.lock();
-    queue_.lock();
-    retrieved_frame = nullptr;
     int64_t target_pts = seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead_));
-    for (int i=0;i<queue_.size();i++) {
 
-      if (queue_.at(i)->pts == target_pts) {
-
-        // the queue has a frame with the exact timestamp
-
-        retrieved_frame = queue_.at(i);
-        wait_for_cacher_to_respond = false;
-        break;
-      } else if (i > 0 && queue_.at(i-1)->pts < target_pts && queue_.at(i)->pts > target_pts) {
-
-        // the queue has a frame with a close timestamp that we'll assume is different due to a rounding error
+    if (frame_discard_ == AVDISCARD_NONREF && qAbs(playback_speed) < kFastShuttleSpeed) {
+      // the queue has gaps from shuttling quickly, so any frame we'd find may not be the exact one
+      retrieved_frame = nullptr;
+    } else {
+      retrieved_frame = queue_.find(target_pts, &retrieved_pts_);
+    }
 
-        retrieved_frame = queue_.at(i-1);
-        wait_for_cacher_to_respond = false;
-        break;
-      }
+    if (retrieved_frame == nullptr
+        && retrieved_frame_approximate_
+        && playhead == approximate_playhead_
+        && !queue_.isEmpty()) {
+      // the cacher is still decoding from the keyframe it showed for this frame, show the closest frame it has decoded
+      // so far rather than wait for it
+      retrieved_frame = queue_.last(&retrieved_pts_);
+    } else {
+      retrieved_frame_approximate_ = false;
     }
-    queue_.unlock();
+
+    wait_for_cacher_to_respond = (retrieved_frame == nullptr);
     retrieve_lock_.unlock();
   }
 
@@ -1289,7 +1582,57 @@ void Cacher::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int pla
   }
 }
 
-AVFrame *Cacher::Retrieve()
+void Cacher::Preroll(long playhead, QVector<Clip *> &nests, int playback_speed)
+{
+  if (!is_valid_state_
+      || clip->type() != olive::kTypeVideo
+      || clip->media() == nullptr
+      || clip->media_stream()->infinite_length) {
+    return;
+  }
+
+  // the first frame the playhead will reach in this direction
+  long first_frame = (playback_speed < 0) ? clip->timeline_out(true) - 1 : clip->timeline_in(true);
+
+  olive::decode_scheduler.Update(this, qAbs(first_frame - playhead) / clip->track()->sequence()->frame_rate);
+
+  // nothing to do if the frame is already waiting in the queue
+  if (queue_.find(seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, first_frame))) != nullptr) {
+    return;
+  }
+
+  playhead_ = first_frame;
+  nests_ = nests;
+  scrubbing_ = false;
+  playback_speed_ = playback_speed;
+  queued_ = true;
+
+  // wake up cacher, but unlike Cache() there's no reason to wait for it
+  wait_cond_.wakeAll();
+}
+
+bool Cacher::IsFrameQueued(long playhead)
+{
+  if (!is_valid_state_
+      || clip->type() != olive::kTypeVideo
+      || clip->media() == nullptr) {
+    return false;
+  }
+
+  // still images only ever have one frame
+  if (clip->media_stream()->infinite_length) {
+    return !queue_.isEmpty();
+  }
+
+  // same as Cache(), frames queued while shuttling quickly may not be the exact ones
+  if (frame_discard_ == AVDISCARD_NONREF && qAbs(playback_speed_) < kFastShuttleSpeed) {
+    return false;
+  }
+
+  return (queue_.find(seconds_to_timestamp(clip, playhead_to_clip_seconds(clip, playhead))) != nullptr);
+}
+
+AVFrame *Cacher::Retrieve(bool* approximate, int64_t* pts)
 {
   if (!caching_) {
     return nullptr;
@@ -1320,9 +1663,19 @@ AVFrame *Cacher::Retrieve()
 
   }
 
+  AVFrame* frame = retrieved_frame;
+
+  if (approximate != nullptr) {
+    *approximate = retrieved_frame_approximate_;
+  }
+
+  if (pts != nullptr) {
+    *pts = retrieved_pts_;
+  }
+
   retrieve_lock_.unlock();
 
-  return retrieved_frame;
+  return frame;
 }
 
 void Cacher::Close(bool wait_for_finish)
@@ -1349,17 +1702,17 @@ void Cacher::ResetAudio()
 
 int Cacher::media_width()
 {
-  return stream->codecpar->width;
+  return decoder_->width();
 }
 
 int Cacher::media_height()
 {
-  return stream->codecpar->height;
+  return decoder_->height();
 }
 
 AVRational Cacher::media_time_base()
 {
-  return stream->time_base;
+  return decoder_->time_base();
 }
 
 ClipQueue *Cacher::queue()
@@ -1367,93 +1720,25 @@ ClipQueue *Cacher::queue()
   return &queue_;
 }
 
+PixelUploadRing *Cacher::upload_ring()
+{
+  return &upload_ring_;
+}
+
 const olive::PixelFormat &Cacher::media_pixel_format()
 {
   return media_pixel_format_;
 }
 
-int Cacher::RetrieveFrameFromDecoder(AVFrame* f) {
-  int result = 0;
-  int receive_ret;
-
-  // do we need to retrieve a new packet for a new frame?
-  av_frame_unref(f);
-  while ((receive_ret = avcodec_receive_frame(codecCtx, f)) == AVERROR(EAGAIN)) {
-    int read_ret = 0;
-    do {
-      if (pkt->buf != nullptr) {
-        av_packet_unref(pkt);
-      }
-      read_ret = av_read_frame(formatCtx, pkt);
-    } while (read_ret >= 0 && pkt->stream_index != clip->media_stream_index());
-
-    if (read_ret >= 0) {
-      int send_ret = avcodec_send_packet(codecCtx, pkt);
-      if (send_ret < 0) {
-        qCritical() << "Failed to send packet to decoder." << send_ret;
-        return send_ret;
-      }
-    } else {
-      if (read_ret == AVERROR_EOF) {
-        int send_ret = avcodec_send_packet(codecCtx, nullptr);
-        if (send_ret < 0) {
-          qCritical() << "Failed to send packet to decoder." << send_ret;
-          return send_ret;
-        }
-      } else {
-        qCritical() << "Could not read frame." << read_ret;
-        return read_ret; // skips trying to find a frame at all
-      }
-    }
-  }
-  if (receive_ret < 0) {
-    if (receive_ret != AVERROR_EOF) qCritical() << "Failed to receive packet from decoder." << receive_ret;
-    result = receive_ret;
-  }
-
-  return result;
+const QString &Cacher::still_image_key()
+{
+  return still_image_key_;
 }
 
 int Cacher::RetrieveFrameAndProcess(AVFrame **f)
 {
-  // error codes from FFmpeg
-  int retrieve_code, read_code, send_code;
-
   // frame for FFmpeg to decode into
-  *f = av_frame_alloc();
-
-  // loop to pull frames from the AVFilter stack
-  while ((retrieve_code = av_buffersink_get_frame(buffersink_ctx, *f)) == AVERROR(EAGAIN)) {
-
-    // retrieve frame from decoder
-    read_code = RetrieveFrameFromDecoder(frame_);
-
-    if (read_code >= 0) {
-
-      // we retrieved a decoded video frame, which we will send to the AVFilter stack to convert to RGBA (with other
-      // adjustments if necessary)
+  *f = olive::frame_pool.Get();
 
-      if ((send_code = av_buffersrc_add_frame_flags(buffersrc_ctx, frame_, AV_BUFFERSRC_FLAG_KEEP_REF)) < 0) {
-        qCritical() << "Failed to add frame to buffer source." << send_code;
-        break;
-      }
-
-      // we don't need the original frame to we free it here
-      av_frame_unref(frame_);
-
-    } else {
-
-      // AVERROR_EOF means we've reached the end of the file, not technically an error, but it's useful to know that
-      // there are no more frames in this file
-      if (read_code != AVERROR_EOF) {
-        qCritical() << "Failed to read frame." << read_code;
-      }
-      break;
-    }
-  }
-
-  if (read_code == AVERROR_EOF) {
-    return AVERROR_EOF;
-  }
-  return retrieve_code;
+  return decoder_->RetrieveFrame(*f);
 }
@@ -42,8 +42,12 @@ extern "C" {
 #include <QWaitCondition>
 #include <QMutex>
 
+#include "decoders/ffmpegdecoder.h"
+#include "decoders/imagesequencedecoder.h"
+#include "rendering/audioconformer.h"
 #include "rendering/clipqueue.h"
 #include "rendering/pixelformats.h"
+#include "rendering/pixeluploadring.h"
 
 class Clip;
 
@@ -56,7 +60,8 @@ class Clip;
  * since video files are usually stored with frames in linear chronological order). It involves decoding routines to
  * retrieve raw frames from the file (using libavformat/libavcodec), conversion routines to conform the raw frames to
  * RGBA/S16LE for the rest of the workflow (using libavfilter/libswscale/libswresample), and memory handling routines
- * for keeping the cache within limits defined by the user (see Config::upcoming_queue_type).
+ * for keeping the cache within limits defined by the user (see Config::upcoming_queue_type). Every frame decoded is
+ * also added to olive::frame_cache so it can be re-used after it leaves the queue.
  *
  * Generally the Cacher workflow starts by calling Open() which will start the thread, open a file handle, and create a
  * decoding instance. Open() is usually called directly from the parent Clip's Clip::Open() and thus expects the
@@ -163,6 +168,40 @@ public:
    */
   void Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playback_speed);
 
+  /**
+   * @brief Start caching the first frame of a clip that hasn't been reached yet
+   *
+   * Used to prepare clips shortly before the playhead reaches them. Like Cache() but for the first frame the clip will
+   * show in the current playback direction (its in point when playing forwards, its out point when playing in
+   * reverse), and never waits for the cacher to respond. Only used for video, does nothing for audio or if the
+   * cacher hasn't finished opening yet.
+   *
+   * @param playhead
+   *
+   * The current Timeline played position in frames
+   *
+   * @param nests
+   *
+   * A hierarchy of nested sequences, if the playback traversed any to get to this clip.
+   *
+   * @param playback_speed
+   *
+   * The current playback speed (controlled by Shuttle Left/Stop/Right)
+   */
+  void Preroll(long playhead, QVector<Clip*>& nests, int playback_speed);
+
+  /**
+   * @brief Returns whether the frame at a playhead is already in the queue
+   *
+   * Unlike Cache() and Retrieve(), this never waits for the cacher or asks it to do anything, so it can be used to
+   * check whether a frame could be shown right away (e.g. when rendering ahead of the playhead). Only used for video.
+   *
+   * @param playhead
+   *
+   * The Timeline position in frames to check
+   */
+  bool IsFrameQueued(long playhead);
+
   /**
    * @brief Retrieve frame requested by Cache()
    *
@@ -172,12 +211,25 @@ public:
    * However it does block for however long it takes to retrieve the correct frame (if the cacher is running) so it's
    * not recommended to call this from any main/GUI thread.
    *
+   * While scrubbing, the frame may only be the nearest one decoded so far (e.g. the keyframe before the requested
+   * frame) so that something can be shown without waiting for the exact frame. In that case, Cache() and Retrieve()
+   * should be called again for the same playhead until the exact frame is returned.
+   *
+   * @param approximate
+   *
+   * If not `nullptr`, set to **TRUE** if the frame is only an approximation of the requested frame.
+   *
+   * @param pts
+   *
+   * If not `nullptr`, set to the timestamp the frame was found in the queue with. The frame must be pinned with this
+   * timestamp (see ClipQueue::pin()) before it's accessed.
+   *
    * @return
    *
    * The frame requested by Cache(), or `nullptr` if there was an error (e.g. the cacher wasn't running and no frame was
    * available).
    */
-  AVFrame* Retrieve();
+  AVFrame* Retrieve(bool* approximate = nullptr, int64_t* pts = nullptr);
 
   /**
    * @brief Close the cacher and free any allocated memory
@@ -255,6 +307,18 @@ public:
    */
   ClipQueue* queue();
 
+  /**
+   * @brief Get the ring upcoming frames are staged in for uploading
+   *
+   * The ring is created and destroyed by the parent Clip on its render thread, and filled by the cacher during
+   * playback while it's created.
+   *
+   * @return
+   *
+   * A pointer to the cacher's upload ring
+   */
+  PixelUploadRing* upload_ring();
+
   /**
    * @brief Retrieve OpenGL information about this media's bit depth
    *
@@ -264,6 +328,18 @@ public:
    */
   const olive::PixelFormat& media_pixel_format();
 
+  /**
+   * @brief Retrieve the key this media's frame is shared with in olive::still_image_cache
+   *
+   * Only call after the thread has been opened by Open().
+   *
+   * @return
+   *
+   * The StillImageCache key if this is a still image (or other infinite-length video stream), or an empty string if
+   * it isn't.
+   */
+  const QString& still_image_key();
+
 private:
   /**
    * @brief Reference to the parent clip. Set in the constructor and never changed during this object's lifetime.
@@ -277,6 +353,11 @@ private:
    */
   ClipQueue queue_;
 
+  /**
+   * @brief Ring of mapped pixel buffer slots that the frames after the current one are copied into during playback
+   */
+  PixelUploadRing upload_ring_;
+
   /**
    * @brief Main wait condition
    *
@@ -363,30 +444,33 @@ private:
 
   // ffmpeg media handling
   /**
-   * @brief FFmpeg format/file context - used for media decoding
+   * @brief Decoder for most media streams
+   *
+   * Handles opening the file, seeking, decoding, and conforming frames to RGBA or float audio for the rest of the
+   * pipeline.
    */
-  AVFormatContext* formatCtx;
+  FFmpegDecoder ffmpeg_decoder_;
 
   /**
-   * @brief FFmpeg decoder context - used for media decoding
+   * @brief Decoder for image sequences, which decodes several images at once in parallel
    */
-  AVCodecContext* codecCtx;
+  ImageSequenceDecoder image_sequence_decoder_;
 
   /**
-   * @brief FFmpeg stream - used for media decoding
+   * @brief Whichever of the above decoders is used for the clip's media stream (chosen in OpenWorker())
    */
-  AVStream* stream;
+  Decoder* decoder_;
 
   /**
-   * @brief FFmpeg packet - used for media decoding
+   * @brief Number of threads the decoder is currently allotted by olive::decode_scheduler
    */
-  AVPacket* pkt;
+  int decode_threads_;
 
   /**
-   * @brief FFmpeg frame - used for media decoding
+   * @brief Audio frame for null-media clips and conformed audio
    *
-   * This is usually used as a raw decoded frame before the RGBA conversion/AVFilter stack. Converted/filtered frames go
-   * into Cacher::queue.
+   * Used as the frame that auto-generated sound clips (e.g. Tone or Noise) render their samples into, and that samples
+   * read from conformed_audio_ are copied into to apply effects.
    */
   AVFrame* frame_;
 
@@ -398,55 +482,90 @@ private:
    */
   AVFrame* retrieved_frame = nullptr;
 
-  // converters/filters
   /**
-   * @brief FFmpeg filter stack
+   * @brief Timestamp retrieved_frame was found in the queue with
    *
-   * Used for conversion from the media's pixel format to RGBA for OpenGL. Also any other FFmpeg filters are implemented
-   * here if necessary (e.g. yadif for deinterlacing). GLSL effects are preferred when available since FFmpeg filters
-   * aren't always fast enough for realtime playback.
+   * Recorded when retrieved_frame is set since the frame itself can't be dereferenced outside the cacher thread until
+   * it's pinned.
    */
-  AVFilterGraph* filter_graph;
+  int64_t retrieved_pts_ = 0;
 
+  // audio playback variables
   /**
-   * @brief FFmpeg buffer source
+   * @brief Internal audio reset variable
    *
-   * Raw decoded frames are added to this for conversion/filtering
+   * Set by AudioReset() and read by CacheAudioWorker() when the audio state needs to be interrupted and reset.
    */
-  AVFilterContext* buffersrc_ctx;
+  bool audio_reset_;
 
   /**
-   * @brief FFmpeg buffer sink
+   * @brief Internal reverse target variable
    *
-   * Converted/filtered frames are retrieved from here and sent to Cacher::queue.
+   * Used by CacheAudioWorker() to stitch audio frames together when reversing. Stores the current frame's timestamp
+   * so it knows how much to decode up to when it backtracks and decodes the next samples.
    */
-  AVFilterContext* buffersink_ctx;
+  int64_t reverse_target_;
 
   /**
-   * @brief FFmpeg codec reference
+   * @brief Frames of the GOP before the one in queue_, decoded ahead of time for reversed video playback
+   *
+   * See CacheReverseVideoWorker().
    */
-  AVCodec* codec;
+  QVector<AVFrame*> reverse_buffer_;
 
   /**
-   * @brief Options set by the cacher for FFmpeg's decoders (settings like multithreading or other optimizations)
+   * @brief Timestamp reverse_buffer_ was decoded up to (exclusive), or AV_NOPTS_VALUE if nothing has been decoded
    */
-  AVDictionary* opts;
+  int64_t reverse_buffer_end_;
 
-  // audio playback variables
   /**
-   * @brief Internal audio reset variable
+   * @brief Maximum amount of frames queue_ and reverse_buffer_ each hold during reversed video playback
    *
-   * Set by AudioReset() and read by CacheAudioWorker() when the audio state needs to be interrupted and reset.
+   * Calculated from reverse_frame_bytes_ and this clip's share of olive::config.reverse_buffer_size whenever a reversed
+   * frame is requested, so long GOPs of large frames can't exhaust memory however many clips are reversed at once.
    */
-  bool audio_reset_;
+  int reverse_frame_limit_;
 
   /**
-   * @brief Internal reverse target variable
+   * @brief Size in bytes of one decoded video frame, set in OpenWorker() for calculating reverse_frame_limit_
+   */
+  int64_t reverse_frame_bytes_;
+
+  /**
+   * @brief Internal variable for still_image_key()
+   */
+  QString still_image_key_;
+
+  /**
+   * @brief Key this media's frames are shared with in olive::frame_cache, or an empty string for still images
+   */
+  QString frame_cache_key_;
+
+  /**
+   * @brief Timestamp of the last frame added to olive::frame_cache, or AV_NOPTS_VALUE if the decoder has seeked since
+   */
+  int64_t frame_cache_previous_pts_;
+
+  /**
+   * @brief Timestamp the decoder has to seek to before decoding the next frame for the queue
    *
-   * Used by CacheAudioWorker() to stitch audio frames together when reversing. Stores the current frame's timestamp
-   * so it knows how much to decode up to when it backtracks and decodes the next samples.
+   * AV_NOPTS_VALUE if the decoder is already positioned after the last frame in the queue.
    */
-  int64_t reverse_target_;
+  int64_t decoder_seek_pts_;
+
+  /**
+   * @brief Conformed copy of this clip's audio stream, or `nullptr` if the audio is decoded live
+   *
+   * See AudioConformer and CacheConformedAudio().
+   */
+  ConformedAudioPtr conformed_audio_;
+
+  /**
+   * @brief Sample in conformed_audio_ that's written to the audio buffer at audio_buffer_write
+   *
+   * Fractional since clip and shuttle speeds step through the samples at a different rate than they're played.
+   */
+  double conformed_position_;
 
   /**
    * @brief Internal frame sample index variable
@@ -482,6 +601,27 @@ private:
    */
   bool is_valid_state_;
 
+  /**
+   * @brief Which frames the decoder is currently skipping (see SetFrameDiscard())
+   */
+  AVDiscard frame_discard_;
+
+  /**
+   * @brief Whether retrieved_frame is only the nearest frame decoded so far rather than the one requested
+   */
+  bool retrieved_frame_approximate_;
+
+  /**
+   * @brief The playhead retrieved_frame was requested for if retrieved_frame_approximate_ is **TRUE**
+   */
+  long approximate_playhead_;
+
+  /**
+   * @brief Set by Cache() if the user is scrubbing or shuttling quickly and a seek should show the keyframe before the
+   * target first
+   */
+  bool keyframe_seek_;
+
   /**
    * @brief Internal function for opening the file handles and decoder
    *
@@ -524,8 +664,21 @@ private:
    * @param f
    *
    * The frame to set as the retrieved frame.
+   *
+   * @param approximate
+   *
+   * **TRUE** if the frame is only shown until the requested frame has been decoded. It will be replaced by the next
+   * frame set with this function.
+   */
+  void SetRetrievedFrame(AVFrame* f, bool approximate = false);
+
+  /**
+   * @brief Internal function to change which frames the decoder skips
+   *
+   * Also makes sure the queue and decoder position stay consistent with the frames that were skipped, see
+   * Decoder::SetFrameDiscard().
    */
-  void SetRetrievedFrame(AVFrame* f);
+  void SetFrameDiscard(AVDiscard discard);
 
   /**
    * @brief Internal function to wake an external calling thread
@@ -537,23 +690,6 @@ private:
    */
   void WakeMainThread();
 
-  /**
-   * @brief Retrieve frame from decoder
-   *
-   * Retrieves the next decoded frame from the decoder. Depending on the source media, this frame may or may not be
-   * suitable for usage later in the pipeline as it may or may not be the correct pixel/sample format. For a suitable
-   * frame for the pipeline, use RetrieveFrameAndProcess() instead (which in turn uses this function anyway).
-   *
-   * @param f
-   *
-   * Frame buffer to decode frame into
-   *
-   * @return
-   *
-   * FFmpeg error code (>= 0 on success, a negative error code on failure)
-   */
-  int RetrieveFrameFromDecoder(AVFrame* f);
-
   /**
    * @brief Retrieve frame from decoder and run it through filter stack
    *
@@ -580,6 +716,83 @@ private:
    */
   void CacheVideoWorker();
 
+  /**
+   * @brief Internal video caching function for reversed playback
+   *
+   * Decoding backwards one frame at a time would mean seeking to the previous keyframe and decoding up to the target
+   * for every single frame. Instead, the whole GOP containing the target is decoded forward into queue_ at once and
+   * served backwards from there. Once the target frame has been delivered, the GOP before it is decoded into
+   * reverse_buffer_ while the render thread works through the current one, and is swapped into queue_ as soon as the
+   * target moves into it.
+   *
+   * @param target_pts
+   *
+   * Timestamp of the frame to show in terms of the media's timebase
+   */
+  void CacheReverseVideoWorker(int64_t target_pts);
+
+  /**
+   * @brief Internal function to decode every frame from the keyframe before a timestamp up to that timestamp
+   *
+   * Only the last reverse_frame_limit_ frames are kept. If the stream has no frames at or before `last_pts`, the
+   * earliest frame is kept instead.
+   *
+   * @param last_pts
+   *
+   * Timestamp of the last frame to decode
+   *
+   * @param frames
+   *
+   * Array to add the decoded frames to in ascending timestamp order
+   *
+   * @param interruptible
+   *
+   * If **TRUE**, decoding stops as soon as Cache() needs the cacher for something else
+   *
+   * @return
+   *
+   * **TRUE** if decoding finished. If it was interrupted or failed, any frames decoded are released and `frames` is
+   * left empty.
+   */
+  bool DecodeReverseSpan(int64_t last_pts, QVector<AVFrame*>& frames, bool interruptible);
+
+  /**
+   * @brief Internal function to release all frames in reverse_buffer_
+   */
+  void ClearReverseBuffer();
+
+  /**
+   * @brief Internal function to fill the empty queue with frames from olive::frame_cache
+   *
+   * Adds the cached frame shown at `target_pts` followed by the cached frames that were decoded after it, until the
+   * upcoming queue is full or the next frame isn't cached.
+   *
+   * @param upcoming_queue_type
+   *
+   * Config::upcoming_queue_type
+   *
+   * @param maximum_ts
+   *
+   * The maximum amount of upcoming frames or the maximum upcoming timestamp, depending on `upcoming_queue_type`
+   *
+   * @return
+   *
+   * **TRUE** if the frame at `target_pts` was cached and added to the queue.
+   */
+  bool RestoreFromFrameCache(int64_t target_pts, int upcoming_queue_type, int64_t maximum_ts);
+
+  /**
+   * @brief Internal function to add a frame that just came out of the decoder to olive::frame_cache
+   */
+  void AddToFrameCache(AVFrame* f);
+
+  /**
+   * @brief Internal function to copy the queued frames after `target_pts` into upload_ring_
+   *
+   * Stops at the first frame there's no free slot for, so the frames staged are always the ones shown next.
+   */
+  void StageUpcomingFrames(int64_t target_pts);
+
   /**
    * @brief Internal audio caching function
    *
@@ -588,6 +801,36 @@ private:
    */
   void CacheAudioWorker();
 
+  /**
+   * @brief Internal audio caching function for clips with conformed audio
+   *
+   * Instead of decoding, samples are read straight from conformed_audio_ at the position the audio buffer corresponds
+   * to, stepping backwards for reversed playback and by the clip/shuttle speed for varispeed (which changes pitch the
+   * same way resampling does when decoding live). Called by CacheAudioWorker() with the clip's position in the
+   * audio buffer's timeline.
+   *
+   * @param timeline_in
+   *
+   * In point of the clip in the audio buffer's timeline (mirrored if playing in reverse)
+   *
+   * @param timeline_out
+   *
+   * Out point of the clip in the audio buffer's timeline (mirrored if playing in reverse)
+   *
+   * @param target_frame
+   *
+   * Frame audio was last reset to in the audio buffer's timeline (mirrored if playing in reverse)
+   *
+   * @param frame_skip
+   *
+   * Frames at the start of the clip that are hidden by the nested sequence it's in
+   *
+   * @param frame_rate
+   *
+   * Frame rate of the audio buffer's timeline
+   */
+  void CacheConformedAudio(long timeline_in, long timeline_out, long target_frame, long frame_skip, double frame_rate);
+
   /**
    * @brief Internal function using the Cacher's known information to determine whether this media is playing in reverse
    */
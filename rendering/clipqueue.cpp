@@ -20,86 +20,260 @@
 
 #include "clipqueue.h"
 
+#include "rendering/framepool.h"
 
-ClipQueue::ClipQueue()
-{
+// capacity of a queue that hasn't been reserved yet
+const int kDefaultQueueCapacity = 2;
 
+ClipQueue::ClipQueue() :
+  capacity_(0),
+  head_(0),
+  tail_(0),
+  hazard_(nullptr)
+{
+  reserve(kDefaultQueueCapacity);
 }
 
 ClipQueue::~ClipQueue()
 {
   clear();
+
+  // nothing can be pinned anymore, so it's safe to free everything
+  for (int i=0;i<deferred_.size();i++) {
+    olive::frame_pool.Release(deferred_.at(i));
+  }
 }
 
-void ClipQueue::lock()
+void ClipQueue::reserve(int capacity)
 {
-  queue_lock.lock();
+  if (capacity <= capacity_) {
+    return;
+  }
+
+  std::unique_ptr<Slot[]> slots(new Slot[capacity]());
+
+  int64_t tail = tail_;
+  int64_t head = head_;
+
+  for (int64_t i=tail;i<head;i++) {
+    Slot& s = slot(i);
+    slots[i - tail].frame = s.frame.load();
+    slots[i - tail].pts = s.pts.load();
+  }
+
+  slots_.swap(slots);
+  capacity_ = capacity;
+  tail_ = 0;
+  head_ = head - tail;
 }
 
-bool ClipQueue::tryLock()
+void ClipQueue::append(AVFrame *frame)
 {
-  return queue_lock.tryLock();
+  free_deferred();
+
+  if (size() == capacity_) {
+    removeFirst();
+  }
+
+  int64_t head = head_;
+
+  Slot& s = slot(head);
+  s.pts = frame->pts;
+  s.frame = frame;
+
+  // publish the frame to the consumer
+  head_ = head + 1;
 }
 
-void ClipQueue::unlock()
+void ClipQueue::removeFirst()
 {
-  queue_lock.unlock();
+  free_deferred();
+
+  int64_t tail = tail_;
+
+  AVFrame* frame = slot(tail).frame;
+
+  // remove the frame from the consumer's view before checking whether it's pinned
+  tail_ = tail + 1;
+
+  release(frame);
 }
 
-void ClipQueue::append(AVFrame *frame)
+void ClipQueue::clear()
 {
-  queue.append(frame);
+  free_deferred();
+
+  int64_t tail = tail_;
+  int64_t head = head_;
+
+  tail_ = head;
+
+  for (int64_t i=tail;i<head;i++) {
+    release(slot(i).frame);
+  }
 }
 
-AVFrame *ClipQueue::at(int i)
+int ClipQueue::upperBound(int64_t pts)
 {
-  return queue.at(i);
+  int64_t tail = tail_;
+  int64_t lo = tail;
+  int64_t hi = head_;
+
+  while (lo < hi) {
+    int64_t mid = lo + (hi - lo) / 2;
+
+    if (slot(mid).pts <= pts) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return int(lo - tail);
+}
+
+AVFrame *ClipQueue::at(int i, int64_t* pts)
+{
+  Slot& s = slot(tail_ + i);
+
+  if (pts != nullptr) {
+    *pts = s.pts;
+  }
+
+  return s.frame;
 }
 
 AVFrame *ClipQueue::first()
 {
-  return queue.first();
+  return at(0);
 }
 
-AVFrame *ClipQueue::last()
+AVFrame *ClipQueue::last(int64_t* pts)
 {
-  return queue.last();
+  Slot& s = slot(head_ - 1);
+
+  if (pts != nullptr) {
+    *pts = s.pts;
+  }
+
+  return s.frame;
 }
 
-void ClipQueue::removeFirst()
+int ClipQueue::size()
 {
-  removeAt(0);
+  // load tail first, head can only have moved further ahead by the time we load it
+  int64_t tail = tail_;
+  int64_t head = head_;
+  return int(head - tail);
 }
 
-void ClipQueue::removeLast()
+bool ClipQueue::isEmpty()
 {
-  removeAt(queue.size()-1);
+  return (size() == 0);
 }
 
-void ClipQueue::removeAt(int i)
+AVFrame *ClipQueue::find(int64_t pts, int64_t* found_pts)
 {
-  av_frame_free(&queue[i]);
-  queue.removeAt(i);
+  AVFrame* frame;
+  int64_t frame_pts;
+  int64_t tail;
+
+  // A slot is only overwritten after the producer has moved tail_ past it, so if tail_ hasn't moved during the search,
+  // everything we read was valid. Otherwise search again.
+  do {
+    frame = nullptr;
+    frame_pts = 0;
+
+    tail = tail_;
+    int64_t head = head_;
+
+    int64_t lo = tail;
+    int64_t hi = head;
+
+    while (lo < hi) {
+      int64_t mid = lo + (hi - lo) / 2;
+
+      if (slot(mid).pts <= pts) {
+        lo = mid + 1;
+      } else {
+        hi = mid;
+      }
+    }
+
+    // lo is now the first frame after pts, check the one before it
+    if (lo > tail) {
+      Slot& s = slot(lo - 1);
+
+      frame_pts = s.pts;
+
+      if (frame_pts == pts || lo < head) {
+        frame = s.frame;
+      }
+    }
+  } while (tail_ != tail);
+
+  if (found_pts != nullptr) {
+    *found_pts = frame_pts;
+  }
+
+  return frame;
 }
 
-void ClipQueue::clear()
+AVFrame *ClipQueue::pin(AVFrame *frame, int64_t pts)
 {
-  while (queue.size() > 0) {
-    removeAt(0);
+  if (frame == nullptr) {
+    unpin();
+    return nullptr;
   }
+
+  // Publish the pin before checking whether the frame is still in the queue. The producer removes frames from the
+  // queue before checking the pin, so either we'll see it's been removed or the producer will see it's pinned.
+  hazard_ = frame;
+
+  int64_t tail = tail_;
+  int64_t head = head_;
+
+  // The pointer alone isn't enough, olive::frame_pool may have handed the same AVFrame back to the producer for a newer
+  // frame since it was looked up. Frames are appended in timestamp order so at most one slot can match both.
+  for (int64_t i=tail;i<head;i++) {
+    Slot& s = slot(i);
+
+    if (s.frame == frame && s.pts == pts) {
+      return frame;
+    }
+  }
+
+  hazard_ = nullptr;
+
+  return nullptr;
 }
 
-int ClipQueue::size()
+void ClipQueue::unpin()
 {
-  return queue.size();
+  hazard_ = nullptr;
 }
 
-bool ClipQueue::isEmpty()
+ClipQueue::Slot &ClipQueue::slot(int64_t position)
+{
+  return slots_[position % capacity_];
+}
+
+void ClipQueue::release(AVFrame *frame)
 {
-  return queue.isEmpty();
+  if (hazard_ == frame) {
+    deferred_.append(frame);
+  } else {
+    olive::frame_pool.Release(frame);
+  }
 }
 
-bool ClipQueue::contains(AVFrame *frame)
+void ClipQueue::free_deferred()
 {
-  return queue.contains(frame);
+  for (int i=0;i<deferred_.size();i++) {
+    if (hazard_ != deferred_.at(i)) {
+      olive::frame_pool.Release(deferred_.at(i));
+      deferred_.removeAt(i);
+      i--;
+    }
+  }
 }
@@ -26,12 +26,25 @@ extern "C" {
 }
 
 #include <QVector>
-#include <QMutex>
+#include <atomic>
+#include <memory>
 
 /**
  * @brief The ClipQueue class
  *
- * A fairly simple wrapper for a QVector and QMutex that cleans up AVFrames automatically when removing them.
+ * A fixed-size ring buffer of AVFrames ordered by timestamp that cleans up AVFrames automatically when removing them
+ * (by giving them back to olive::frame_pool).
+ *
+ * ClipQueue is single-producer/single-consumer and doesn't use any locks. The producer (the Cacher thread that owns
+ * the queue) is the only thread that may add, remove or dereference frames. The consumer (the thread rendering the
+ * clip) may look up frames with find() and must pin() a frame before accessing its data, which guarantees the producer
+ * won't free it until unpin() is called. Since olive::frame_pool recycles AVFrames, a frame the consumer found may have
+ * been removed and reused for another timestamp by the time it's pinned, so frames are always pinned by their pointer
+ * AND the timestamp they were found with. Frames the producer removes while they're pinned are kept aside and freed the
+ * next time the producer modifies the queue after they've been unpinned.
+ *
+ * Frames must be appended in ascending timestamp order (as they come out of the decoder) for find() to work, which
+ * lets lookups be binary searches and evicting old frames from the front be constant time.
  */
 class ClipQueue {
 public:
@@ -47,45 +60,53 @@ public:
    */
   ~ClipQueue();
 
-  // Thread safety (QMutex compatible)
+  // Producer functions (only to be called from the thread that owns the queue)
   /**
-   * @brief Lock queue mutex
+   * @brief Set the maximum amount of frames the queue can hold
+   *
+   * Existing frames are kept. The capacity can only grow, a smaller value than the current capacity does nothing.
+   *
+   * Unlike all other producer functions, this is NOT safe to call while a consumer may be accessing the queue.
+   *
+   * @param capacity
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. See QMutex::lock() for more
-   * information.
+   * New maximum amount of frames
    */
-  void lock();
+  void reserve(int capacity);
 
   /**
-   * @brief Try to lock queue mutex
+   * @brief Add a frame to the end of the queue
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. Tries to lock, but doesn't block
-   * the calling thread and wait if it can't lock it. See QMutex::tryLock() for more information.
+   * If the queue is full, the first frame is removed to make room for it.
    *
-   * @return
+   * @param frame
    *
-   * **TRUE** if the lock succeeded, **FALSE** if not.
+   * The frame to add. Its timestamp must not be earlier than the last frame in the queue.
    */
-  bool tryLock();
+  void append(AVFrame* frame);
 
   /**
-   * @brief Unlock queue mutex
+   * @brief Remove first frame in the queue
    *
-   * Used for multithreading to ensure queue is only accessed by one thread at a time. See QMutex::unlock() for more
-   * information.
+   * Frees all memory occupied by this frame (once the consumer no longer has it pinned) and removes it from the queue
    */
-  void unlock();
+  void removeFirst();
 
-  // Array handling (QVector compatible)
   /**
-   * @brief Add a frame to the end of the queue
+   * @brief Clear entire queue
    *
-   * @param frame
+   * Frees all memory occupied by all frames (once the consumer no longer has them pinned) and clears the entire queue
+   */
+  void clear();
+
+  /**
+   * @brief Find the index of the first frame with a timestamp later than `pts`
    *
-   * The frame to add
+   * Equivalent to the amount of frames in the queue at or before `pts`.
    */
-  void append(AVFrame* frame);
+  int upperBound(int64_t pts);
 
+  // Functions safe to call from either thread (the consumer must not dereference the returned frames without pin())
   /**
    * @brief Retrieve a frame at a certain index
    *
@@ -93,11 +114,15 @@ public:
    *
    * Index to retrieve frame from
    *
+   * @param pts
+   *
+   * If not `nullptr`, set to the timestamp stored with the frame (for pin())
+   *
    * @return
    *
    * AVFrame at this index
    */
-  AVFrame* at(int i);
+  AVFrame* at(int i, int64_t* pts = nullptr);
 
   /**
    * @brief Retrieve first frame in the queue
@@ -111,75 +136,129 @@ public:
   /**
    * @brief Retrieve last frame in the queue
    *
+   * @param pts
+   *
+   * If not `nullptr`, set to the timestamp stored with the frame (for pin())
+   *
    * @return
    *
    * The last AVFrame in the queue
    */
-  AVFrame* last();
+  AVFrame* last(int64_t* pts = nullptr);
 
   /**
-   * @brief Remove first frame in the queue
+   * @brief Retrieve current size of the queue
    *
-   * Frees all memory occupied by this frame and removes it from the queue
+   * @return
+   *
+   * Current the current size of the queue. On the producer thread, all indexes in the queue are guaranteed to be valid
+   * references to an AVFrame.
    */
-  void removeFirst();
+  int size();
 
   /**
-   * @brief Remove last frame in the queue
+   * @brief Returns whether the queue is empty of not.
    *
-   * Frees all memory occupied by this frame and removes it from the queue
+   * @return
+   *
+   * **TRUE** if the queue is empty and contains no frames, **FALSE** if not.
    */
-  void removeLast();
+  bool isEmpty();
 
+  // Consumer functions
   /**
-   * @brief Remove frame in the queue at a certain index
+   * @brief Find the frame to show at a certain timestamp
    *
-   * Frees all memory occupied by this frame and removes it from the queue
+   * @param pts
    *
-   * @param i
+   * Timestamp to find a frame for
    *
-   * Index to remove a frame at
-   */
-  void removeAt(int i);
-
-  /**
-   * @brief Clear entire queue
+   * @param found_pts
    *
-   * Frees all memory occupied by all frames and clears the entire queue
-   */
-  void clear();
-
-  /**
-   * @brief Retrieve current size of the queue
+   * If not `nullptr`, set to the timestamp of the frame that was found (for pin())
    *
    * @return
    *
-   * Current the current size of the queue. All indexes in the queue are guaranteed to be valid references to an
-   * AVFrame.
+   * The frame with this exact timestamp, or the frame before it if the queue has frames on both sides of `pts` (which
+   * we assume is due to a rounding error). `nullptr` if neither was found.
    */
-  int size();
+  AVFrame* find(int64_t pts, int64_t* found_pts = nullptr);
 
   /**
-   * @brief Returns whether the queue is empty of not.
+   * @brief Protect a frame from being freed by the producer while it's being used
+   *
+   * Only one frame can be pinned at a time, pinning another frame unpins the previous one.
+   *
+   * @param frame
+   *
+   * The frame to pin (usually from find())
+   *
+   * @param pts
+   *
+   * The timestamp `frame` was found with. If the producer has removed the frame and reused it for another timestamp
+   * since, it's no longer the frame that was looked up and pinning it fails.
    *
    * @return
    *
-   * **TRUE** if the queue is empty and contains no frames, **FALSE** if not.
+   * `frame` if it was still in the queue at `pts` and is now safe to access until unpin() is called, or `nullptr` if
+   * the producer has already removed it.
    */
-  bool isEmpty();
+  AVFrame* pin(AVFrame* frame, int64_t pts);
+
+  /**
+   * @brief Release the frame pinned with pin()
+   */
+  void unpin();
 
+private:
   /**
-   * @brief Returns whether the queue contains a frame or not
+   * @brief One entry in the ring
    *
-   * @return
+   * The timestamp is stored alongside the frame so the consumer can binary search without dereferencing any frames.
+   */
+  struct Slot {
+    std::atomic<AVFrame*> frame;
+    std::atomic<int64_t> pts;
+  };
+
+  /**
+   * @brief Internal function to get the slot of a position (a value between tail_ and head_)
+   */
+  Slot& slot(int64_t position);
+
+  /**
+   * @brief Internal function to free a frame removed from the queue, or defer it if the consumer has it pinned
+   */
+  void release(AVFrame* frame);
+
+  /**
+   * @brief Internal function to free any deferred frames that are no longer pinned
+   */
+  void free_deferred();
+
+  /**
+   * @brief Ring storage of `capacity_` slots
+   */
+  std::unique_ptr<Slot[]> slots_;
+  int capacity_;
+
+  /**
+   * @brief Monotonically increasing positions of the next slot to write and the first valid slot
    *
-   * **TRUE** if the queue contains the specified frame, **FALSE** if not.
+   * Only the producer writes to these. `head_ - tail_` is the size of the queue.
    */
-  bool contains(AVFrame* frame);
+  std::atomic<int64_t> head_;
+  std::atomic<int64_t> tail_;
 
-private:
-  QVector<AVFrame*> queue;
-  QMutex queue_lock;
+  /**
+   * @brief Frame currently pinned by the consumer, if any
+   */
+  std::atomic<AVFrame*> hazard_;
+
+  /**
+   * @brief Frames removed from the queue while they were pinned, only accessed by the producer
+   */
+  QVector<AVFrame*> deferred_;
 };
 
 #endif // CLIPQUEUE_H
@@ -0,0 +1,446 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "compositecache.h"
+
+#include <QColor>
+#include <QVariant>
+
+#include "timeline/sequence.h"
+#include "timeline/clip.h"
+#include "timeline/track.h"
+#include "project/media.h"
+#include "project/footage.h"
+#include "effects/transition.h"
+#include "nodes/oldeffectnode.h"
+#include "global/config.h"
+#include "global/timing.h"
+
+CompositeCache olive::composite_cache;
+
+/**
+ * @brief Mix a value into a hash
+ */
+void HashCombine(quint64& hash, quint64 value) {
+  hash ^= value + 0x9e3779b97f4a7c15ULL + (hash << 6) + (hash >> 2);
+}
+
+void HashVariant(quint64& hash, const QVariant& v) {
+  switch (v.type()) {
+  case QVariant::Double:
+  {
+    double d = v.toDouble();
+    quint64 bits;
+    memcpy(&bits, &d, sizeof(bits));
+    HashCombine(hash, bits);
+  }
+    break;
+  case QVariant::Bool:
+  case QVariant::Int:
+  case QVariant::LongLong:
+    HashCombine(hash, quint64(v.toLongLong()));
+    break;
+  case QVariant::Color:
+    HashCombine(hash, v.value<QColor>().rgba64());
+    break;
+  default:
+    HashCombine(hash, qHash(v.toString()));
+  }
+}
+
+void HashEffect(quint64& hash, OldEffectNode* e, double timecode) {
+  HashCombine(hash, quintptr(e));
+  HashCombine(hash, e->IsEnabled());
+
+  if (!e->IsEnabled()) {
+    return;
+  }
+
+  for (int i=0;i<e->row_count();i++) {
+    NodeIO* row = e->row(i);
+
+    for (int j=0;j<row->FieldCount();j++) {
+      HashVariant(hash, row->Field(j)->GetValueAt(timecode));
+    }
+  }
+}
+
+void HashSequence(quint64& hash, Sequence* s, long playhead) {
+  HashCombine(hash, quintptr(s));
+  HashCombine(hash, quint64(s->width));
+  HashCombine(hash, quint64(s->height));
+
+  QVector<Clip*> sequence_clips;
+  s->GetClipsInRange(olive::kTypeVideo, playhead, playhead + 1, &sequence_clips);
+
+  for (int i=0;i<sequence_clips.size();i++) {
+    Clip* c = sequence_clips.at(i);
+
+    if (!c->IsActiveAt(playhead)) {
+      continue;
+    }
+
+    HashCombine(hash, quintptr(c));
+    HashCombine(hash, quint64(c->track()->Index()));
+    HashCombine(hash, quint64(c->timeline_in(true)));
+    HashCombine(hash, quint64(c->timeline_out(true)));
+    HashCombine(hash, quint64(c->clip_in(true)));
+    HashVariant(hash, c->speed().value);
+    HashCombine(hash, c->reversed());
+    HashCombine(hash, c->autoscaled());
+    HashCombine(hash, quintptr(c->media()));
+
+    double timecode = get_timecode(c, playhead);
+
+    if (c->media() != nullptr) {
+      if (c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+        Footage* f = c->media()->to_footage();
+
+        HashCombine(hash, qHash(f->url));
+        HashCombine(hash, quint64(c->media_stream_index()));
+        HashCombine(hash, f->ready);
+        HashCombine(hash, f->invalid);
+        HashVariant(hash, f->speed);
+        HashCombine(hash, f->alpha_is_associated);
+        HashCombine(hash, quint64(f->start_number));
+        HashCombine(hash, qHash(f->Colorspace()));
+        HashCombine(hash, f->proxy);
+        HashCombine(hash, qHash(f->proxy_path));
+      } else if (c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
+        Sequence* nested = c->media()->to_sequence().get();
+
+        // same conversion compose_sequence() makes for nested sequences
+        long nested_playhead = rescale_frame_number(playhead + c->clip_in(true) - c->timeline_in(true),
+                                                    s->frame_rate,
+                                                    nested->frame_rate);
+
+        HashSequence(hash, nested, nested_playhead);
+      }
+    }
+
+    for (int j=0;j<c->effects.size();j++) {
+      HashEffect(hash, c->effects.at(j).get(), timecode);
+    }
+
+    if (c->opening_transition != nullptr) {
+      HashCombine(hash, quint64(c->opening_transition->get_length()));
+      HashEffect(hash, c->opening_transition.get(), timecode);
+    }
+
+    if (c->closing_transition != nullptr) {
+      HashCombine(hash, quint64(c->closing_transition->get_length()));
+      HashEffect(hash, c->closing_transition.get(), timecode);
+    }
+  }
+}
+
+CompositeCache::CompositeCache() :
+  use_counter_(0),
+  resident_bytes_(0)
+{}
+
+quint64 CompositeCache::GetHash(Sequence *seq, long frame)
+{
+  quint64 hash = 0;
+
+  // footage is converted into the scene linear color space while composing
+  HashCombine(hash, olive::config.enable_color_management);
+  HashCombine(hash, qHash(olive::config.ocio_config_path));
+
+  HashSequence(hash, seq, frame);
+
+  return hash;
+}
+
+bool CompositeCache::Get(Sequence *seq,
+                         long frame,
+                         quint64 hash,
+                         int width,
+                         int height,
+                         olive::PixelFormat format,
+                         QByteArray *pixels)
+{
+  QMutexLocker locker(&lock_);
+
+  RemoveDeletedSequences();
+
+  QHash<Sequence*, QMap<long, Entry> >::iterator source = frames_.find(seq);
+
+  if (source == frames_.end()) {
+    return false;
+  }
+
+  QMap<long, Entry>::iterator i = source.value().find(frame);
+
+  if (i == source.value().end()) {
+    return false;
+  }
+
+  Entry& entry = i.value();
+
+  if (entry.hash != hash || entry.width != width || entry.height != height || entry.format != format) {
+    return false;
+  }
+
+  lru_.remove(entry.last_used);
+  entry.last_used = ++use_counter_;
+  lru_.insert(entry.last_used, QPair<Sequence*, long>(seq, frame));
+
+  *pixels = entry.pixels;
+
+  return true;
+}
+
+bool CompositeCache::Contains(Sequence *seq, long frame, quint64 hash, int width, int height, olive::PixelFormat format)
+{
+  QMutexLocker locker(&lock_);
+
+  RemoveDeletedSequences();
+
+  QHash<Sequence*, QMap<long, Entry> >::const_iterator source = frames_.constFind(seq);
+
+  if (source == frames_.constEnd()) {
+    return false;
+  }
+
+  QMap<long, Entry>::const_iterator i = source.value().constFind(frame);
+
+  return (i != source.value().constEnd()
+          && i.value().hash == hash
+          && i.value().width == width
+          && i.value().height == height
+          && i.value().format == format);
+}
+
+void CompositeCache::Add(Sequence *seq,
+                         long frame,
+                         quint64 hash,
+                         int width,
+                         int height,
+                         olive::PixelFormat format,
+                         const QByteArray &pixels)
+{
+  int64_t max_bytes = int64_t(olive::config.composite_cache_size) * 1048576;
+
+  if (pixels.size() > max_bytes) {
+    return;
+  }
+
+  {
+    QMutexLocker locker(&lock_);
+
+    RemoveDeletedSequences();
+
+    Remove(seq, frame);
+
+    Entry entry;
+    entry.pixels = pixels;
+    entry.hash = hash;
+    entry.width = width;
+    entry.height = height;
+    entry.format = format;
+    entry.last_used = ++use_counter_;
+
+    frames_[seq].insert(frame, entry);
+    sequences_.insert(seq, seq);
+    lru_.insert(entry.last_used, QPair<Sequence*, long>(seq, frame));
+    resident_bytes_ += pixels.size();
+
+    Trim(max_bytes);
+  }
+
+  emit Changed();
+}
+
+void CompositeCache::Validate()
+{
+  QHash<Sequence*, QMap<long, quint64> > cached_hashes;
+
+  {
+    QMutexLocker locker(&lock_);
+
+    RemoveDeletedSequences();
+
+    QHash<Sequence*, QMap<long, Entry> >::const_iterator i;
+
+    for (i=frames_.constBegin();i!=frames_.constEnd();i++) {
+      QMap<long, Entry>::const_iterator j;
+
+      for (j=i.value().constBegin();j!=i.value().constEnd();j++) {
+        cached_hashes[i.key()].insert(j.key(), j.value().hash);
+      }
+    }
+  }
+
+  // hash without the lock held so RenderThreads aren't stalled while we do
+  QVector<QPair<Sequence*, long> > stale_frames;
+
+  QHash<Sequence*, QMap<long, quint64> >::const_iterator i;
+
+  for (i=cached_hashes.constBegin();i!=cached_hashes.constEnd();i++) {
+    QMap<long, quint64>::const_iterator j;
+
+    for (j=i.value().constBegin();j!=i.value().constEnd();j++) {
+      if (j.value() != GetHash(i.key(), j.key())) {
+        stale_frames.append(QPair<Sequence*, long>(i.key(), j.key()));
+      }
+    }
+  }
+
+  if (stale_frames.isEmpty()) {
+    return;
+  }
+
+  {
+    QMutexLocker locker(&lock_);
+
+    for (int j=0;j<stale_frames.size();j++) {
+      Sequence* seq = stale_frames.at(j).first;
+      long frame = stale_frames.at(j).second;
+
+      QHash<Sequence*, QMap<long, Entry> >::const_iterator source = frames_.constFind(seq);
+
+      if (source == frames_.constEnd()) {
+        continue;
+      }
+
+      // the frame may have been rendered again in the meantime
+      QMap<long, Entry>::const_iterator cached = source.value().constFind(frame);
+
+      if (cached != source.value().constEnd() && cached.value().hash == cached_hashes[seq].value(frame)) {
+        Remove(seq, frame);
+      }
+    }
+  }
+
+  emit Changed();
+}
+
+QVector<QPair<long, long> > CompositeCache::GetCachedRanges(Sequence *seq)
+{
+  QMutexLocker locker(&lock_);
+
+  RemoveDeletedSequences();
+
+  QVector<QPair<long, long> > ranges;
+
+  const QMap<long, Entry>& source = frames_.value(seq);
+
+  QMap<long, Entry>::const_iterator i;
+
+  for (i=source.constBegin();i!=source.constEnd();i++) {
+    if (!ranges.isEmpty() && ranges.last().second == i.key()) {
+      ranges.last().second++;
+    } else {
+      ranges.append(QPair<long, long>(i.key(), i.key() + 1));
+    }
+  }
+
+  return ranges;
+}
+
+void CompositeCache::Clear(Sequence *seq)
+{
+  {
+    QMutexLocker locker(&lock_);
+
+    if (seq == nullptr) {
+      frames_.clear();
+      sequences_.clear();
+      lru_.clear();
+      resident_bytes_ = 0;
+    } else {
+      QList<long> frames = frames_.value(seq).keys();
+
+      for (int i=0;i<frames.size();i++) {
+        Remove(seq, frames.at(i));
+      }
+    }
+  }
+
+  emit Changed();
+}
+
+int64_t CompositeCache::ResidentBytes()
+{
+  QMutexLocker locker(&lock_);
+
+  return resident_bytes_;
+}
+
+void CompositeCache::Trim(int64_t max_bytes)
+{
+  QMap<quint64, QPair<Sequence*, long> >::iterator i = lru_.begin();
+
+  while (i != lru_.end() && resident_bytes_ > max_bytes) {
+    QPair<Sequence*, long> location = i.value();
+
+    // move past this entry now since Remove() erases it from lru_
+    ++i;
+
+    Remove(location.first, location.second);
+  }
+}
+
+void CompositeCache::Remove(Sequence *seq, long frame)
+{
+  QHash<Sequence*, QMap<long, Entry> >::iterator source = frames_.find(seq);
+
+  if (source == frames_.end()) {
+    return;
+  }
+
+  QMap<long, Entry>::iterator i = source.value().find(frame);
+
+  if (i == source.value().end()) {
+    return;
+  }
+
+  lru_.remove(i.value().last_used);
+  resident_bytes_ -= i.value().pixels.size();
+  source.value().erase(i);
+
+  if (source.value().isEmpty()) {
+    frames_.erase(source);
+    sequences_.remove(seq);
+  }
+}
+
+void CompositeCache::RemoveDeletedSequences()
+{
+  QHash<Sequence*, QPointer<Sequence> >::iterator i = sequences_.begin();
+
+  while (i != sequences_.end()) {
+    if (i.value().isNull()) {
+      QMap<long, Entry>::const_iterator j;
+      const QMap<long, Entry>& source = frames_.value(i.key());
+
+      for (j=source.constBegin();j!=source.constEnd();j++) {
+        lru_.remove(j.value().last_used);
+        resident_bytes_ -= j.value().pixels.size();
+      }
+
+      frames_.remove(i.key());
+      i = sequences_.erase(i);
+    } else {
+      i++;
+    }
+  }
+}
@@ -0,0 +1,207 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef COMPOSITECACHE_H
+#define COMPOSITECACHE_H
+
+#include <QObject>
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <QPointer>
+#include <QVector>
+
+#include "rendering/pixelformats.h"
+
+class Sequence;
+
+/**
+ * @brief The CompositeCache class
+ *
+ * RenderThread composes every frame it shows from scratch, even if it has shown the exact same frame before.
+ * CompositeCache keeps the final composited frames of Sequences in memory (before they're converted to the display's
+ * color space) so frames that are shown again only need to be uploaded and blitted. Its total size is bounded by
+ * Config::composite_cache_size.
+ *
+ * Frames are keyed by Sequence and frame number, and each frame stores a hash of everything that went into composing it
+ * (see GetHash()). A frame is only returned by Get() if its hash still matches, so editing the Sequence never shows a
+ * stale frame, and Validate() frees frames that no longer match after the Sequence has been modified.
+ *
+ * Changed() is emitted whenever frames are added or removed so views of the cached ranges (e.g. TimelineHeader) can
+ * update.
+ *
+ * All functions are thread-safe.
+ */
+class CompositeCache : public QObject {
+  Q_OBJECT
+public:
+  CompositeCache();
+
+  /**
+   * @brief Hash everything that affects a composited frame of a Sequence
+   *
+   * Covers every clip active at the frame (including the clips of nested Sequences), its source media, position and
+   * speed, and the value of every field of its effects and transitions at that frame, so changing a keyframe only
+   * changes the hash of the frames it actually affects.
+   */
+  static quint64 GetHash(Sequence* seq, long frame);
+
+  /**
+   * @brief Get a cached composited frame
+   *
+   * @param hash
+   *
+   * The frame's current hash from GetHash()
+   *
+   * @param width
+   * @param height
+   * @param format
+   *
+   * The size and pixel format the frame is needed in
+   *
+   * @param pixels
+   *
+   * Set to the frame's pixels if it's cached (shared with the cache, no pixels are copied)
+   *
+   * @return
+   *
+   * **TRUE** if a frame matching all of the above was cached.
+   */
+  bool Get(Sequence* seq,
+           long frame,
+           quint64 hash,
+           int width,
+           int height,
+           olive::PixelFormat format,
+           QByteArray* pixels);
+
+  /**
+   * @brief Returns whether Get() would find a frame without retrieving it
+   */
+  bool Contains(Sequence* seq, long frame, quint64 hash, int width, int height, olive::PixelFormat format);
+
+  /**
+   * @brief Add a composited frame to the cache
+   *
+   * Replaces any frame already cached at this frame number. May free the least recently used frames to stay within
+   * Config::composite_cache_size.
+   */
+  void Add(Sequence* seq,
+           long frame,
+           quint64 hash,
+           int width,
+           int height,
+           olive::PixelFormat format,
+           const QByteArray& pixels);
+
+  /**
+   * @brief Get the ranges of frames that are cached for a Sequence
+   *
+   * @return
+   *
+   * Pairs of the first frame of each range and the frame after the last one, in order.
+   */
+  QVector<QPair<long, long> > GetCachedRanges(Sequence* seq);
+
+  /**
+   * @brief Free all cached frames of a Sequence, or of every Sequence if `seq` is `nullptr`
+   */
+  void Clear(Sequence* seq = nullptr);
+
+  /**
+   * @brief Total size in bytes of all cached frames
+   */
+  int64_t ResidentBytes();
+
+public slots:
+  /**
+   * @brief Free the cached frames whose hash no longer matches
+   *
+   * Should be called after the project has been modified so frames that will never be shown again don't take up
+   * memory or show as cached.
+   */
+  void Validate();
+
+signals:
+  void Changed();
+
+private:
+  struct Entry {
+    QByteArray pixels;
+    quint64 hash;
+    int width;
+    int height;
+    olive::PixelFormat format;
+    quint64 last_used;
+  };
+
+  /**
+   * @brief Internal function to free the least recently used frames until the cache is within `max_bytes`
+   *
+   * lock_ must be locked.
+   */
+  void Trim(int64_t max_bytes);
+
+  /**
+   * @brief Internal function to free a frame and remove it from the cache
+   *
+   * lock_ must be locked.
+   */
+  void Remove(Sequence* seq, long frame);
+
+  /**
+   * @brief Internal function to free the frames of any Sequence that has been deleted
+   *
+   * Also stops a new Sequence created at the same address from being mistaken for the old one. lock_ must be locked.
+   */
+  void RemoveDeletedSequences();
+
+  /**
+   * @brief Cached frames of each Sequence keyed by frame number
+   */
+  QHash<Sequence*, QMap<long, Entry> > frames_;
+
+  /**
+   * @brief Guarded pointers to every Sequence in frames_, which become `nullptr` when the Sequence is deleted
+   */
+  QHash<Sequence*, QPointer<Sequence> > sequences_;
+
+  /**
+   * @brief Sequence and frame number of every cached frame, ordered from least to most recently used
+   */
+  QMap<quint64, QPair<Sequence*, long> > lru_;
+
+  /**
+   * @brief Incremented every time an entry is used, for ordering entries from least to most recently used
+   */
+  quint64 use_counter_;
+
+  int64_t resident_bytes_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern CompositeCache composite_cache;
+}
+
+#endif // COMPOSITECACHE_H
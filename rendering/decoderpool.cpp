@@ -0,0 +1,295 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decoderpool.h"
+
+#include <QCoreApplication>
+
+#include "global/debug.h"
+#include "global/path.h"
+#include "rendering/framepool.h"
+
+DecoderPool olive::decoder_pool;
+
+// maximum amount of idle contexts kept open for re-use
+const int kMaxIdleContexts = 16;
+
+DecoderPool::DecoderPool()
+{}
+
+DecoderPool::~DecoderPool()
+{
+  Clear();
+}
+
+DecoderContext *DecoderPool::Lease(const QString &filename,
+                                   int stream_index,
+                                   int start_number,
+                                   int thread_count,
+                                   QString *error)
+{
+  lock_.lock();
+
+  // idle_ is ordered from least to most recently returned, so search backwards to get the warmest context
+  for (int i=idle_.size()-1;i>=0;i--) {
+    DecoderContext* ctx = idle_.at(i);
+
+    if (ctx->stream_index == stream_index
+        && ctx->start_number == start_number
+        && ctx->filename == filename) {
+      idle_.removeAt(i);
+      lock_.unlock();
+      return ctx;
+    }
+  }
+
+  lock_.unlock();
+
+  // no idle context available, open a new one (outside of the lock since this can take a while)
+  return Open(filename, stream_index, start_number, thread_count, error);
+}
+
+void DecoderPool::SetThreadCount(DecoderContext *ctx, int thread_count)
+{
+  if (ctx->thread_count == thread_count) {
+    return;
+  }
+
+  AVCodecContext* codec_ctx = OpenCodec(ctx->stream, thread_count);
+
+  // if the decoder can't be re-opened, keep using the one we have
+  if (codec_ctx == nullptr) {
+    return;
+  }
+
+  // keep any settings the lessee made on the old decoder
+  codec_ctx->skip_frame = ctx->codec_ctx->skip_frame;
+  codec_ctx->channel_layout = ctx->codec_ctx->channel_layout;
+
+  avcodec_close(ctx->codec_ctx);
+  avcodec_free_context(&ctx->codec_ctx);
+
+  ctx->codec_ctx = codec_ctx;
+  ctx->thread_count = thread_count;
+
+  // the new decoder starts from scratch
+  ctx->last_pts = AV_NOPTS_VALUE;
+}
+
+void DecoderPool::Return(DecoderContext *ctx)
+{
+  if (ctx == nullptr) {
+    return;
+  }
+
+  DecoderContext* expired = nullptr;
+
+  lock_.lock();
+
+  idle_.append(ctx);
+
+  if (idle_.size() > kMaxIdleContexts) {
+    expired = idle_.takeFirst();
+  }
+
+  lock_.unlock();
+
+  Free(expired);
+}
+
+void DecoderPool::Discard(DecoderContext *ctx)
+{
+  Free(ctx);
+}
+
+void DecoderPool::Clear()
+{
+  lock_.lock();
+  QList<DecoderContext*> expired = idle_;
+  idle_.clear();
+  lock_.unlock();
+
+  for (int i=0;i<expired.size();i++) {
+    Free(expired.at(i));
+  }
+}
+
+DecoderContext *DecoderPool::Open(const QString &filename,
+                                  int stream_index,
+                                  int start_number,
+                                  int thread_count,
+                                  QString *error)
+{
+  QByteArray ba = filename.toUtf8();
+  const char* c_filename = ba.constData();
+
+  // for image sequences that don't start at 0, set the index where it does start
+  AVDictionary* format_opts = nullptr;
+  if (start_number > 0) {
+    av_dict_set(&format_opts, "start_number", QString::number(start_number).toUtf8(), 0);
+  }
+
+  AVFormatContext* format_ctx = nullptr;
+
+  int errCode = avformat_open_input(
+        &format_ctx,
+        c_filename,
+        nullptr,
+        &format_opts
+        );
+
+  av_dict_free(&format_opts);
+
+  if (errCode == 0) {
+    errCode = avformat_find_stream_info(format_ctx, nullptr);
+  }
+
+  if (errCode < 0) {
+    char err[1024];
+    av_strerror(errCode, err, 1024);
+    qCritical() << "Could not open" << filename << "-" << err;
+    if (error != nullptr) {
+      *error = QCoreApplication::translate("DecoderPool", "Could not open %1 - %2").arg(filename, err);
+    }
+    avformat_close_input(&format_ctx);
+    return nullptr;
+  }
+
+  av_dump_format(format_ctx, 0, c_filename, 0);
+
+  if (stream_index < 0 || stream_index >= int(format_ctx->nb_streams)) {
+    qCritical() << "Stream" << stream_index << "does not exist in" << filename;
+    if (error != nullptr) {
+      *error = QCoreApplication::translate("DecoderPool", "Could not open %1 - invalid stream").arg(filename);
+    }
+    avformat_close_input(&format_ctx);
+    return nullptr;
+  }
+
+  AVStream* stream = format_ctx->streams[stream_index];
+
+  AVCodecContext* codec_ctx = OpenCodec(stream, thread_count);
+
+  if (codec_ctx == nullptr) {
+    if (error != nullptr) {
+      *error = QCoreApplication::translate("DecoderPool", "Could not open %1 - failed to open decoder").arg(filename);
+    }
+    avformat_close_input(&format_ctx);
+    return nullptr;
+  }
+
+  DecoderContext* ctx = new DecoderContext();
+  ctx->filename = filename;
+  ctx->stream_index = stream_index;
+  ctx->start_number = start_number;
+  ctx->thread_count = thread_count;
+  ctx->format_ctx = format_ctx;
+  ctx->codec_ctx = codec_ctx;
+  ctx->stream = stream;
+  ctx->filter_graph = nullptr;
+  ctx->buffersrc_ctx = nullptr;
+  ctx->buffersink_ctx = nullptr;
+  ctx->filter_graph_stateful = false;
+  ctx->filter_graph_fed = false;
+  ctx->last_pts = AV_NOPTS_VALUE;
+  ctx->packet_index = nullptr;
+
+  // if an index of this video stream was built when it was imported, use it for seeking
+  if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    PacketIndex* index = new PacketIndex();
+
+    if (index->Load(PacketIndex::GetPath(get_file_hash(filename), stream_index)) && !index->IsEmpty()) {
+      ctx->packet_index = index;
+    } else {
+      delete index;
+    }
+  }
+
+  return ctx;
+}
+
+AVCodecContext *DecoderPool::OpenCodec(AVStream *stream, int thread_count)
+{
+  AVCodec* codec = avcodec_find_decoder(stream->codecpar->codec_id);
+  if (codec == nullptr) {
+    qCritical() << "Could not find decoder for codec" << avcodec_get_name(stream->codecpar->codec_id);
+    return nullptr;
+  }
+
+  AVCodecContext* codec_ctx = avcodec_alloc_context3(codec);
+  avcodec_parameters_to_context(codec_ctx, stream->codecpar);
+
+  AVDictionary* opts = nullptr;
+
+  // enable multithreading on decoding, using as many threads as the caller was given by the decode scheduler
+  if (thread_count > 0) {
+    av_dict_set_int(&opts, "threads", thread_count, 0);
+  } else {
+    av_dict_set(&opts, "threads", "auto", 0);
+  }
+
+  // allocate video frames from the shared frame pool so decoders for different files can re-use each other's buffers
+  if (stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+    codec_ctx->get_buffer2 = FramePool::GetVideoBuffer;
+  }
+
+  // enable extra optimization code on h264 (not even sure if they help)
+  if (stream->codecpar->codec_id == AV_CODEC_ID_H264) {
+    av_dict_set(&opts, "tune", "fastdecode", 0);
+    av_dict_set(&opts, "tune", "zerolatency", 0);
+  }
+
+  // Open codec
+  int err = avcodec_open2(codec_ctx, codec, &opts);
+
+  av_dict_free(&opts);
+
+  if (err < 0) {
+    qCritical() << "Could not open codec" << avcodec_get_name(stream->codecpar->codec_id) << "-" << err;
+    avcodec_free_context(&codec_ctx);
+    return nullptr;
+  }
+
+  return codec_ctx;
+}
+
+void DecoderPool::Free(DecoderContext *ctx)
+{
+  if (ctx == nullptr) {
+    return;
+  }
+
+  if (ctx->filter_graph != nullptr) {
+    avfilter_graph_free(&ctx->filter_graph);
+  }
+
+  if (ctx->codec_ctx != nullptr) {
+    avcodec_close(ctx->codec_ctx);
+    avcodec_free_context(&ctx->codec_ctx);
+  }
+
+  if (ctx->format_ctx != nullptr) {
+    avformat_close_input(&ctx->format_ctx);
+  }
+
+  delete ctx->packet_index;
+
+  delete ctx;
+}
@@ -0,0 +1,245 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODERPOOL_H
+#define DECODERPOOL_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libavfilter/avfilter.h>
+}
+
+#include <QString>
+#include <QList>
+#include <QMutex>
+
+#include "decoders/packetindex.h"
+
+/**
+ * @brief The DecoderContext struct
+ *
+ * A set of open FFmpeg handles for one stream of one file: the demuxer, the decoder and (optionally) the filter graph
+ * that was last built on top of them. DecoderContext objects are owned by DecoderPool and lent out to Cacher objects
+ * with DecoderPool::Lease().
+ */
+struct DecoderContext {
+  /**
+   * @brief Filename that was opened (either the Footage URL or its proxy)
+   */
+  QString filename;
+
+  /**
+   * @brief Index of the stream in the file that the decoder was opened for
+   */
+  int stream_index;
+
+  /**
+   * @brief Image sequence start number the demuxer was opened with (0 for all other media)
+   */
+  int start_number;
+
+  /**
+   * @brief Number of threads the decoder was opened with (0 if FFmpeg chose automatically)
+   */
+  int thread_count;
+
+  /**
+   * @brief FFmpeg format/file context
+   */
+  AVFormatContext* format_ctx;
+
+  /**
+   * @brief FFmpeg decoder context
+   */
+  AVCodecContext* codec_ctx;
+
+  /**
+   * @brief Stream in format_ctx corresponding to stream_index
+   */
+  AVStream* stream;
+
+  /**
+   * @brief FFmpeg filter stack built by the last lessee, or `nullptr` if none has been built yet
+   */
+  AVFilterGraph* filter_graph;
+
+  /**
+   * @brief Buffer source of filter_graph
+   */
+  AVFilterContext* buffersrc_ctx;
+
+  /**
+   * @brief Buffer sink of filter_graph
+   */
+  AVFilterContext* buffersink_ctx;
+
+  /**
+   * @brief String describing the parameters filter_graph was built with
+   *
+   * A lessee that needs a filter graph compares its own description to this one and only rebuilds the graph if they
+   * differ.
+   */
+  QString filter_signature;
+
+  /**
+   * @brief Whether filter_graph keeps state from one frame to the next
+   *
+   * Deinterlacing holds on to neighboring frames and audio resampling/time-stretching holds on to samples, so a
+   * stateful graph has to be rebuilt whenever the decoder jumps somewhere else in the stream. Other graphs only need
+   * any frames left in them drained.
+   */
+  bool filter_graph_stateful;
+
+  /**
+   * @brief Whether any frames have been sent to filter_graph since it was built or last reset
+   */
+  bool filter_graph_fed;
+
+  /**
+   * @brief Timestamp of the last frame pulled through this context
+   *
+   * Set to AV_NOPTS_VALUE if the position of the decoder is unknown (e.g. it was never used, it reached the end of the
+   * file, or it was used for audio). If it's valid, a lessee that needs a frame shortly after this timestamp can keep
+   * decoding from here rather than seeking.
+   */
+  int64_t last_pts;
+
+  /**
+   * @brief Packet index of the stream for frame-accurate seeking, or `nullptr` if no index was available
+   *
+   * Loaded from the previews directory when the context is opened (see PacketIndex).
+   */
+  PacketIndex* packet_index;
+};
+
+/**
+ * @brief The DecoderPool class
+ *
+ * Opening a file (probing the format, finding stream information, and opening a decoder) is expensive, and on an
+ * edit with many cuts from the same file, consecutive clips would otherwise re-open the exact same file over and over.
+ * DecoderPool keeps a process-wide collection of open DecoderContext objects keyed by filename and stream index.
+ *
+ * A Cacher calls Lease() when it opens, which either hands back an idle context for the same file and stream or opens
+ * a new one, and calls Return() when it closes so the next clip can pick up the warm context. Idle contexts are kept
+ * up to a fixed limit, the least recently returned being freed first.
+ *
+ * All functions are thread-safe.
+ */
+class DecoderPool {
+public:
+  DecoderPool();
+
+  /**
+   * @brief DecoderPool Destructor
+   *
+   * Frees all idle contexts.
+   */
+  ~DecoderPool();
+
+  /**
+   * @brief Lease a decoder context for a file's stream
+   *
+   * Returns an idle context matching the filename and stream index if one exists (preferring the one most recently
+   * returned), or opens a new one otherwise. The context is exclusively owned by the caller until it's passed to
+   * Return() or Discard().
+   *
+   * @param filename
+   *
+   * The file to open
+   *
+   * @param stream_index
+   *
+   * The index of the stream in the file to decode
+   *
+   * @param start_number
+   *
+   * For image sequences that don't start at 0, the index where it does start. Use 0 for all other media.
+   *
+   * @param thread_count
+   *
+   * Number of threads to open a new decoder with, or 0 to let FFmpeg decide. A codec's thread count can't be changed
+   * once it's open, so idle contexts are handed back with whatever thread count they were last opened with. Use
+   * SetThreadCount() to change it once the decoder is at a point where it would be flushed anyway.
+   *
+   * @param error
+   *
+   * If not `nullptr`, set to a human-readable error if the file couldn't be opened.
+   *
+   * @return
+   *
+   * A context ready for decoding, or `nullptr` if the file or its decoder could not be opened.
+   */
+  DecoderContext* Lease(const QString& filename,
+                        int stream_index,
+                        int start_number,
+                        int thread_count = 0,
+                        QString* error = nullptr);
+
+  /**
+   * @brief Reopen a leased context's decoder with a different thread count
+   *
+   * Does nothing if the decoder already uses `thread_count` threads. Otherwise the decoder is closed and opened again,
+   * losing any frames it was in the middle of decoding, so this should only be called right before seeking. If the
+   * decoder can't be opened again, the current one is kept.
+   */
+  void SetThreadCount(DecoderContext* ctx, int thread_count);
+
+  /**
+   * @brief Return a leased context to the pool so it can be re-used
+   *
+   * The context's DecoderContext::last_pts should reflect where the decoder currently is. If the pool is over its
+   * idle limit, the least recently returned context is freed.
+   */
+  void Return(DecoderContext* ctx);
+
+  /**
+   * @brief Free a leased context rather than returning it to the pool
+   *
+   * Use if the context is in an unknown or invalid state.
+   */
+  void Discard(DecoderContext* ctx);
+
+  /**
+   * @brief Free all idle contexts
+   *
+   * Contexts that are currently leased are unaffected.
+   */
+  void Clear();
+
+private:
+  static DecoderContext* Open(const QString& filename,
+                              int stream_index,
+                              int start_number,
+                              int thread_count,
+                              QString* error);
+  // opens a decoder for a stream, returns nullptr if there's no decoder for its codec or it fails to open
+  static AVCodecContext* OpenCodec(AVStream* stream, int thread_count);
+  static void Free(DecoderContext* ctx);
+
+  QList<DecoderContext*> idle_;
+  QMutex lock_;
+};
+
+namespace olive {
+extern DecoderPool decoder_pool;
+}
+
+#endif // DECODERPOOL_H
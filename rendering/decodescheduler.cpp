@@ -0,0 +1,243 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "decodescheduler.h"
+
+#include <QDebug>
+
+#include "global/config.h"
+
+DecodeScheduler olive::decode_scheduler;
+
+// video needed within this many seconds is decoded at normal priority, anything later at low priority
+const double kDecodeSoonThreshold = 1.0;
+
+DecodeScheduler::DecodeScheduler() :
+  core_count_(qMax(1, QThread::idealThreadCount()))
+{
+}
+
+DecodeAllocation DecodeScheduler::Register(QThread *thread, olive::TrackType type, double seconds_until_needed)
+{
+  QMutexLocker locker(&lock_);
+
+  // remove any stale registration for this thread (e.g. a Cacher that's being re-opened)
+  for (int i=0;i<allocations_.size();i++) {
+    if (allocations_.at(i).thread == thread) {
+      allocations_.removeAt(i);
+      break;
+    }
+  }
+
+  DecodeAllocation allocation;
+  allocation.thread = thread;
+  allocation.type = type;
+  allocation.seconds_until_needed = seconds_until_needed;
+  allocation.priority = GetPriority(type, seconds_until_needed);
+  allocation.threads = 1;
+
+  allocations_.append(allocation);
+
+  // the other decoders' shares shrink to make room for this one
+  Rebalance();
+
+  LogAllocations();
+
+  return allocations_.last();
+}
+
+void DecodeScheduler::Update(QThread *thread, double seconds_until_needed)
+{
+  QMutexLocker locker(&lock_);
+
+  for (int i=0;i<allocations_.size();i++) {
+    DecodeAllocation& a = allocations_[i];
+
+    if (a.thread == thread) {
+      a.seconds_until_needed = seconds_until_needed;
+
+      QThread::Priority priority = GetPriority(a.type, seconds_until_needed);
+
+      if (priority != a.priority) {
+        a.priority = priority;
+
+        // only has an effect if the thread is running, otherwise the priority is used next time it's started
+        a.thread->setPriority(priority);
+
+        // threads are only moved between decoders when one changes priority, since applying a new thread count means
+        // reopening the decoder's codec
+        Rebalance();
+
+        LogAllocations();
+      }
+
+      return;
+    }
+  }
+}
+
+void DecodeScheduler::Unregister(QThread *thread)
+{
+  QMutexLocker locker(&lock_);
+
+  for (int i=0;i<allocations_.size();i++) {
+    if (allocations_.at(i).thread == thread) {
+      allocations_.removeAt(i);
+
+      // give this decoder's share back to the others
+      Rebalance();
+
+      LogAllocations();
+      return;
+    }
+  }
+}
+
+int DecodeScheduler::Threads(QThread *thread)
+{
+  QMutexLocker locker(&lock_);
+
+  for (int i=0;i<allocations_.size();i++) {
+    if (allocations_.at(i).thread == thread) {
+      return allocations_.at(i).threads;
+    }
+  }
+
+  return 0;
+}
+
+int64_t DecodeScheduler::ReverseBufferBytes(QThread *thread)
+{
+  QMutexLocker locker(&lock_);
+
+  bool registered = false;
+  int video_decoders = 0;
+
+  for (int i=0;i<allocations_.size();i++) {
+    const DecodeAllocation& a = allocations_.at(i);
+    if (a.type == olive::kTypeVideo) {
+      video_decoders++;
+      if (a.thread == thread) {
+        registered = true;
+      }
+    }
+  }
+
+  if (!registered) {
+    return 0;
+  }
+
+  return int64_t(olive::config.reverse_buffer_size) * 1048576 / (video_decoders * 2);
+}
+
+QVector<DecodeAllocation> DecodeScheduler::Allocations()
+{
+  QMutexLocker locker(&lock_);
+
+  return allocations_;
+}
+
+int DecodeScheduler::CoreCount()
+{
+  return core_count_;
+}
+
+QThread::Priority DecodeScheduler::GetPriority(olive::TrackType type, double seconds_until_needed)
+{
+  // audio dropouts are far more noticeable than dropped frames
+  if (type == olive::kTypeAudio) {
+    return QThread::TimeCriticalPriority;
+  }
+
+  if (seconds_until_needed <= 0) {
+    return QThread::HighPriority;
+  }
+
+  if (seconds_until_needed < kDecodeSoonThreshold) {
+    return QThread::NormalPriority;
+  }
+
+  return QThread::LowPriority;
+}
+
+int DecodeScheduler::GetWeight(QThread::Priority priority)
+{
+  switch (priority) {
+  case QThread::HighPriority:
+    return 4;
+  case QThread::NormalPriority:
+    return 2;
+  default:
+    return 1;
+  }
+}
+
+void DecodeScheduler::Rebalance()
+{
+  int audio_decoders = 0;
+  int video_decoders = 0;
+  int total_weight = 0;
+
+  for (int i=0;i<allocations_.size();i++) {
+    const DecodeAllocation& a = allocations_.at(i);
+
+    if (a.type == olive::kTypeVideo) {
+      video_decoders++;
+      total_weight += GetWeight(a.priority);
+    } else {
+      audio_decoders++;
+    }
+  }
+
+  // audio decoding is cheap, but reserve a core for each stream anyway since it must never stall
+  int video_cores = qMax(video_decoders, core_count_ - audio_decoders);
+
+  for (int i=0;i<allocations_.size();i++) {
+    DecodeAllocation& a = allocations_[i];
+
+    // audio codecs gain very little from threading
+    int threads = 1;
+
+    if (a.type == olive::kTypeVideo) {
+      threads = qMax(1, video_cores * GetWeight(a.priority) / total_weight);
+    }
+
+    a.threads = threads;
+  }
+}
+
+void DecodeScheduler::LogAllocations()
+{
+  int video_threads = 0;
+  int audio_threads = 0;
+
+  for (int i=0;i<allocations_.size();i++) {
+    const DecodeAllocation& a = allocations_.at(i);
+
+    if (a.type == olive::kTypeVideo) {
+      video_threads += a.threads;
+    } else {
+      audio_threads += a.threads;
+    }
+  }
+
+  qDebug() << "Decode budget:" << allocations_.size() << "decoders using" << video_threads << "video +"
+           << audio_threads << "audio threads of" << core_count_ << "cores";
+}
@@ -0,0 +1,177 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef DECODESCHEDULER_H
+#define DECODESCHEDULER_H
+
+#include <QThread>
+#include <QVector>
+#include <QMutex>
+
+#include "timeline/tracktypes.h"
+
+/**
+ * @brief The DecodeAllocation struct
+ *
+ * The share of the CPU DecodeScheduler has given one decoder.
+ */
+struct DecodeAllocation {
+  /**
+   * @brief Thread the decoder runs on (usually a Cacher)
+   */
+  QThread* thread;
+
+  /**
+   * @brief Type of media being decoded
+   */
+  olive::TrackType type;
+
+  /**
+   * @brief How long until the decoder's frames are needed in seconds (0 if they're needed now)
+   */
+  double seconds_until_needed;
+
+  /**
+   * @brief Number of threads the decoder should open its codec with
+   */
+  int threads;
+
+  /**
+   * @brief Priority of the decoder's own thread
+   */
+  QThread::Priority priority;
+};
+
+/**
+ * @brief The DecodeScheduler class
+ *
+ * Every open clip decodes in its own Cacher thread, and every codec would otherwise open with as many threads as
+ * there are cores. With several layers open at once this creates far more threads than cores, all competing with each
+ * other. DecodeScheduler is a central budget that each decoder registers with when it opens:
+ *
+ * * Codec threads are shared out of the machine's core count. Audio decoders get one thread each, and the remaining
+ *   cores are split between all video decoders (at least one each) weighted by how soon their frames are needed. The
+ *   split is recalculated whenever a decoder registers, unregisters or becomes more or less urgent. A codec's thread
+ *   count is fixed once it's opened, so decoders pick up their new count with Threads() and apply it the next time
+ *   they seek (see Decoder::SetThreadCount()).
+ * * Memory for reversed playback (see olive::config.reverse_buffer_size) is split evenly between all video decoders.
+ * * Thread priority is based on how soon a decoder's frames are needed. Audio always runs at time-critical priority,
+ *   video needed now runs at high priority and video needed later runs at lower priorities. Priorities are updated
+ *   whenever a decoder calls Update().
+ *
+ * The current allocation is written to the debug log whenever it changes and can be retrieved with Allocations().
+ *
+ * All functions are thread-safe.
+ */
+class DecodeScheduler {
+public:
+  DecodeScheduler();
+
+  /**
+   * @brief Add a decoder to the budget
+   *
+   * Call before the thread is started and use the returned priority to start it.
+   *
+   * @param thread
+   *
+   * Thread the decoder runs on, used to identify it and to change its priority later
+   *
+   * @param type
+   *
+   * Type of media being decoded
+   *
+   * @param seconds_until_needed
+   *
+   * How long until the decoder's frames are needed (0 if they're needed now)
+   *
+   * @return
+   *
+   * The thread count and priority given to this decoder
+   */
+  DecodeAllocation Register(QThread* thread, olive::TrackType type, double seconds_until_needed);
+
+  /**
+   * @brief Update how soon a registered decoder's frames are needed, adjusting its thread priority and the thread
+   * counts of every video decoder if necessary
+   */
+  void Update(QThread* thread, double seconds_until_needed);
+
+  /**
+   * @brief Remove a decoder from the budget
+   */
+  void Unregister(QThread* thread);
+
+  /**
+   * @brief Get the number of threads currently allocated to a registered decoder (0 if it isn't registered)
+   */
+  int Threads(QThread* thread);
+
+  /**
+   * @brief Get the memory a registered video decoder may use for each of its two reversed playback buffers
+   *
+   * olive::config.reverse_buffer_size is split evenly between all registered video decoders, so the total stays
+   * within it no matter how many clips are playing in reverse. Returns 0 if the decoder isn't a registered video
+   * decoder.
+   */
+  int64_t ReverseBufferBytes(QThread* thread);
+
+  /**
+   * @brief Get the current allocation of every registered decoder
+   */
+  QVector<DecodeAllocation> Allocations();
+
+  /**
+   * @brief Total number of codec threads the budget is shared out of
+   */
+  int CoreCount();
+
+private:
+  /**
+   * @brief Internal function to get the thread priority for a decoder
+   */
+  static QThread::Priority GetPriority(olive::TrackType type, double seconds_until_needed);
+
+  /**
+   * @brief Internal function to get how large a share of the cores a video decoder gets relative to the others
+   */
+  static int GetWeight(QThread::Priority priority);
+
+  /**
+   * @brief Internal function to split the cores between all registered decoders (lock_ must be locked)
+   */
+  void Rebalance();
+
+  /**
+   * @brief Internal function to write the current allocation to the debug log (lock_ must be locked)
+   */
+  void LogAllocations();
+
+  QVector<DecodeAllocation> allocations_;
+
+  int core_count_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern DecodeScheduler decode_scheduler;
+}
+
+#endif // DECODESCHEDULER_H
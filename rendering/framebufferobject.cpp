@@ -31,7 +31,10 @@
 FramebufferObject::FramebufferObject() :
   buffer_(0),
   texture_(0),
-  ctx_(nullptr)
+  ctx_(nullptr),
+  width_(0),
+  height_(0),
+  format_(olive::PIX_FMT_RGBA8)
 {}
 
 FramebufferObject::~FramebufferObject()
@@ -51,6 +54,9 @@ void FramebufferObject::Create(QOpenGLContext *ctx, int width, int height)
 
   // set context to new context provided
   ctx_ = ctx;
+  width_ = width;
+  height_ = height;
+  format_ = CreationFormat();
 
   QOpenGLFunctions* f = ctx->functions();
 
@@ -67,9 +73,7 @@ void FramebufferObject::Create(QOpenGLContext *ctx, int width, int height)
   f->glBindTexture(GL_TEXTURE_2D, texture_);
 
   // allocate storage for texture
-  const olive::PixelFormatInfo& bit_depth = olive::pixel_formats.at(olive::Global->is_exporting() ?
-                                                                      olive::config.export_bit_depth :
-                                                                      olive::config.playback_bit_depth);
+  const olive::PixelFormatInfo& bit_depth = olive::pixel_formats.at(format_);
 
   ctx->functions()->glTexImage2D(
         GL_TEXTURE_2D,
@@ -155,3 +159,30 @@ const GLuint &FramebufferObject::texture() const
 {
   return texture_;
 }
+
+int FramebufferObject::width() const
+{
+  return width_;
+}
+
+int FramebufferObject::height() const
+{
+  return height_;
+}
+
+QOpenGLContext *FramebufferObject::context() const
+{
+  return ctx_;
+}
+
+olive::PixelFormat FramebufferObject::format() const
+{
+  return format_;
+}
+
+olive::PixelFormat FramebufferObject::CreationFormat()
+{
+  return static_cast<olive::PixelFormat>(olive::Global->is_exporting() ?
+                                           olive::config.export_bit_depth :
+                                           olive::config.playback_bit_depth);
+}
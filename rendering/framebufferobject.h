@@ -23,6 +23,8 @@
 
 #include <QOpenGLContext>
 
+#include "rendering/pixelformats.h"
+
 class FramebufferObject
 {
 public:
@@ -36,6 +38,17 @@ public:
   const GLuint& buffer() const;
   const GLuint& texture() const;
 
+  int width() const;
+  int height() const;
+
+  QOpenGLContext* context() const;
+  olive::PixelFormat format() const;
+
+  /**
+   * @brief Pixel format that Create() currently allocates textures in (which depends on whether we're exporting)
+   */
+  static olive::PixelFormat CreationFormat();
+
   void BindBuffer() const;
   void ReleaseBuffer() const;
 
@@ -45,6 +58,9 @@ private:
   QOpenGLContext* ctx_;
   GLuint buffer_;
   GLuint texture_;
+  int width_;
+  int height_;
+  olive::PixelFormat format_;
 };
 
 #endif // FRAMEBUFFEROBJECT_H
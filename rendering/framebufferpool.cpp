@@ -0,0 +1,140 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framebufferpool.h"
+
+#include <QDebug>
+
+#include "global/config.h"
+#include "rendering/pixelformats.h"
+
+FramebufferPool olive::framebuffer_pool;
+
+FramebufferPool::FramebufferPool() :
+  resident_bytes_(0),
+  hits_(0),
+  misses_(0)
+{}
+
+FramebufferObject *FramebufferPool::Acquire(QOpenGLContext *ctx, int width, int height)
+{
+  QMutexLocker locker(&lock_);
+
+  olive::PixelFormat format = FramebufferObject::CreationFormat();
+
+  // look for the most recently released matching framebuffer since it's the most likely to still be in VRAM
+  for (int i=free_.size()-1;i>=0;i--) {
+    FramebufferObject* buffer = free_.at(i);
+
+    if (buffer->context() == ctx
+        && buffer->width() == width
+        && buffer->height() == height
+        && buffer->format() == format) {
+      free_.removeAt(i);
+      in_use_.append(buffer);
+
+      hits_++;
+
+      return buffer;
+    }
+  }
+
+  FramebufferObject* buffer = new FramebufferObject();
+  buffer->Create(ctx, width, height);
+
+  in_use_.append(buffer);
+  resident_bytes_ += BufferBytes(buffer);
+
+  misses_++;
+
+  return buffer;
+}
+
+void FramebufferPool::Release(FramebufferObject *buffer)
+{
+  QMutexLocker locker(&lock_);
+
+  if (!in_use_.removeOne(buffer)) {
+    qWarning() << "Released a framebuffer that wasn't acquired from the pool";
+    return;
+  }
+
+  free_.append(buffer);
+
+  Trim(buffer->context(), int64_t(olive::config.framebuffer_pool_size) * 1048576);
+}
+
+void FramebufferPool::Clear(QOpenGLContext *ctx)
+{
+  QMutexLocker locker(&lock_);
+
+  Trim(ctx, 0);
+}
+
+int FramebufferPool::InUseCount()
+{
+  QMutexLocker locker(&lock_);
+
+  return in_use_.size();
+}
+
+double FramebufferPool::HitRate()
+{
+  QMutexLocker locker(&lock_);
+
+  if (hits_ + misses_ == 0) {
+    return 0.0;
+  }
+
+  return double(hits_) / double(hits_ + misses_);
+}
+
+int64_t FramebufferPool::ResidentBytes()
+{
+  QMutexLocker locker(&lock_);
+
+  return resident_bytes_;
+}
+
+void FramebufferPool::Trim(QOpenGLContext *ctx, int64_t max_bytes)
+{
+  for (int i=0;i<free_.size() && resident_bytes_ > max_bytes;i++) {
+    FramebufferObject* buffer = free_.at(i);
+
+    // framebuffers can only be freed with their own context
+    if (buffer->context() != ctx) {
+      continue;
+    }
+
+    resident_bytes_ -= BufferBytes(buffer);
+
+    delete buffer;
+
+    free_.removeAt(i);
+    i--;
+  }
+}
+
+int64_t FramebufferPool::BufferBytes(FramebufferObject *buffer)
+{
+  return int64_t(buffer->width())
+      * int64_t(buffer->height())
+      * olive::pixel_formats.at(buffer->format()).bytes_per_pixel;
+}
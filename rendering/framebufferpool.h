@@ -0,0 +1,124 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QOpenGLContext>
+#include <QVector>
+#include <QMutex>
+
+#include "rendering/framebufferobject.h"
+
+/**
+ * @brief The FramebufferPool class
+ *
+ * Every clip needs two framebuffers (three for nested sequences) at its media's resolution to run its effects while
+ * it's being composed, but only for as long as it takes to draw it onto the sequence. Rather than every open clip
+ * creating and holding on to its own, compose_sequence() checks them out of this pool with Acquire() and gives them
+ * back with Release() once the clip has been drawn, so clips of the same resolution share the same few framebuffers
+ * and opening or closing clips at edit points doesn't allocate or free any textures.
+ *
+ * Framebuffers belong to the OpenGL context they were created in, so they're only handed out to the same context. Idle
+ * framebuffers are freed, least recently used first, once the pool exceeds Config::framebuffer_pool_size.
+ *
+ * All functions are thread-safe.
+ */
+class FramebufferPool {
+public:
+  FramebufferPool();
+
+  /**
+   * @brief Check out a framebuffer
+   *
+   * Returns an idle framebuffer of this size and the pixel format FramebufferObject::Create() currently uses, or
+   * creates one if there isn't one. The framebuffer's contents are undefined.
+   *
+   * @param ctx
+   *
+   * The context to draw with, which must be current
+   */
+  FramebufferObject* Acquire(QOpenGLContext* ctx, int width, int height);
+
+  /**
+   * @brief Give back a framebuffer checked out with Acquire()
+   *
+   * The framebuffer's context must be current since idle framebuffers may be freed to stay within
+   * Config::framebuffer_pool_size.
+   */
+  void Release(FramebufferObject* buffer);
+
+  /**
+   * @brief Free all idle framebuffers belonging to a context
+   *
+   * Should be called before the context is destroyed, with the context current.
+   */
+  void Clear(QOpenGLContext* ctx);
+
+  /**
+   * @brief Number of framebuffers currently checked out
+   */
+  int InUseCount();
+
+  /**
+   * @brief Fraction (0.0 - 1.0) of calls to Acquire() that were served with an idle framebuffer
+   */
+  double HitRate();
+
+  /**
+   * @brief Total size in bytes of the textures of all framebuffers in the pool (whether in use or idle)
+   */
+  int64_t ResidentBytes();
+
+private:
+  /**
+   * @brief Internal function to free a context's least recently used idle framebuffers until the pool is within
+   * `max_bytes`, lock_ must be locked
+   */
+  void Trim(QOpenGLContext* ctx, int64_t max_bytes);
+
+  /**
+   * @brief Internal function to get the size of a framebuffer's texture in bytes
+   */
+  static int64_t BufferBytes(FramebufferObject* buffer);
+
+  /**
+   * @brief Idle framebuffers, ordered from least to most recently released
+   */
+  QVector<FramebufferObject*> free_;
+
+  /**
+   * @brief Framebuffers currently checked out with Acquire()
+   */
+  QVector<FramebufferObject*> in_use_;
+
+  int64_t resident_bytes_;
+
+  quint64 hits_;
+  quint64 misses_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern FramebufferPool framebuffer_pool;
+}
+
+#endif // FRAMEBUFFERPOOL_H
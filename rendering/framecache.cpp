@@ -0,0 +1,243 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framecache.h"
+
+#include "global/config.h"
+#include "global/path.h"
+#include "rendering/framepool.h"
+
+FrameCache olive::frame_cache;
+
+FrameCache::FrameCache() :
+  use_counter_(0),
+  resident_bytes_(0),
+  hits_(0),
+  misses_(0)
+{}
+
+FrameCache::~FrameCache()
+{
+  QHash<QString, QMap<int64_t, Entry> >::iterator i;
+
+  for (i=frames_.begin();i!=frames_.end();i++) {
+    QMap<int64_t, Entry>::iterator j;
+
+    for (j=i.value().begin();j!=i.value().end();j++) {
+      av_frame_free(&j.value().frame);
+    }
+  }
+}
+
+QString FrameCache::GetKey(const DecoderParams &params, olive::PixelFormat pixel_format)
+{
+  return QString("%1:%2:%3:%4:%5:%6").arg(get_file_hash(params.filename),
+                                          QString::number(params.stream_index),
+                                          QString::number(pixel_format),
+                                          QString::number(params.video_native_yuv),
+                                          QString::number(params.video_interlacing),
+                                          QString::number(params.video_divider));
+}
+
+bool FrameCache::Get(const QString &key, int64_t pts, AVFrame *frame, int64_t *next_pts)
+{
+  QMutexLocker locker(&lock_);
+
+  QHash<QString, QMap<int64_t, Entry> >::iterator source = frames_.find(key);
+
+  if (source != frames_.end()) {
+
+    // find the last frame at or before pts
+    QMap<int64_t, Entry>::iterator i = source.value().upperBound(pts);
+
+    if (i != source.value().begin()) {
+      --i;
+
+      Entry& entry = i.value();
+
+      // if this frame isn't exactly at pts, it's only the frame shown at pts if the frame after it is later than pts
+      if ((i.key() == pts || (entry.next_pts != AV_NOPTS_VALUE && entry.next_pts > pts))
+          && av_frame_ref(frame, entry.frame) >= 0) {
+        if (next_pts != nullptr) {
+          *next_pts = entry.next_pts;
+        }
+
+        Touch(key, entry);
+
+        hits_++;
+
+        return true;
+      }
+    }
+  }
+
+  misses_++;
+
+  return false;
+}
+
+void FrameCache::Add(const QString &key, const AVFrame *frame, int64_t previous_pts)
+{
+  int64_t max_bytes = int64_t(olive::config.frame_cache_size) * 1048576;
+
+  if (max_bytes <= 0 || frame->pts == AV_NOPTS_VALUE) {
+    return;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  QMap<int64_t, Entry>& source = frames_[key];
+
+  if (previous_pts != AV_NOPTS_VALUE) {
+    QMap<int64_t, Entry>::iterator previous = source.find(previous_pts);
+
+    if (previous != source.end()) {
+      previous.value().next_pts = frame->pts;
+    }
+  }
+
+  QMap<int64_t, Entry>::iterator existing = source.find(frame->pts);
+
+  // the frame may already be cached if it was decoded again after a seek, keep the one that's already shared
+  if (existing != source.end()) {
+    Touch(key, existing.value());
+    return;
+  }
+
+  AVFrame* ref = av_frame_clone(frame);
+
+  if (ref == nullptr) {
+    return;
+  }
+
+  Entry entry;
+  entry.frame = ref;
+  entry.bytes = 0;
+  entry.next_pts = AV_NOPTS_VALUE;
+  entry.last_used = ++use_counter_;
+
+  for (int i=0;i<AV_NUM_DATA_POINTERS && ref->buf[i] != nullptr;i++) {
+    entry.bytes += ref->buf[i]->size;
+  }
+
+  source.insert(frame->pts, entry);
+  lru_.insert(entry.last_used, QPair<QString, int64_t>(key, frame->pts));
+  resident_bytes_ += entry.bytes;
+
+  Trim(max_bytes);
+
+  // freed frames' buffers are only idle in the frame pool, so count them against the same budget
+  olive::frame_pool.SetMaxIdleBytes(max_bytes - resident_bytes_);
+}
+
+void FrameCache::Clear()
+{
+  QMutexLocker locker(&lock_);
+
+  Trim(0);
+
+  olive::frame_pool.SetMaxIdleBytes(int64_t(olive::config.frame_cache_size) * 1048576);
+}
+
+int64_t FrameCache::Hits()
+{
+  return hits_;
+}
+
+int64_t FrameCache::Misses()
+{
+  return misses_;
+}
+
+double FrameCache::HitRate()
+{
+  int64_t hits = hits_;
+  int64_t lookups = hits + misses_;
+
+  if (lookups == 0) {
+    return 0.0;
+  }
+
+  return double(hits) / double(lookups);
+}
+
+int64_t FrameCache::ResidentBytes()
+{
+  QMutexLocker locker(&lock_);
+
+  return resident_bytes_;
+}
+
+void FrameCache::Touch(const QString &key, Entry &entry)
+{
+  lru_.remove(entry.last_used);
+
+  entry.last_used = ++use_counter_;
+
+  lru_.insert(entry.last_used, QPair<QString, int64_t>(key, entry.frame->pts));
+}
+
+void FrameCache::Trim(int64_t max_bytes)
+{
+  // free frames nothing else references first, then anything else if we're still over
+  for (int pass=0;pass<2 && resident_bytes_ > max_bytes;pass++) {
+    QMap<quint64, QPair<QString, int64_t> >::iterator i = lru_.begin();
+
+    while (i != lru_.end() && resident_bytes_ > max_bytes) {
+      QPair<QString, int64_t> location = i.value();
+
+      // move past this entry now since Remove() erases it from lru_
+      ++i;
+
+      const Entry& entry = frames_[location.first][location.second];
+
+      if (pass == 0 && entry.frame->buf[0] != nullptr && av_buffer_get_ref_count(entry.frame->buf[0]) > 1) {
+        continue;
+      }
+
+      Remove(location.first, location.second);
+    }
+  }
+}
+
+void FrameCache::Remove(const QString &key, int64_t pts)
+{
+  QHash<QString, QMap<int64_t, Entry> >::iterator source = frames_.find(key);
+
+  if (source == frames_.end()) {
+    return;
+  }
+
+  QMap<int64_t, Entry>::iterator i = source.value().find(pts);
+
+  if (i == source.value().end()) {
+    return;
+  }
+
+  lru_.remove(i.value().last_used);
+  resident_bytes_ -= i.value().bytes;
+  av_frame_free(&i.value().frame);
+
+  source.value().erase(i);
+
+  if (source.value().isEmpty()) {
+    frames_.erase(source);
+  }
+}
@@ -0,0 +1,203 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMECACHE_H
+#define FRAMECACHE_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QHash>
+#include <QMap>
+#include <QMutex>
+#include <QPair>
+#include <atomic>
+
+#include "decoders/decoder.h"
+
+/**
+ * @brief The FrameCache class
+ *
+ * Each Cacher's ClipQueue only holds the few frames around its clip's playhead, and loses them all as soon as the clip
+ * closes. FrameCache is a project-wide cache that every Cacher adds the video frames it decodes to, so that frames of
+ * media that was recently played (by any clip, whether it's still open or not) can be shown again without seeking and
+ * decoding. Its total size is bounded by Config::frame_cache_size rather than by the number of open clips. Frames freed
+ * from the cache go back to olive::frame_pool, so whatever part of the budget the cache isn't using is what the pool
+ * may keep in idle buffers.
+ *
+ * Frames are reference counted by FFmpeg, so a frame that's both in the cache and in a ClipQueue only takes up memory
+ * once. When the cache is full, the least recently used frames that no ClipQueue references are freed first, since
+ * freeing frames that are still referenced doesn't free any memory until the clip is done with them.
+ *
+ * Frames are keyed by media with GetKey() and by timestamp. Add() also records which frame was decoded after which, so
+ * Get() can tell whether a cached frame is the one shown at a timestamp between two frames, and Cachers can follow the
+ * sequence of cached frames after it without decoding.
+ *
+ * All functions are thread-safe.
+ */
+class FrameCache {
+public:
+  FrameCache();
+
+  /**
+   * @brief FrameCache Destructor
+   *
+   * Frees all frames.
+   */
+  ~FrameCache();
+
+  /**
+   * @brief Get the key to identify a media stream's frames with
+   *
+   * @param params
+   *
+   * The parameters the stream's decoder was opened with
+   *
+   * @param pixel_format
+   *
+   * The pixel format frames are conformed to
+   */
+  static QString GetKey(const DecoderParams& params, olive::PixelFormat pixel_format);
+
+  /**
+   * @brief Get a reference to the cached frame that's shown at a timestamp
+   *
+   * @param pts
+   *
+   * Timestamp of the desired frame in terms of the media's timebase
+   *
+   * @param frame
+   *
+   * An empty frame to receive a new reference to the cached frame
+   *
+   * @param next_pts
+   *
+   * If not `nullptr`, set to the timestamp of the frame decoded after the returned one, or AV_NOPTS_VALUE if it isn't
+   * known.
+   *
+   * @return
+   *
+   * **TRUE** if the cache has the frame at `pts` (or the frame before it along with the frame after it, meaning there
+   * is no frame at `pts` in the stream).
+   */
+  bool Get(const QString& key, int64_t pts, AVFrame* frame, int64_t* next_pts = nullptr);
+
+  /**
+   * @brief Add a decoded frame to the cache
+   *
+   * The cache keeps its own reference to the frame's buffers, the caller still owns `frame`. May free the least
+   * recently used frames to stay within Config::frame_cache_size.
+   *
+   * @param frame
+   *
+   * The frame to add. Frames without a timestamp are ignored.
+   *
+   * @param previous_pts
+   *
+   * Timestamp of the frame the decoder output right before this one, or AV_NOPTS_VALUE if this frame came right after
+   * a seek.
+   */
+  void Add(const QString& key, const AVFrame* frame, int64_t previous_pts);
+
+  /**
+   * @brief Free all cached frames
+   *
+   * Frames still referenced by a ClipQueue stay valid until the queue releases them.
+   */
+  void Clear();
+
+  /**
+   * @brief Amount of calls to Get() that found a frame
+   */
+  int64_t Hits();
+
+  /**
+   * @brief Amount of calls to Get() that didn't find a frame
+   */
+  int64_t Misses();
+
+  /**
+   * @brief Fraction (0.0 - 1.0) of calls to Get() that found a frame
+   */
+  double HitRate();
+
+  /**
+   * @brief Total size in bytes of all cached frames (whether a ClipQueue references them too or not)
+   */
+  int64_t ResidentBytes();
+
+private:
+  struct Entry {
+    AVFrame* frame;
+    int64_t bytes;
+    int64_t next_pts;
+    quint64 last_used;
+  };
+
+  /**
+   * @brief Internal function to mark an entry as the most recently used
+   *
+   * lock_ must be locked.
+   */
+  void Touch(const QString& key, Entry& entry);
+
+  /**
+   * @brief Internal function to free the least recently used frames until the cache is within `max_bytes`
+   *
+   * Frames that no ClipQueue references are freed first. lock_ must be locked.
+   */
+  void Trim(int64_t max_bytes);
+
+  /**
+   * @brief Internal function to free a frame and remove it from the cache
+   *
+   * lock_ must be locked.
+   */
+  void Remove(const QString& key, int64_t pts);
+
+  /**
+   * @brief Cached frames of each media stream keyed by timestamp
+   */
+  QHash<QString, QMap<int64_t, Entry> > frames_;
+
+  /**
+   * @brief Media key and timestamp of every cached frame, ordered from least to most recently used
+   */
+  QMap<quint64, QPair<QString, int64_t> > lru_;
+
+  /**
+   * @brief Incremented every time an entry is used, for ordering entries from least to most recently used
+   */
+  quint64 use_counter_;
+
+  int64_t resident_bytes_;
+
+  QMutex lock_;
+
+  std::atomic<int64_t> hits_;
+  std::atomic<int64_t> misses_;
+};
+
+namespace olive {
+extern FrameCache frame_cache;
+}
+
+#endif // FRAMECACHE_H
@@ -0,0 +1,349 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "framepool.h"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+FramePool olive::frame_pool;
+
+// maximum amount of idle frame structs kept for re-use
+const int kMaxIdleFrames = 256;
+
+// idle buffers kept for each buffer size that's in use, even if it goes over the maximum idle bytes
+const int kMinIdleBuffers = 4;
+
+FramePool::FramePool() :
+  idle_bytes_(0),
+  max_idle_bytes_(0),
+  buffer_requests_(0),
+  buffer_allocations_(0),
+  resident_bytes_(0)
+{}
+
+FramePool::~FramePool()
+{
+  Clear();
+
+  // any buffer still referenced at this point would be returned to a deleted bucket, but by now all frames are freed
+  QList<BufferBucket*> buckets = buckets_.values();
+  for (int i=0;i<buckets.size();i++) {
+    delete buckets.at(i);
+  }
+}
+
+AVFrame *FramePool::Get()
+{
+  lock_.lock();
+
+  if (!idle_frames_.isEmpty()) {
+    AVFrame* frame = idle_frames_.takeLast();
+    lock_.unlock();
+    return frame;
+  }
+
+  lock_.unlock();
+
+  return av_frame_alloc();
+}
+
+void FramePool::Release(AVFrame *frame)
+{
+  if (frame == nullptr) {
+    return;
+  }
+
+  // returns the frame's buffers to their pools
+  av_frame_unref(frame);
+
+  lock_.lock();
+
+  if (idle_frames_.size() < kMaxIdleFrames) {
+    idle_frames_.append(frame);
+    frame = nullptr;
+  }
+
+  lock_.unlock();
+
+  av_frame_free(&frame);
+}
+
+void FramePool::Clear()
+{
+  lock_.lock();
+
+  QVector<AVFrame*> frames = idle_frames_;
+  idle_frames_.clear();
+
+  // buffers still in use are kept or freed as usual when they're returned
+  QMap<int, BufferBucket*>::iterator i;
+  for (i=buckets_.begin();i!=buckets_.end();i++) {
+    BufferBucket* bucket = i.value();
+
+    for (int j=0;j<bucket->idle.size();j++) {
+      av_free(bucket->idle.at(j));
+    }
+
+    resident_bytes_ -= int64_t(bucket->size) * bucket->idle.size();
+    bucket->idle.clear();
+  }
+
+  idle_bytes_ = 0;
+
+  lock_.unlock();
+
+  for (int j=0;j<frames.size();j++) {
+    av_frame_free(&frames[j]);
+  }
+}
+
+int FramePool::GetVideoBuffer(AVCodecContext *s, AVFrame *frame, int flags)
+{
+  AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(frame->format);
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(pix_fmt);
+
+  if (s->codec_type != AVMEDIA_TYPE_VIDEO
+      || !(s->codec->capabilities & AV_CODEC_CAP_DR1)
+      || desc == nullptr
+      || (desc->flags & (AV_PIX_FMT_FLAG_HWACCEL | AV_PIX_FMT_FLAG_PAL))) {
+    return avcodec_default_get_buffer2(s, frame, flags);
+  }
+
+  // pad the dimensions to what the decoder needs
+  int width = frame->width;
+  int height = frame->height;
+  int linesize_align[AV_NUM_DATA_POINTERS];
+  avcodec_align_dimensions2(s, &width, &height, linesize_align);
+
+  // widen the frame until every plane's line size is aligned (the same way avcodec_default_get_buffer2() does it)
+  int linesizes[4];
+  bool unaligned;
+  do {
+    int ret = av_image_fill_linesizes(linesizes, pix_fmt, width);
+    if (ret < 0) {
+      return ret;
+    }
+
+    width += width & ~(width - 1);
+
+    unaligned = false;
+    for (int i=0;i<4;i++) {
+      if (linesize_align[i] > 0 && linesizes[i] % linesize_align[i] != 0) {
+        unaligned = true;
+      }
+    }
+  } while (unaligned);
+
+  // get the size of all planes laid out one after another
+  uint8_t* data[4];
+  int size = av_image_fill_pointers(data, pix_fmt, height, nullptr, linesizes);
+  if (size < 0) {
+    return size;
+  }
+
+  // some decoders read/write slightly past the end of the last plane
+  AVBufferRef* buf = olive::frame_pool.GetBuffer(size + AV_INPUT_BUFFER_PADDING_SIZE);
+  if (buf == nullptr) {
+    return AVERROR(ENOMEM);
+  }
+
+  av_image_fill_pointers(frame->data, pix_fmt, height, buf->data, linesizes);
+
+  for (int i=0;i<4;i++) {
+    frame->linesize[i] = linesizes[i];
+  }
+
+  frame->buf[0] = buf;
+  frame->extended_data = frame->data;
+
+  return 0;
+}
+
+int FramePool::GetFrameBuffer(AVFrame *frame)
+{
+  AVPixelFormat pix_fmt = static_cast<AVPixelFormat>(frame->format);
+
+  int linesizes[4];
+  int ret = av_image_fill_linesizes(linesizes, pix_fmt, frame->width);
+  if (ret < 0) {
+    return ret;
+  }
+
+  for (int i=0;i<4;i++) {
+    linesizes[i] = FFALIGN(linesizes[i], 32);
+  }
+
+  // get the size of all planes laid out one after another
+  uint8_t* data[4];
+  int size = av_image_fill_pointers(data, pix_fmt, frame->height, nullptr, linesizes);
+  if (size < 0) {
+    return size;
+  }
+
+  AVBufferRef* buf = GetBuffer(size);
+  if (buf == nullptr) {
+    return AVERROR(ENOMEM);
+  }
+
+  av_image_fill_pointers(frame->data, pix_fmt, frame->height, buf->data, linesizes);
+
+  for (int i=0;i<4;i++) {
+    frame->linesize[i] = linesizes[i];
+  }
+
+  frame->buf[0] = buf;
+  frame->extended_data = frame->data;
+
+  return 0;
+}
+
+void FramePool::SetMaxIdleBytes(int64_t bytes)
+{
+  QMutexLocker locker(&lock_);
+
+  max_idle_bytes_ = bytes;
+
+  TrimIdleBuffers();
+}
+
+int64_t FramePool::IdleBytes()
+{
+  QMutexLocker locker(&lock_);
+
+  return idle_bytes_;
+}
+
+double FramePool::HitRate()
+{
+  int64_t requests = buffer_requests_;
+
+  if (requests == 0) {
+    return 0.0;
+  }
+
+  return double(requests - buffer_allocations_) / double(requests);
+}
+
+int64_t FramePool::ResidentBytes()
+{
+  return resident_bytes_;
+}
+
+AVBufferRef *FramePool::GetBuffer(int size)
+{
+  uint8_t* data = nullptr;
+
+  lock_.lock();
+
+  BufferBucket* bucket = buckets_.value(size, nullptr);
+
+  if (bucket == nullptr) {
+    bucket = new BufferBucket();
+    bucket->frame_pool = this;
+    bucket->size = size;
+    bucket->in_use = 0;
+    buckets_.insert(size, bucket);
+  }
+
+  buffer_requests_++;
+
+  if (!bucket->idle.isEmpty()) {
+    data = bucket->idle.takeLast();
+    idle_bytes_ -= size;
+  }
+
+  bucket->in_use++;
+
+  lock_.unlock();
+
+  if (data == nullptr) {
+    data = static_cast<uint8_t*>(av_malloc(size));
+
+    if (data == nullptr) {
+      lock_.lock();
+      bucket->in_use--;
+      lock_.unlock();
+      return nullptr;
+    }
+
+    buffer_allocations_++;
+    resident_bytes_ += size;
+  }
+
+  AVBufferRef* buf = av_buffer_create(data, size, ReturnBuffer, bucket, 0);
+
+  if (buf == nullptr) {
+    ReturnBuffer(bucket, data);
+  }
+
+  return buf;
+}
+
+void FramePool::ReturnBuffer(void *opaque, uint8_t *data)
+{
+  BufferBucket* bucket = static_cast<BufferBucket*>(opaque);
+  FramePool* pool = bucket->frame_pool;
+
+  pool->lock_.lock();
+
+  bucket->in_use--;
+
+  // keep the buffer if there's room for it, or if its size is still in use and doesn't have a few spare buffers yet
+  if (pool->idle_bytes_ + bucket->size <= pool->max_idle_bytes_
+      || (bucket->in_use > 0 && bucket->idle.size() < kMinIdleBuffers)) {
+    bucket->idle.append(data);
+    pool->idle_bytes_ += bucket->size;
+    data = nullptr;
+  }
+
+  pool->lock_.unlock();
+
+  if (data != nullptr) {
+    pool->resident_bytes_ -= bucket->size;
+    av_free(data);
+  }
+}
+
+void FramePool::TrimIdleBuffers()
+{
+  // free buffers of sizes nothing is using anymore first, then any others down to kMinIdleBuffers
+  for (int pass=0;pass<2 && idle_bytes_ > max_idle_bytes_;pass++) {
+    QMap<int, BufferBucket*>::iterator i;
+
+    for (i=buckets_.begin();i!=buckets_.end() && idle_bytes_ > max_idle_bytes_;i++) {
+      BufferBucket* bucket = i.value();
+
+      if (pass == 0 && bucket->in_use > 0) {
+        continue;
+      }
+
+      int keep = (bucket->in_use > 0) ? kMinIdleBuffers : 0;
+
+      while (bucket->idle.size() > keep && idle_bytes_ > max_idle_bytes_) {
+        av_free(bucket->idle.takeLast());
+        idle_bytes_ -= bucket->size;
+        resident_bytes_ -= bucket->size;
+      }
+    }
+  }
+}
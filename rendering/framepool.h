@@ -0,0 +1,191 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef FRAMEPOOL_H
+#define FRAMEPOOL_H
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/buffer.h>
+}
+
+#include <QMap>
+#include <QVector>
+#include <QMutex>
+#include <atomic>
+
+/**
+ * @brief The FramePool class
+ *
+ * Decoded video frames are large (a 4K RGBA16 frame is ~66 MB) and every cacher allocates and frees them continuously
+ * during playback. FramePool is a process-wide recycler for frames and their buffers so that steady-state playback
+ * doesn't allocate:
+ *
+ * * Frame structs are handed out with Get() and given back with Release() instead of av_frame_alloc() and
+ *   av_frame_free(). ClipQueue releases frames here automatically.
+ * * Video decoders opened by DecoderPool allocate their frame buffers with GetVideoBuffer(), which takes them from a
+ *   shared set of idle buffers of each size. A decoder opened for a new file of the same format and resolution picks up
+ *   buffers freed by the last one rather than allocating its own set.
+ *
+ * Idle buffers are memory that isn't doing anything, so they're bounded by SetMaxIdleBytes() (FrameCache gives the pool
+ * whatever is left of Config::frame_cache_size). Beyond that, only a few buffers are kept for each size that's still in
+ * use so steady-state playback keeps recycling, and idle buffers of sizes nothing uses anymore are freed first.
+ *
+ * Buffers created by libavfilter (e.g. after conversion to RGBA) come from libavfilter's own per-graph pools, which
+ * DecoderPool keeps alive between clips along with the rest of the filter graph.
+ *
+ * All functions are thread-safe.
+ */
+class FramePool {
+public:
+  FramePool();
+
+  /**
+   * @brief FramePool Destructor
+   *
+   * Frees all idle frames and buffers.
+   */
+  ~FramePool();
+
+  /**
+   * @brief Get an empty frame
+   *
+   * Drop-in replacement for av_frame_alloc(). The frame should be given back with Release() (or via ClipQueue).
+   */
+  AVFrame* Get();
+
+  /**
+   * @brief Give back a frame retrieved with Get()
+   *
+   * Drop-in replacement for av_frame_free(). Any buffers referenced by the frame are unreferenced (returning them to
+   * their pools) and the frame itself is kept for the next call to Get(). Safe to call with `nullptr`.
+   */
+  void Release(AVFrame* frame);
+
+  /**
+   * @brief Free all idle frames and buffers
+   *
+   * Buffers still in use stay valid and are freed once they're unreferenced.
+   */
+  void Clear();
+
+  /**
+   * @brief AVCodecContext::get_buffer2 callback that allocates video frame buffers from the shared pools
+   *
+   * Falls back to avcodec_default_get_buffer2() for anything it can't lay out itself (hardware, palette formats, and
+   * decoders without direct rendering support).
+   */
+  static int GetVideoBuffer(AVCodecContext* s, AVFrame* frame, int flags);
+
+  /**
+   * @brief Allocate buffers for a video frame from the shared pools
+   *
+   * Drop-in replacement for av_frame_get_buffer() for frames that aren't produced by a decoder. The frame's format,
+   * width and height must be set. Line sizes are aligned to 32 bytes.
+   *
+   * @return
+   *
+   * FFmpeg error code (>= 0 on success, a negative error code on failure)
+   */
+  int GetFrameBuffer(AVFrame* frame);
+
+  /**
+   * @brief Set how many bytes of idle buffers may be kept for re-use
+   *
+   * Frees idle buffers straight away if there are more than this.
+   */
+  void SetMaxIdleBytes(int64_t bytes);
+
+  /**
+   * @brief Total size in bytes of the buffers waiting to be re-used
+   */
+  int64_t IdleBytes();
+
+  /**
+   * @brief Fraction (0.0 - 1.0) of buffer requests that were served with a recycled buffer
+   */
+  double HitRate();
+
+  /**
+   * @brief Total size in bytes of all buffers allocated by the pool (whether in use or idle)
+   */
+  int64_t ResidentBytes();
+
+private:
+  /**
+   * @brief Buffers of one size
+   *
+   * Passed to the free callback of every buffer of this size, so buckets live as long as the FramePool.
+   */
+  struct BufferBucket {
+    FramePool* frame_pool;
+    int size;
+
+    /**
+     * @brief Number of buffers of this size that are currently referenced by a frame
+     */
+    int in_use;
+
+    /**
+     * @brief Buffers of this size waiting to be re-used
+     */
+    QVector<uint8_t*> idle;
+  };
+
+  /**
+   * @brief Internal function to get a buffer of a certain size, re-using an idle one if there is one
+   */
+  AVBufferRef* GetBuffer(int size);
+
+  /**
+   * @brief Internal AVBuffer free callback that keeps the buffer for re-use or frees it
+   */
+  static void ReturnBuffer(void* opaque, uint8_t* data);
+
+  /**
+   * @brief Internal function to free idle buffers until they're within max_idle_bytes_ (lock_ must be locked)
+   */
+  void TrimIdleBuffers();
+
+  /**
+   * @brief Buffers keyed by buffer size
+   */
+  QMap<int, BufferBucket*> buckets_;
+
+  int64_t idle_bytes_;
+  int64_t max_idle_bytes_;
+
+  /**
+   * @brief Frames given back with Release() waiting to be re-used
+   */
+  QVector<AVFrame*> idle_frames_;
+
+  QMutex lock_;
+
+  std::atomic<int64_t> buffer_requests_;
+  std::atomic<int64_t> buffer_allocations_;
+  std::atomic<int64_t> resident_bytes_;
+};
+
+namespace olive {
+extern FramePool frame_pool;
+}
+
+#endif // FRAMEPOOL_H
@@ -0,0 +1,253 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "nestcache.h"
+
+#include "timeline/sequence.h"
+#include "timeline/clip.h"
+#include "project/media.h"
+#include "project/footage.h"
+#include "effects/transition.h"
+#include "nodes/oldeffectnode.h"
+#include "global/config.h"
+#include "global/timing.h"
+#include "rendering/compositecache.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/pixelformats.h"
+
+NestCache olive::nest_cache;
+
+/**
+ * @brief Returns whether a frame of a Sequence would look the same at any other frame with the same hash
+ *
+ * CompositeCache::GetHash() covers every field value of every clip at the frame, but not which frame of a video is
+ * shown, how far along a transition is or what an effect generates from the time on its own.
+ */
+bool IsStill(Sequence* s, long frame) {
+  QVector<Clip*> sequence_clips;
+  s->GetClipsInRange(olive::kTypeVideo, frame, frame + 1, &sequence_clips);
+
+  for (int i=0;i<sequence_clips.size();i++) {
+    Clip* c = sequence_clips.at(i);
+
+    if (!c->IsActiveAt(frame)) {
+      continue;
+    }
+
+    if (c->opening_transition != nullptr && frame < c->timeline_in(true) + c->opening_transition->get_length()) {
+      return false;
+    }
+
+    if (c->closing_transition != nullptr && frame >= c->timeline_out(true) - c->closing_transition->get_length()) {
+      return false;
+    }
+
+    for (int j=0;j<c->effects.size();j++) {
+      OldEffectNode* e = c->effects.at(j).get();
+
+      // shaders are given the time as a uniform
+      if (e->IsEnabled() && ((e->Flags() & OldEffectNode::ShaderFlag) || e->AlwaysUpdate())) {
+        return false;
+      }
+    }
+
+    if (c->media() != nullptr) {
+      if (c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+        FootageStream* ms = c->media_stream();
+
+        if (ms == nullptr || !ms->infinite_length) {
+          return false;
+        }
+      } else if (c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
+        Sequence* nested = c->media()->to_sequence().get();
+
+        // same conversion compose_sequence() makes for nested sequences
+        long nested_frame = rescale_frame_number(frame + c->clip_in(true) - c->timeline_in(true),
+                                                 s->frame_rate,
+                                                 nested->frame_rate);
+
+        if (!IsStill(nested, nested_frame)) {
+          return false;
+        }
+      }
+    }
+  }
+
+  return true;
+}
+
+NestCache::NestCache() :
+  use_counter_(0),
+  resident_bytes_(0)
+{}
+
+void NestCache::GetKey(Sequence *seq, long *frame, quint64 *hash)
+{
+  *hash = CompositeCache::GetHash(seq, *frame);
+
+  if (IsStill(seq, *frame)) {
+    *frame = kStillFrame;
+  }
+}
+
+FramebufferObject *NestCache::Get(Sequence *seq, long frame, quint64 hash, int width, int height)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  QMutexLocker locker(&lock_);
+
+  QHash<QOpenGLContext*, QMap<Key, Entry> >::iterator context_frames = frames_.find(ctx);
+
+  if (context_frames == frames_.end()) {
+    return nullptr;
+  }
+
+  Key key(seq, frame);
+
+  QMap<Key, Entry>::iterator i = context_frames.value().find(key);
+
+  if (i == context_frames.value().end()) {
+    return nullptr;
+  }
+
+  Entry& entry = i.value();
+
+  // anything in the nest may have changed since the frame was cached
+  if (entry.hash != hash) {
+    Remove(ctx, key);
+    return nullptr;
+  }
+
+  // may have been cached at another playback resolution or in a pixel format that's since been changed
+  if (entry.buffer->width() != width
+      || entry.buffer->height() != height
+      || entry.buffer->format() != FramebufferObject::CreationFormat()) {
+    return nullptr;
+  }
+
+  lru_.remove(entry.last_used);
+  entry.last_used = ++use_counter_;
+  lru_.insert(entry.last_used, QPair<QOpenGLContext*, Key>(ctx, key));
+
+  return entry.buffer;
+}
+
+bool NestCache::Add(Sequence *seq, long frame, quint64 hash, FramebufferObject *buffer)
+{
+  int64_t max_bytes = int64_t(olive::config.nested_cache_size) * 1048576;
+  int64_t buffer_bytes = BufferBytes(buffer);
+
+  if (buffer_bytes > max_bytes) {
+    return false;
+  }
+
+  QOpenGLContext* ctx = buffer->context();
+
+  QMutexLocker locker(&lock_);
+
+  Key key(seq, frame);
+
+  Remove(ctx, key);
+
+  // make room before adding the frame so it can never be the one that's freed (the caller is still drawing from it)
+  Trim(ctx, max_bytes - buffer_bytes);
+
+  // other contexts' frames may still be taking up the room we need
+  if (resident_bytes_ + buffer_bytes > max_bytes) {
+    return false;
+  }
+
+  Entry entry;
+  entry.buffer = buffer;
+  entry.hash = hash;
+  entry.last_used = ++use_counter_;
+
+  frames_[ctx].insert(key, entry);
+  lru_.insert(entry.last_used, QPair<QOpenGLContext*, Key>(ctx, key));
+  resident_bytes_ += buffer_bytes;
+
+  return true;
+}
+
+void NestCache::Clear(QOpenGLContext *ctx)
+{
+  QMutexLocker locker(&lock_);
+
+  QList<Key> keys = frames_.value(ctx).keys();
+
+  for (int i=0;i<keys.size();i++) {
+    Remove(ctx, keys.at(i));
+  }
+}
+
+int64_t NestCache::ResidentBytes()
+{
+  QMutexLocker locker(&lock_);
+
+  return resident_bytes_;
+}
+
+void NestCache::Trim(QOpenGLContext *ctx, int64_t max_bytes)
+{
+  QMap<quint64, QPair<QOpenGLContext*, Key> >::iterator i = lru_.begin();
+
+  while (i != lru_.end() && resident_bytes_ > max_bytes) {
+    QPair<QOpenGLContext*, Key> location = i.value();
+
+    // move past this entry now since Remove() erases it from lru_
+    ++i;
+
+    // other contexts' frames can only be freed in their own thread
+    if (location.first == ctx) {
+      Remove(location.first, location.second);
+    }
+  }
+}
+
+void NestCache::Remove(QOpenGLContext *ctx, const Key &key)
+{
+  QHash<QOpenGLContext*, QMap<Key, Entry> >::iterator context_frames = frames_.find(ctx);
+
+  if (context_frames == frames_.end()) {
+    return;
+  }
+
+  QMap<Key, Entry>::iterator i = context_frames.value().find(key);
+
+  if (i == context_frames.value().end()) {
+    return;
+  }
+
+  lru_.remove(i.value().last_used);
+  resident_bytes_ -= BufferBytes(i.value().buffer);
+  olive::framebuffer_pool.Release(i.value().buffer);
+  context_frames.value().erase(i);
+
+  if (context_frames.value().isEmpty()) {
+    frames_.erase(context_frames);
+  }
+}
+
+int64_t NestCache::BufferBytes(FramebufferObject *buffer)
+{
+  return int64_t(buffer->width())
+      * int64_t(buffer->height())
+      * olive::pixel_formats.at(buffer->format()).bytes_per_pixel;
+}
@@ -0,0 +1,167 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef NESTCACHE_H
+#define NESTCACHE_H
+
+#include <QMap>
+#include <QHash>
+#include <QMutex>
+#include <QPair>
+#include <QOpenGLContext>
+
+#include "rendering/framebufferobject.h"
+
+class Sequence;
+
+/**
+ * @brief The NestCache class
+ *
+ * compose_sequence() composes a nested Sequence from scratch into its clip's framebuffer every time the clip is drawn,
+ * even though nests used for titles or picture-in-picture often show the exact same frame for seconds at a time.
+ * NestCache keeps the composited frames of nested Sequences on the GPU so unchanged frames are drawn straight from the
+ * cache instead. Its total size is bounded by Config::nested_cache_size.
+ *
+ * Frames are keyed by Sequence and frame number, and each stores the frame's hash from CompositeCache::GetHash() so a
+ * frame is never returned after anything inside the nest has changed. Frames where nothing in the nest changes over
+ * time (e.g. titles and still images) are keyed by kStillFrame instead so every such frame shares one copy (see
+ * GetKey()).
+ *
+ * Framebuffers are checked out of olive::framebuffer_pool for as long as they're cached and only returned to the
+ * context they were created in. Functions other than GetKey() must be called with that context current.
+ *
+ * All functions are thread-safe.
+ */
+class NestCache {
+public:
+  /**
+   * @brief Frame number shared by every frame of a Sequence where nothing changes over time
+   */
+  static const long kStillFrame = -1;
+
+  NestCache();
+
+  /**
+   * @brief Identify a frame of a nested Sequence for Get() and Add()
+   *
+   * @param seq
+   *
+   * The nested Sequence
+   *
+   * @param frame
+   *
+   * The frame of the nested Sequence, which is set to kStillFrame if nothing in the Sequence changes over time at this
+   * frame (only still images and generated media without transitions, shaders or effects that always update)
+   *
+   * @param hash
+   *
+   * Set to the frame's hash
+   */
+  static void GetKey(Sequence* seq, long* frame, quint64* hash);
+
+  /**
+   * @brief Get a cached frame of a nested Sequence
+   *
+   * @return
+   *
+   * The framebuffer containing the frame (owned by the cache), or `nullptr` if no frame matching the key, hash and size
+   * is cached in the current context. A frame that no longer matches its hash is freed.
+   */
+  FramebufferObject* Get(Sequence* seq, long frame, quint64 hash, int width, int height);
+
+  /**
+   * @brief Add a composited frame of a nested Sequence to the cache
+   *
+   * Replaces any frame already cached at this key. May free the least recently used frames of the current context to
+   * stay within Config::nested_cache_size.
+   *
+   * @param buffer
+   *
+   * A framebuffer checked out of olive::framebuffer_pool containing the frame
+   *
+   * @return
+   *
+   * **TRUE** if the cache took ownership of `buffer`. If **FALSE** (the frame doesn't fit in the cache, even after
+   * freeing the current context's frames), the caller keeps ownership.
+   */
+  bool Add(Sequence* seq, long frame, quint64 hash, FramebufferObject* buffer);
+
+  /**
+   * @brief Free all cached frames belonging to a context
+   *
+   * Should be called before the context is destroyed (and before FramebufferPool::Clear()), with the context current.
+   */
+  void Clear(QOpenGLContext* ctx);
+
+  /**
+   * @brief Total size in bytes of all cached frames
+   */
+  int64_t ResidentBytes();
+
+private:
+  typedef QPair<Sequence*, long> Key;
+
+  struct Entry {
+    FramebufferObject* buffer;
+    quint64 hash;
+    quint64 last_used;
+  };
+
+  /**
+   * @brief Internal function to free the current context's least recently used frames until the cache is within
+   * `max_bytes`, lock_ must be locked
+   */
+  void Trim(QOpenGLContext* ctx, int64_t max_bytes);
+
+  /**
+   * @brief Internal function to free a frame and remove it from the cache, lock_ must be locked
+   */
+  void Remove(QOpenGLContext* ctx, const Key& key);
+
+  /**
+   * @brief Internal function to get the size of a framebuffer's texture in bytes
+   */
+  static int64_t BufferBytes(FramebufferObject* buffer);
+
+  /**
+   * @brief Cached frames of each context
+   */
+  QHash<QOpenGLContext*, QMap<Key, Entry> > frames_;
+
+  /**
+   * @brief Context and key of every cached frame, ordered from least to most recently used
+   */
+  QMap<quint64, QPair<QOpenGLContext*, Key> > lru_;
+
+  /**
+   * @brief Incremented every time an entry is used, for ordering entries from least to most recently used
+   */
+  quint64 use_counter_;
+
+  int64_t resident_bytes_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern NestCache nest_cache;
+}
+
+#endif // NESTCACHE_H
@@ -0,0 +1,109 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "ociocache.h"
+
+#include <QOpenGLFunctions>
+#include <QDebug>
+
+#include "rendering/shadergenerators.h"
+
+OCIOCache olive::ocio_cache;
+
+OCIOCache::OCIOCache() {}
+
+QOpenGLShaderProgramPtr OCIOCache::GetInputTransform(const QString &colorspace,
+                                                     bool alpha_is_associated,
+                                                     GLuint *lut_texture)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    qWarning() << "No current context to create an OCIO transform for";
+    return nullptr;
+  }
+
+  Transform transform;
+
+  try {
+
+    OCIO::ConstConfigRcPtr config = OCIO::GetCurrentConfig();
+
+    QString key = QString("%1:%2:%3").arg(config->getCacheID(), colorspace, QString::number(alpha_is_associated));
+
+    {
+      QMutexLocker locker(&lock_);
+
+      if (!transforms_.contains(ctx)) {
+        // contexts are destroyed in the thread they belong to, so free their transforms right there with them
+        connect(ctx, SIGNAL(aboutToBeDestroyed()), this, SLOT(ContextDestroyed()), Qt::DirectConnection);
+
+        transforms_.insert(ctx, QHash<QString, Transform>());
+      }
+
+      QHash<QString, Transform>::const_iterator cached = transforms_.value(ctx).constFind(key);
+
+      if (cached != transforms_.value(ctx).constEnd()) {
+        *lut_texture = cached.value().lut_texture;
+        return cached.value().shader;
+      }
+    }
+
+    // bake the LUT and link the shader without the lock held, a context is only used by one thread at a time so
+    // nothing else can be creating this transform for it
+    transform.processor = config->getProcessor(colorspace.toUtf8(), OCIO::ROLE_SCENE_LINEAR);
+
+    transform.shader = olive::shader::SetupOCIO(ctx,
+                                                transform.lut_texture,
+                                                transform.processor,
+                                                alpha_is_associated);
+
+    QMutexLocker locker(&lock_);
+
+    transforms_[ctx].insert(key, transform);
+
+  } catch (OCIO::Exception& e) {
+    qWarning() << e.what();
+    return nullptr;
+  }
+
+  *lut_texture = transform.lut_texture;
+
+  return transform.shader;
+}
+
+void OCIOCache::ContextDestroyed()
+{
+  QOpenGLContext* ctx = static_cast<QOpenGLContext*>(sender());
+
+  QMutexLocker locker(&lock_);
+
+  // LUT textures can only be deleted with the context current, otherwise they're freed along with the share group
+  if (QOpenGLContext::currentContext() == ctx) {
+    QHash<QString, Transform>::const_iterator i;
+    const QHash<QString, Transform>& context_transforms = transforms_.value(ctx);
+
+    for (i=context_transforms.constBegin();i!=context_transforms.constEnd();i++) {
+      ctx->functions()->glDeleteTextures(1, &i.value().lut_texture);
+    }
+  }
+
+  transforms_.remove(ctx);
+}
@@ -0,0 +1,99 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef OCIOCACHE_H
+#define OCIOCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <OpenColorIO/OpenColorIO.h>
+namespace OCIO = OCIO_NAMESPACE::v1;
+
+#include "rendering/qopenglshaderprogramptr.h"
+
+/**
+ * @brief The OCIOCache class
+ *
+ * With color management enabled, every footage clip is converted from its colorspace to the scene linear colorspace
+ * with an OCIO processor baked into a 3D LUT texture and a shader. Clips used to each create (and leak) their own,
+ * even though most clips in a project share the same few colorspaces. OCIOCache creates the processor, LUT and shader
+ * for each colorspace once per OpenGL context and shares them with every clip of every sequence that needs them,
+ * until the context is destroyed.
+ *
+ * Transforms are keyed by the OCIO configuration's cache ID along with the colorspace and alpha association, so
+ * changing the configuration never returns a transform from the old one.
+ *
+ * All functions are thread-safe.
+ */
+class OCIOCache : public QObject {
+  Q_OBJECT
+public:
+  OCIOCache();
+
+  /**
+   * @brief Get the transform from a colorspace to scene linear for the current context
+   *
+   * @param colorspace
+   *
+   * The colorspace to convert from
+   *
+   * @param alpha_is_associated
+   *
+   * Whether the footage's alpha is associated (see SetupOCIO())
+   *
+   * @param lut_texture
+   *
+   * Set to the LUT texture to use with the shader (see OCIOBlit()). Owned by the cache.
+   *
+   * @return
+   *
+   * The shader (owned by the cache), or `nullptr` if the current OCIO configuration couldn't create a processor for
+   * this colorspace.
+   */
+  QOpenGLShaderProgramPtr GetInputTransform(const QString& colorspace, bool alpha_is_associated, GLuint* lut_texture);
+
+private slots:
+  /**
+   * @brief Free the transforms of a context that's about to be destroyed (the context is the sender())
+   */
+  void ContextDestroyed();
+
+private:
+  struct Transform {
+    OCIO::ConstProcessorRcPtr processor;
+    QOpenGLShaderProgramPtr shader;
+    GLuint lut_texture;
+  };
+
+  /**
+   * @brief Transforms of each context keyed by configuration, colorspace and alpha association
+   */
+  QHash<QOpenGLContext*, QHash<QString, Transform> > transforms_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern OCIOCache ocio_cache;
+}
+
+#endif // OCIOCACHE_H
@@ -0,0 +1,280 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "pixeluploadring.h"
+
+#include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
+
+#include "global/debug.h"
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+// glBufferStorage() isn't part of QOpenGLExtraFunctions, so it's resolved from the context in Create()
+typedef void (QOPENGLF_APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+// coherent so frames the cacher copies in are visible to the GPU without flushing them from the render thread
+const GLbitfield kMapFlags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+// one slot being uploaded from, one the cacher is copying the next frame into, and one spare while the GPU catches up
+const int kUploadRingSlots = 3;
+
+PixelUploadRing::PixelUploadRing() :
+  ctx_(nullptr),
+  buffer_(0),
+  mapped_(nullptr),
+  slot_size_(0),
+  acquired_slot_(-1)
+{}
+
+bool PixelUploadRing::Create(QOpenGLContext *ctx, int slot_size)
+{
+  Destroy();
+
+  if (ctx->format().version() < qMakePair(4, 4) && !ctx->hasExtension(QByteArrayLiteral("GL_ARB_buffer_storage"))) {
+    return false;
+  }
+
+  BufferStorageProc buffer_storage = reinterpret_cast<BufferStorageProc>(ctx->getProcAddress("glBufferStorage"));
+  if (buffer_storage == nullptr) {
+    return false;
+  }
+
+  QOpenGLFunctions* f = ctx->functions();
+
+  GLsizeiptr size = GLsizeiptr(slot_size) * kUploadRingSlots;
+
+  GLuint buffer;
+  f->glGenBuffers(1, &buffer);
+  f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer);
+  buffer_storage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, kMapFlags);
+  void* mapped = ctx->extraFunctions()->glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, kMapFlags);
+  f->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  if (mapped == nullptr) {
+    qWarning() << "Failed to map pixel upload buffer, uploading frames from client memory";
+    f->glDeleteBuffers(1, &buffer);
+    return false;
+  }
+
+  Slot free_slot;
+  free_slot.state = kSlotFree;
+  free_slot.pts = AV_NOPTS_VALUE;
+  free_slot.linesize = 0;
+  free_slot.fence = nullptr;
+
+  lock_.lock();
+
+  ctx_ = ctx;
+  buffer_ = buffer;
+  mapped_ = static_cast<uchar*>(mapped);
+  slot_size_ = slot_size;
+  slots_.fill(free_slot, kUploadRingSlots);
+  acquired_slot_ = -1;
+
+  lock_.unlock();
+
+  return true;
+}
+
+void PixelUploadRing::Destroy()
+{
+  lock_.lock();
+
+  // the cacher may be copying into a slot right now, wait for it so the memory isn't unmapped under it
+  bool writing;
+  do {
+    writing = false;
+    for (int i=0;i<slots_.size();i++) {
+      if (slots_.at(i).state == kSlotWriting) {
+        writing = true;
+        write_finished_.wait(&lock_);
+        break;
+      }
+    }
+  } while (writing);
+
+  if (mapped_ == nullptr) {
+    lock_.unlock();
+    return;
+  }
+
+  mapped_ = nullptr;
+
+  QVector<Slot> slots = slots_;
+  slots_.clear();
+  acquired_slot_ = -1;
+
+  lock_.unlock();
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  for (int i=0;i<slots.size();i++) {
+    if (slots.at(i).fence != nullptr) {
+      xf->glDeleteSync(slots.at(i).fence);
+    }
+  }
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+  xf->glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  xf->glDeleteBuffers(1, &buffer_);
+
+  buffer_ = 0;
+  ctx_ = nullptr;
+}
+
+bool PixelUploadRing::IsCreated()
+{
+  QMutexLocker locker(&lock_);
+  return (mapped_ != nullptr);
+}
+
+bool PixelUploadRing::Stage(int64_t pts, const AVFrame *frame, int height, int64_t stale_pts)
+{
+  int size = frame->linesize[0] * height;
+
+  lock_.lock();
+
+  if (mapped_ == nullptr || size > slot_size_) {
+    lock_.unlock();
+    return false;
+  }
+
+  int slot = -1;
+
+  for (int i=0;i<slots_.size();i++) {
+    const Slot& s = slots_.at(i);
+
+    if (s.pts == pts && (s.state == kSlotWriting || s.state == kSlotStaged || s.state == kSlotUploading)) {
+      // this frame is already in the ring
+      lock_.unlock();
+      return true;
+    }
+
+    if (slot == -1 && (s.state == kSlotFree || (s.state == kSlotStaged && s.pts < stale_pts))) {
+      slot = i;
+    }
+  }
+
+  if (slot == -1) {
+    lock_.unlock();
+    return false;
+  }
+
+  slots_[slot].state = kSlotWriting;
+  slots_[slot].pts = pts;
+  slots_[slot].linesize = frame->linesize[0];
+
+  uchar* dest = mapped_ + slot * slot_size_;
+
+  // copy outside the lock so the render thread can keep uploading from the other slots meanwhile
+  lock_.unlock();
+
+  memcpy(dest, frame->data[0], size_t(size));
+
+  lock_.lock();
+  slots_[slot].state = kSlotStaged;
+  write_finished_.wakeAll();
+  lock_.unlock();
+
+  return true;
+}
+
+bool PixelUploadRing::Acquire(int64_t pts, const void **pixels, int *linesize)
+{
+  lock_.lock();
+
+  if (mapped_ == nullptr) {
+    lock_.unlock();
+    return false;
+  }
+
+  ReclaimSlots();
+
+  for (int i=0;i<slots_.size();i++) {
+    Slot& s = slots_[i];
+
+    if (s.state == kSlotStaged && s.pts == pts) {
+      s.state = kSlotUploading;
+      acquired_slot_ = i;
+
+      // with a pixel unpack buffer bound, the pixel data passed to glTexSubImage2D() is an offset into it
+      *pixels = reinterpret_cast<const void*>(qintptr(i) * slot_size_);
+      *linesize = s.linesize;
+
+      lock_.unlock();
+
+      ctx_->functions()->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer_);
+
+      return true;
+    }
+  }
+
+  lock_.unlock();
+
+  return false;
+}
+
+void PixelUploadRing::Release()
+{
+  if (acquired_slot_ == -1) {
+    return;
+  }
+
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  // the slot can't be written to again until the GPU has finished transferring it into the texture
+  GLsync fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  xf->glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  lock_.lock();
+  slots_[acquired_slot_].state = kSlotInFlight;
+  slots_[acquired_slot_].fence = fence;
+  acquired_slot_ = -1;
+  lock_.unlock();
+}
+
+void PixelUploadRing::ReclaimSlots()
+{
+  QOpenGLExtraFunctions* xf = ctx_->extraFunctions();
+
+  for (int i=0;i<slots_.size();i++) {
+    Slot& s = slots_[i];
+
+    if (s.state == kSlotInFlight) {
+      GLenum result = xf->glClientWaitSync(s.fence, 0, 0);
+
+      if (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED) {
+        xf->glDeleteSync(s.fence);
+        s.fence = nullptr;
+        s.state = kSlotFree;
+        s.pts = AV_NOPTS_VALUE;
+      }
+    }
+  }
+}
@@ -0,0 +1,185 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef PIXELUPLOADRING_H
+#define PIXELUPLOADRING_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QOpenGLContext>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+
+/**
+ * @brief The PixelUploadRing class
+ *
+ * A ring of slots in one persistently mapped OpenGL pixel buffer object (PBO) for streaming a clip's frames into its
+ * texture.
+ *
+ * Uploading a texture straight from client memory makes the render thread wait while the driver copies the whole frame.
+ * Instead, the clip's Cacher copies upcoming frames into free slots of the mapped buffer on its own thread (see Stage())
+ * so by the time the render thread needs a frame, it only has to tell the GPU to transfer it from the buffer into the
+ * texture (see Acquire()). The buffer is mapped once when it's created so the Cacher never needs an OpenGL context of
+ * its own. After each transfer, the slot is fenced and only given back to the Cacher once the GPU has finished reading
+ * it.
+ *
+ * Persistent mapping needs OpenGL 4.4 or GL_ARB_buffer_storage. Without them Create() fails and frames are uploaded
+ * from client memory as usual.
+ *
+ * Create(), Destroy(), Acquire() and Release() must be called from the render thread with the same context current.
+ * Stage() is called from the Cacher thread. All functions are thread-safe.
+ */
+class PixelUploadRing {
+public:
+  PixelUploadRing();
+
+  /**
+   * @brief Create and map the buffer
+   *
+   * @param ctx
+   *
+   * Context to create the buffer in
+   *
+   * @param slot_size
+   *
+   * Size in bytes of the largest frame a slot needs to hold
+   *
+   * @return
+   *
+   * **TRUE** if the buffer was created, **FALSE** if persistent mapping isn't supported by this context
+   */
+  bool Create(QOpenGLContext* ctx, int slot_size);
+
+  /**
+   * @brief Unmap and free the buffer
+   *
+   * Waits for any Stage() in progress to finish first. Stage() does nothing after this until Create() is called again.
+   */
+  void Destroy();
+
+  bool IsCreated();
+
+  /**
+   * @brief Copy a frame into a free slot
+   *
+   * Called from the Cacher thread for frames that are about to be shown.
+   *
+   * @param pts
+   *
+   * Timestamp the frame will be looked up with in Acquire()
+   *
+   * @param frame
+   *
+   * A packed RGB frame
+   *
+   * @param height
+   *
+   * Height of the frame in pixels
+   *
+   * @param stale_pts
+   *
+   * Slots holding frames with a timestamp earlier than this will never be acquired and may be overwritten
+   *
+   * @return
+   *
+   * **TRUE** if the frame is staged (or already was), **FALSE** if there was no free slot or the buffer isn't created
+   */
+  bool Stage(int64_t pts, const AVFrame* frame, int height, int64_t stale_pts);
+
+  /**
+   * @brief Bind the slot holding a frame as the pixel unpack buffer
+   *
+   * Also frees any slots the GPU has finished reading from since the last call.
+   *
+   * @param pts
+   *
+   * Timestamp of the frame
+   *
+   * @param pixels
+   *
+   * If the frame is staged, set to the value to pass to glTexSubImage2D() as the pixel data
+   *
+   * @param linesize
+   *
+   * If the frame is staged, set to the linesize of the staged frame
+   *
+   * @return
+   *
+   * **TRUE** if the frame is staged and its slot is bound. Release() must be called after uploading from it.
+   * **FALSE** if the frame isn't staged and must be uploaded from client memory.
+   */
+  bool Acquire(int64_t pts, const void** pixels, int* linesize);
+
+  /**
+   * @brief Fence the slot bound by Acquire() and unbind the pixel unpack buffer
+   */
+  void Release();
+
+private:
+  enum SlotState {
+    kSlotFree,
+    kSlotWriting,
+    kSlotStaged,
+    kSlotUploading,
+    kSlotInFlight
+  };
+
+  struct Slot {
+    SlotState state;
+    int64_t pts;
+    int linesize;
+    GLsync fence;
+  };
+
+  /**
+   * @brief Internal function to free slots whose fences have been signalled, lock_ must be locked
+   */
+  void ReclaimSlots();
+
+  QOpenGLContext* ctx_;
+
+  GLuint buffer_;
+
+  /**
+   * @brief Persistent mapping of buffer_, or `nullptr` if the buffer isn't created
+   */
+  uchar* mapped_;
+
+  int slot_size_;
+
+  QVector<Slot> slots_;
+
+  /**
+   * @brief Index of the slot bound by Acquire(), or -1 if none is
+   */
+  int acquired_slot_;
+
+  QMutex lock_;
+
+  /**
+   * @brief Woken whenever a Stage() finishes copying, so Destroy() can wait for it
+   */
+  QWaitCondition write_finished_;
+};
+
+#endif // PIXELUPLOADRING_H
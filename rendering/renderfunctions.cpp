@@ -42,6 +42,9 @@ extern "C" {
 #include "global/math.h"
 #include "global/timing.h"
 #include "global/config.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/ociocache.h"
+#include "rendering/nestcache.h"
 #include "panels/timeline.h"
 #include "qopenglshaderprogramptr.h"
 #include "shadergenerators.h"
@@ -196,7 +199,7 @@ void process_effect(QOpenGLContext* ctx,
       if (can_process_shaders && e->is_shader_linked()) {
         for (int i=0;i<e->getIterations();i++) {
           e->process_shader(timecode, coords, i);
-          composite_texture = draw_clip(ctx, e->GetShaderPipeline(), c->fbo.at(fbo_switcher), composite_texture, true);
+          composite_texture = draw_clip(ctx, e->GetShaderPipeline(), *c->fbo.at(fbo_switcher), composite_texture, true);
           fbo_switcher = !fbo_switcher;
         }
       }
@@ -214,22 +217,89 @@ void process_effect(QOpenGLContext* ctx,
         } else {
           // if the source texture is not already a framebuffer texture,
           // we'll need to make it one before drawing a superimpose effect on it
-          if (composite_texture != c->fbo.at(0).texture() && composite_texture != c->fbo.at(1).texture()) {
-            draw_clip(ctx, pipeline, c->fbo.at(!fbo_switcher), composite_texture, true);
+          if (composite_texture != c->fbo.at(0)->texture() && composite_texture != c->fbo.at(1)->texture()) {
+            draw_clip(ctx, pipeline, *c->fbo.at(!fbo_switcher), composite_texture, true);
           }
 
-          composite_texture = draw_clip(ctx, pipeline, c->fbo.at(!fbo_switcher), superimpose_texture, false);
+          composite_texture = draw_clip(ctx, pipeline, *c->fbo.at(!fbo_switcher), superimpose_texture, false);
         }
       }
     }
   }
 }
 
+bool clip_is_upcoming(Clip* c, long playhead, int playback_speed) {
+  // look further ahead the faster we're playing
+  long window = olive::config.lookahead_frames * qMax(1, qAbs(playback_speed));
+
+  if (window <= 0) {
+    return false;
+  }
+
+  // the first frame of the clip the playhead will reach in this direction
+  long first_frame;
+
+  if (playback_speed < 0) {
+    first_frame = c->timeline_out(true) - 1;
+
+    if (first_frame >= playhead || first_frame < playhead - window) {
+      return false;
+    }
+  } else {
+    first_frame = c->timeline_in(true);
+
+    if (first_frame <= playhead || first_frame > playhead + window) {
+      return false;
+    }
+  }
+
+  return c->IsActiveAt(first_frame);
+}
+
+bool olive::rendering::frame_is_queued(Sequence *seq, long playhead)
+{
+  QVector<Clip*> clips;
+  seq->GetClipsInRange(olive::kTypeVideo, playhead, playhead + 1, &clips);
+
+  for (int i=0;i<clips.size();i++) {
+    Clip* c = clips.at(i);
+
+    if (c == nullptr
+        || c->type() != olive::kTypeVideo
+        || c->media() == nullptr
+        || !c->IsActiveAt(playhead)) {
+      continue;
+    }
+
+    if (c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
+
+      // same conversion compose_sequence() makes for nested sequences
+      Sequence* nested = c->media()->to_sequence().get();
+      long nest_frame = rescale_frame_number(playhead + c->clip_in(true) - c->timeline_in(true),
+                                             seq->frame_rate,
+                                             nested->frame_rate);
+
+      if (!frame_is_queued(nested, nest_frame)) {
+        return false;
+      }
+
+    } else if (c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+
+      if (!c->IsFrameQueued(qMax(playhead, c->timeline_in(true)))) {
+        return false;
+      }
+
+    }
+  }
+
+  return true;
+}
+
 GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
   GLuint final_fbo = params.type == olive::kTypeVideo ? params.main_buffer->buffer() : 0;
 
   Sequence* s = params.seq;
-  long playhead = s->playhead;
+  long playhead = params.playhead;
 
   if (!params.nests.isEmpty()) {
 
@@ -240,9 +310,9 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
     }
 
     if (params.type == olive::kTypeVideo && !params.nests.last()->fbo.isEmpty()) {
-      params.nests.last()->fbo.at(0).BindBuffer();
+      params.nests.last()->fbo.at(0)->BindBuffer();
       params.ctx->functions()->glClear(GL_COLOR_BUFFER_BIT);
-      final_fbo = params.nests.last()->fbo.at(0).buffer();
+      final_fbo = params.nests.last()->fbo.at(0)->buffer();
     }
 
   }
@@ -251,8 +321,21 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
   QVector<Clip*> current_clips;
 
+  // only clips around the playhead can be active or upcoming (see clip_is_upcoming())
+  long window = qMax(0, olive::config.lookahead_frames) * qMax(1, qAbs(params.playback_speed));
+
+  QVector<Clip*> sequence_clips;
+  QVector<Clip*> left_clips;
+  s->GetClipsInRange(params.type, playhead - window, playhead + window + 1, &sequence_clips, &left_clips);
+
+  // close any clips that are no longer around the playhead
+  for (int i=0;i<left_clips.size();i++) {
+    if (left_clips.at(i)->IsOpen()) {
+      left_clips.at(i)->Close(false);
+    }
+  }
+
   // loop through clips, find currently active, and sort by track
-  QVector<Clip*> sequence_clips = s->GetAllClips();
   for (int i=0;i<sequence_clips.size();i++) {
 
     Clip* c = sequence_clips.at(i);
@@ -288,6 +371,17 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
                 // increment audio track count
                 if (c->type() == olive::kTypeAudio) audio_track_count++;
 
+              } else if (ms != nullptr && clip_is_upcoming(c, playhead, params.playback_speed)) {
+
+                // the clip is about to be reached, open it ahead of time so it's ready when it is
+                if (!c->IsOpen()) {
+                  c->Open();
+                } else if (c->state_change_lock.tryLock()) {
+                  // the clip has finished opening, start decoding its first frame
+                  c->Preroll(playhead, params.nests, params.playback_speed);
+                  c->state_change_lock.unlock();
+                }
+
               } else if (c->IsOpen()) {
 
                 // close the clip if it isn't active anymore
@@ -343,6 +437,10 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
   QMatrix4x4 projection;
 
+  // size of this sequence's buffers, which are reduced for reduced resolution playback
+  int sequence_buffer_width = qMax(1, s->width / params.resolution_divider);
+  int sequence_buffer_height = qMax(1, s->height / params.resolution_divider);
+
   if (params.type == olive::kTypeVideo) {
     // set default coordinates based on the sequence, with 0 in the direct center
 
@@ -379,16 +477,16 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
         int video_width = c->media_width();
         int video_height = c->media_height();
 
-        // prepare framebuffers for backend drawing operations
-        if (c->fbo.isEmpty()) {
-          // create 3 fbos for nested sequences, 2 for most clips
-          int fbo_count = (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) ? 3 : 2;
+        // size of the clip's framebuffers, reduced along with the sequence's
+        int buffer_width = qMax(1, video_width / params.resolution_divider);
+        int buffer_height = qMax(1, video_height / params.resolution_divider);
 
-          c->fbo.resize(fbo_count);
+        // check out framebuffers for backend drawing operations until the clip has been drawn onto the sequence
+        // 3 fbos for nested sequences, 2 for most clips
+        int fbo_count = (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) ? 3 : 2;
 
-          for (int j=0;j<fbo_count;j++) {
-            c->fbo[j].Create(params.ctx, video_width, video_height);
-          }
+        for (int j=0;j<fbo_count;j++) {
+          c->fbo.append(olive::framebuffer_pool.Acquire(params.ctx, buffer_width, buffer_height));
         }
 
         bool convert_frame_to_internal = false;
@@ -397,12 +495,21 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
         if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
 
           // retrieve video frame from cache and store it in c->texture
-          c->Cache(qMax(playhead, c->timeline_in(true)), false, params.nests, params.playback_speed);
-          if (!c->Retrieve()) {
+          c->Cache(qMax(playhead, c->timeline_in(true)), params.scrubbing, params.nests, params.playback_speed);
+
+          bool approximate_frame = false;
+
+          if (!c->Retrieve(&approximate_frame)) {
             params.texture_failed = true;
           } else {
             // retrieve ID from c->texture
             textureID = c->texture;
+
+            // while scrubbing, the cacher may have given us a nearby keyframe to show until it has decoded the exact
+            // frame, so render again until it has
+            if (approximate_frame) {
+              params.texture_failed = true;
+            }
           }
 
           if (textureID == 0) {
@@ -423,21 +530,61 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
           // simple bool for switching between the two framebuffers
           bool fbo_switcher = false;
 
-          params.ctx->functions()->glViewport(0, 0, video_width, video_height);
+          params.ctx->functions()->glViewport(0, 0, buffer_width, buffer_height);
 
           if (c->media() != nullptr) {
             if (c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
 
-              // for a nested sequence, run this function again on that sequence and retrieve the texture
+              // for a nested sequence, run this function again on that sequence and retrieve the texture, unless
+              // the same frame of it is already in the nest cache
+              Sequence* nested = c->media()->to_sequence().get();
+
+              // same conversion compose_sequence() makes for nested sequences
+              long nest_frame = rescale_frame_number(playhead + c->clip_in(true) - c->timeline_in(true),
+                                                     s->frame_rate,
+                                                     nested->frame_rate);
+              quint64 nest_hash = 0;
+
+              // gizmos inside the nest are positioned while composing it, so it's always composed while they're shown
+              bool use_nest_cache = (params.gizmos == nullptr);
+
+              FramebufferObject* cached_nest = nullptr;
+
+              if (use_nest_cache) {
+                NestCache::GetKey(nested, &nest_frame, &nest_hash);
+
+                cached_nest = olive::nest_cache.Get(nested, nest_frame, nest_hash, buffer_width, buffer_height);
+              }
+
+              if (cached_nest != nullptr) {
+
+                textureID = cached_nest->texture();
+
+              } else {
+
+                // track whether the nest itself composed completely so incomplete frames aren't cached
+                bool texture_failed = params.texture_failed;
+                params.texture_failed = false;
 
-              // add nested sequence to nest list
-              params.nests.append(c);
+                // add nested sequence to nest list
+                params.nests.append(c);
 
-              // compose sequence
-              textureID = compose_sequence(params);
+                // compose sequence
+                textureID = compose_sequence(params);
 
-              // remove sequence from nest list
-              params.nests.removeLast();
+                // remove sequence from nest list
+                params.nests.removeLast();
+
+                if (use_nest_cache
+                    && !params.texture_failed
+                    && olive::nest_cache.Add(nested, nest_frame, nest_hash, c->fbo.at(0))) {
+                  // the cache owns the composed frame now, so check out another framebuffer for this clip
+                  c->fbo[0] = olive::framebuffer_pool.Acquire(params.ctx, buffer_width, buffer_height);
+                }
+
+                params.texture_failed |= texture_failed;
+
+              }
 
               // compose_sequence() would have written to this clip's fbo[0], so we switch to fbo[1]
               fbo_switcher = !fbo_switcher;
@@ -449,42 +596,31 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
               {
 
                 // Convert texture to sequence's internal format
-                if (textureID != c->fbo.at(0).texture() && textureID != c->fbo.at(1).texture()) {
-                  textureID = draw_clip(params.ctx, params.pipeline, c->fbo.at(fbo_switcher), textureID, true);
+                if (textureID != c->fbo.at(0)->texture() && textureID != c->fbo.at(1)->texture()) {
+                  textureID = draw_clip(params.ctx, params.pipeline, *c->fbo.at(fbo_switcher), textureID, true);
                   fbo_switcher = !fbo_switcher;
                 }
 
-                // Check if this clip has an OCIO shader set up or not
-                if (c->ocio_shader == nullptr) {
-
-
-                  // Set default input colorspace
-                  QString input_cs = OCIO::ROLE_SCENE_LINEAR;
-
-                  if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
-                    input_cs = c->media()->to_footage()->Colorspace();
-                  }
+                // Set default input colorspace
+                QString input_cs = OCIO::ROLE_SCENE_LINEAR;
+                bool alpha_is_associated = false;
 
-                  // Try to get a shader based on the input color space to scene linear
-                  try {
-                    OCIO::ConstConfigRcPtr config = OCIO::GetCurrentConfig();
-                    OCIO::ConstProcessorRcPtr processor = config->getProcessor(input_cs.toUtf8(),
-                                                                               OCIO::ROLE_SCENE_LINEAR);
-
-                    c->ocio_shader = olive::shader::SetupOCIO(params.ctx,
-                                                              c->ocio_lut_texture,
-                                                              processor,
-                                                              c->media()->to_footage()->alpha_is_associated);
-                  } catch (OCIO::Exception& e) {
-                    qWarning() << e.what();
-                  }
+                if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_FOOTAGE) {
+                  input_cs = c->media()->to_footage()->Colorspace();
+                  alpha_is_associated = c->media()->to_footage()->alpha_is_associated;
                 }
 
+                // Get the shared shader from the input color space to scene linear for this context (looked up every
+                // frame since the clip may be composed in more than one context, or after the OCIO config changed)
+                c->ocio_shader = olive::ocio_cache.GetInputTransform(input_cs,
+                                                                     alpha_is_associated,
+                                                                     &c->ocio_lut_texture);
+
                 // Ensure we got a shader, and if so, blit with it
                 if (c->ocio_shader != nullptr) {
                   textureID = olive::rendering::OCIOBlit(c->ocio_shader.get(),
                                                          c->ocio_lut_texture,
-                                                         c->fbo.at(fbo_switcher),
+                                                         *c->fbo.at(fbo_switcher),
                                                          textureID);
 
                   fbo_switcher = !fbo_switcher;
@@ -563,7 +699,7 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
           if (textureID > 0) {
 
             // set viewport to sequence size
-            params.ctx->functions()->glViewport(0, 0, s->width, s->height);
+            params.ctx->functions()->glViewport(0, 0, sequence_buffer_width, sequence_buffer_height);
 
 
 
@@ -578,11 +714,11 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
             GLuint backend_tex_2;
             GLuint comp_texture;
             if (params.nests.size() > 0) {
-              back_buffer_1 = params.nests.last()->fbo[1].buffer();
-              back_buffer_2 = params.nests.last()->fbo[2].buffer();
-              backend_tex_1 = params.nests.last()->fbo[1].texture();
-              backend_tex_2 = params.nests.last()->fbo[2].texture();
-              comp_texture = params.nests.last()->fbo[0].texture();
+              back_buffer_1 = params.nests.last()->fbo.at(1)->buffer();
+              back_buffer_2 = params.nests.last()->fbo.at(2)->buffer();
+              backend_tex_1 = params.nests.last()->fbo.at(1)->texture();
+              backend_tex_2 = params.nests.last()->fbo.at(2)->texture();
+              comp_texture = params.nests.last()->fbo.at(0)->texture();
             } else {
               back_buffer_1 = params.backend_buffer1->buffer();
               back_buffer_2 = params.backend_buffer2->buffer();
@@ -755,6 +891,12 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
             // == END FINAL DRAW ON SEQUENCE BUFFER ==
           }
         }
+
+        // give the framebuffers back for the next clip
+        for (int j=0;j<c->fbo.size();j++) {
+          olive::framebuffer_pool.Release(c->fbo.at(j));
+        }
+        c->fbo.clear();
       } else if (c->type() == olive::kTypeAudio) {
         if (c->media() != nullptr && c->media()->get_type() == MEDIA_TYPE_SEQUENCE) {
           params.nests.append(c);
@@ -799,7 +941,7 @@ GLuint olive::rendering::compose_sequence(ComposeSequenceParams &params) {
 
   if (!params.nests.isEmpty() && !params.nests.last()->fbo.isEmpty()) {
     // returns nested clip's texture
-    return params.nests.last()->fbo[0].texture();
+    return params.nests.last()->fbo.at(0)->texture();
   }
 
   return 0;
@@ -810,10 +952,13 @@ void olive::rendering::compose_audio(Viewer* viewer, Sequence* seq, int playback
   params.viewer = viewer;
   params.ctx = nullptr;
   params.seq = seq;
+  params.playhead = seq->playhead;
   params.type = olive::kTypeAudio;
   params.gizmos = nullptr;
   params.wait_for_mutexes = wait_for_mutexes;
   params.playback_speed = playback_speed;
+  params.scrubbing = false;
+  params.resolution_divider = 1;
   compose_sequence(params);
 }
 
@@ -63,12 +63,17 @@ struct ComposeSequenceParams {
 
     /**
      * @brief The sequence to compose
-     *
-     * In addition to clips, sequences also contain the playhead position so compose_sequence() knows which frame
-     * to render.
      */
     Sequence* seq;
 
+    /**
+     * @brief The frame of the sequence to compose
+     *
+     * Usually the sequence's playhead, but frames can be composed anywhere in the sequence (e.g. when rendering ahead
+     * into the CompositeCache) without moving it.
+     */
+    long playhead;
+
     /**
      * @brief Array to store the nested sequence hierarchy
      *
@@ -138,6 +143,23 @@ struct ComposeSequenceParams {
      */
     int playback_speed;
 
+    /**
+     * @brief Whether the user is dragging the playhead around
+     *
+     * Used only for video rendering. While scrubbing, clips may show the keyframe before the requested frame until
+     * they've decoded the exact frame (see Cacher::Cache()).
+     */
+    bool scrubbing;
+
+    /**
+     * @brief Amount to divide the resolution of the render by (1 for full resolution)
+     *
+     * Used only for video rendering. Clip framebuffers and the viewport are reduced by this amount while coordinates
+     * stay in terms of the sequence's full resolution, so main_buffer, backend_buffer1 and backend_buffer2 must be
+     * the sequence's size divided by this too.
+     */
+    int resolution_divider;
+
     /**
      * @brief Premultiply alpha shader
      *
@@ -181,7 +203,7 @@ namespace rendering {
 /**
   * @brief Compose a frame of a given sequence
   *
-  * For any given Sequence, this function will render the current frame indicated by Sequence::playhead. Will
+  * For any given Sequence, this function will render the frame indicated by ComposeSequenceParams::playhead. Will
   * automatically open and close clips (memory allocation and file handles) as necessary, communicate with the
   * Clip::cacher objects to retrieve upcoming frames and store them in memory, run Effect processing functions, and
   * finally composite all the currently active clips together into a final texture.
@@ -202,6 +224,23 @@ namespace rendering {
   */
 GLuint compose_sequence(ComposeSequenceParams &params);
 
+/**
+ * @brief Returns whether every clip visible at a frame of a Sequence already has its frame decoded
+ *
+ * compose_sequence() blocks until each clip's cacher has decoded the frame. This checks without waiting or asking the
+ * cachers to do anything, so a frame that isn't needed yet (e.g. one rendered ahead of the playhead) is only composed
+ * once doing so won't hold up anything else. Clips inside nested sequences are checked too.
+ *
+ * @param seq
+ *
+ * The Sequence to check
+ *
+ * @param playhead
+ *
+ * The frame of `seq` to check
+ */
+bool frame_is_queued(Sequence* seq, long playhead);
+
 /**
  * @brief Convenience wrapper function for compose_sequence() to render audio
  *
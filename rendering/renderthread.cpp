@@ -33,14 +33,31 @@ namespace OCIO = OCIO_NAMESPACE::v1;
 #include "timeline/sequence.h"
 #include "effects/effectloaders.h"
 #include "global/config.h"
+#include "global/global.h"
 #include "rendering/renderfunctions.h"
 #include "rendering/shadergenerators.h"
+#include "rendering/compositecache.h"
+#include "rendering/framebufferpool.h"
+#include "rendering/nestcache.h"
+
+// how long to wait before trying to render a frame ahead or of a range again if its clips weren't ready, in
+// milliseconds
+const int kRetryInterval = 10;
 
 RenderThread::RenderThread() :
   gizmos(nullptr),
   share_ctx(nullptr),
   ctx(nullptr),
   seq(nullptr),
+  divider(1),
+  scrubbing_(false),
+  range_seq(nullptr),
+  range_in(0),
+  range_frame(0),
+  range_out(0),
+  range_retry(false),
+  last_shown_frame(-1),
+  render_ahead_retry(false),
   tex_width(-1),
   tex_height(-1),
   queued(false),
@@ -48,10 +65,20 @@ RenderThread::RenderThread() :
   ocio_lut_texture(0),
   ocio_shader(nullptr),
   running(true),
+  pause_count(0),
   ocio_config_date(0),
+  front_fence1(nullptr),
+  front_fence2(nullptr),
   front_buffer_switcher(false),
   pipeline_program(nullptr)
 {
+  for (int i=0;i<kRenderAheadFrames;i++) {
+    render_ahead[i].seq = nullptr;
+    render_ahead[i].frame = -1;
+    render_ahead[i].hash = 0;
+    render_ahead[i].ready = false;
+  }
+
   surface.create();
 }
 
@@ -63,83 +90,466 @@ void RenderThread::run() {
   wait_lock_.lock();
 
   while (running) {
-    if (!queued) {
-      wait_cond_.wait(&wait_lock_);
+    if (!queued || pause_count > 0) {
+      if (find_render_ahead_frame(nullptr, nullptr)) {
+        // let the main thread queue the next frame between frames rendered ahead, and don't spin while a frame's clips
+        // aren't ready
+        wait_cond_.wait(&wait_lock_, render_ahead_retry ? kRetryInterval : 1);
+      } else if (range_render_active()) {
+        // let the main thread queue a frame or pause rendering between frames of the range, and don't spin while a
+        // frame's clips aren't ready
+        wait_cond_.wait(&wait_lock_, range_retry ? kRetryInterval : 1);
+      } else {
+        wait_cond_.wait(&wait_lock_);
+      }
     }
     if (!running) {
       break;
     }
-    queued = false;
 
-    if (share_ctx != nullptr) {
-      if (ctx != nullptr) {
-        ctx->makeCurrent(&surface);
+    if (queued && pause_count == 0) {
+      queued = false;
 
-        // if the sequence size has changed, we'll need to reinitialize the textures
-        if (seq->width != tex_width || seq->height != tex_height) {
-          delete_buffers();
+      if (share_ctx != nullptr) {
+        if (ctx != nullptr) {
+          ctx->makeCurrent(&surface);
 
-          // cache sequence values for future checks
-          tex_width = seq->width;
-          tex_height = seq->height;
-        }
+          prepare();
 
-        // create any buffers that don't yet exist
-        if (!composite_buffer.IsCreated()) {
-          composite_buffer.Create(ctx, seq->width, seq->height);
-        }
-        if (!front_buffer_1.IsCreated()) {
-          front_buffer_1.Create(ctx, seq->width, seq->height);
-        }
-        if (!front_buffer_2.IsCreated()) {
-          front_buffer_2.Create(ctx, seq->width, seq->height);
+          // draw frame, unless it's already been rendered ahead
+          if (!present_render_ahead_frame()) {
+            paint();
+          }
+
+          front_buffer_switcher = !front_buffer_switcher;
+
+          emit ready();
         }
-        if (!back_buffer_1.IsCreated()) {
-          back_buffer_1.Create(ctx, seq->width, seq->height);
+      }
+    } else if (find_render_ahead_frame(nullptr, nullptr)) {
+      ctx->makeCurrent(&surface);
+
+      prepare();
+
+      render_ahead_frame();
+    } else if (range_render_active()) {
+      ctx->makeCurrent(&surface);
+
+      prepare();
+
+      render_range_frame();
+    }
+  }
+
+  delete_ctx();
+
+  wait_lock_.unlock();
+}
+
+void RenderThread::prepare()
+{
+  // buffers are the sequence's size, divided for reduced resolution playback
+  int buffer_width = qMax(1, seq->width / divider);
+  int buffer_height = qMax(1, seq->height / divider);
+
+  // if the sequence size or resolution has changed, we'll need to reinitialize the textures
+  if (buffer_width != tex_width || buffer_height != tex_height) {
+    delete_buffers();
+
+    // cache sequence values for future checks
+    tex_width = buffer_width;
+    tex_height = buffer_height;
+  }
+
+  // create any buffers that don't yet exist
+  if (!composite_buffer.IsCreated()) {
+    composite_buffer.Create(ctx, tex_width, tex_height);
+  }
+  if (!front_buffer_1.IsCreated()) {
+    front_buffer_1.Create(ctx, tex_width, tex_height);
+  }
+  if (!front_buffer_2.IsCreated()) {
+    front_buffer_2.Create(ctx, tex_width, tex_height);
+  }
+  if (!back_buffer_1.IsCreated()) {
+    back_buffer_1.Create(ctx, tex_width, tex_height);
+  }
+  if (!back_buffer_2.IsCreated()) {
+    back_buffer_2.Create(ctx, tex_width, tex_height);
+  }
+
+  // If there's no pipeline shader, create it now
+  if (pipeline_program == nullptr) {
+    delete_shaders();
+
+    pipeline_program = olive::shader::GetPipeline();
+  }
+
+  // If there's no OpenColorIO shader or the configuration has changed, (re-)create it now
+  if (olive::config.enable_color_management && ocio_shader == nullptr) {
+    destroy_ocio();
+
+    set_up_ocio();
+  }
+}
+
+bool RenderThread::compose_frame(long playhead, OldEffectNode *selected_gizmos, bool scrubbing)
+{
+  QOpenGLFunctions* f = ctx->functions();
+
+  // composited frames are cached in the buffers' pixel format
+  olive::PixelFormat format = static_cast<olive::PixelFormat>(olive::config.playback_bit_depth);
+  const olive::PixelFormatInfo& format_info = olive::pixel_formats.at(format);
+
+  bool use_cache = (olive::config.composite_cache_size > 0 && !olive::Global->is_exporting());
+  quint64 hash = 0;
+
+  if (use_cache) {
+    hash = CompositeCache::GetHash(seq, playhead);
+
+    QByteArray pixels;
+
+    // gizmos are positioned while composing, so frames with gizmos to draw are always composed
+    if (selected_gizmos == nullptr
+        && olive::composite_cache.Get(seq, playhead, hash, tex_width, tex_height, format, &pixels)) {
+      composite_buffer.BindTexture();
+      f->glTexSubImage2D(GL_TEXTURE_2D,
+                         0,
+                         0,
+                         0,
+                         tex_width,
+                         tex_height,
+                         format_info.pixel_format,
+                         format_info.pixel_type,
+                         pixels.constData());
+      composite_buffer.ReleaseTexture();
+
+      return true;
+    }
+  }
+
+  // set up compose_sequence() parameters
+  ComposeSequenceParams params;
+  params.viewer = nullptr;
+  params.ctx = ctx;
+  params.seq = seq;
+  params.playhead = playhead;
+  params.type = olive::kTypeVideo;
+  params.texture_failed = false;
+  params.wait_for_mutexes = true;
+  params.playback_speed = playback_speed_;
+  params.scrubbing = scrubbing;
+  params.resolution_divider = divider;
+  params.pipeline = pipeline_program.get();
+  params.backend_buffer1 = &back_buffer_1;
+  params.backend_buffer2 = &back_buffer_2;
+  params.main_buffer = &composite_buffer;
+  params.gizmos = selected_gizmos;
+
+  // bind composite framebuffer for drawing
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, composite_buffer.buffer());
+
+  // Clear framebuffer to nothing
+  f->glClearColor(0.0, 0.0, 0.0, 0.0);
+  f->glClear(GL_COLOR_BUFFER_BIT);
+
+  // Compose the frame
+  olive::rendering::compose_sequence(params);
+
+  // Store complete frames so they don't need to be composed again. Reading a frame back stalls until the GPU has
+  // finished composing it, so frames are only stored while paused (which includes rendering in to out with
+  // render_range_frame()) where that doesn't hold up the next frame. During playback cached frames are still used.
+  if (use_cache && !params.texture_failed && playback_speed_ == 0) {
+    QByteArray pixels(tex_width * tex_height * format_info.bytes_per_pixel, Qt::Uninitialized);
+
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, composite_buffer.buffer());
+    f->glReadPixels(0,
+                    0,
+                    tex_width,
+                    tex_height,
+                    format_info.pixel_format,
+                    format_info.pixel_type,
+                    pixels.data());
+    f->glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+    olive::composite_cache.Add(seq, playhead, hash, tex_width, tex_height, format, pixels);
+  }
+
+  return !params.texture_failed;
+}
+
+void RenderThread::blit_to_display(FramebufferObject &buffer, const FramebufferObject &source, bool convert_color)
+{
+  QOpenGLFunctions* f = ctx->functions();
+
+  f->glViewport(0, 0, tex_width, tex_height);
+
+  // If we're color managing, conver the linear composited frame to display color space
+  if (convert_color && olive::config.enable_color_management && ocio_shader != nullptr) {
+
+    olive::rendering::OCIOBlit(ocio_shader.get(),
+                               ocio_lut_texture,
+                               buffer,
+                               source.texture());
+
+  } else {
+
+    // If we're not color managing, just blit normally
+    buffer.BindBuffer();
+    f->glClear(GL_COLOR_BUFFER_BIT);
+    source.BindTexture();
+    olive::rendering::Blit(pipeline_program.get());
+    source.ReleaseTexture();
+    buffer.ReleaseBuffer();
+
+  }
+}
+
+bool RenderThread::present_render_ahead_frame()
+{
+  // frames are only rendered ahead for the viewer during playback, and frames with gizmos are always composed since
+  // the gizmos are positioned while composing
+  if (playback_speed_ == 0
+      || !save_fn.isEmpty()
+      || pixel_buffer != nullptr
+      || seq->GetSelectedGizmo() != nullptr) {
+    return false;
+  }
+
+  for (int i=0;i<kRenderAheadFrames;i++) {
+    RenderAheadFrame& ahead = render_ahead[i];
+
+    if (ahead.ready && ahead.seq == seq && ahead.frame == seq->playhead) {
+
+      // the sequence may have been modified since the frame was rendered
+      if (ahead.hash != CompositeCache::GetHash(seq, ahead.frame)) {
+        ahead.ready = false;
+        return false;
+      }
+
+      QMutex& active_mutex = front_buffer_switcher ? front_mutex1 : front_mutex2;
+      active_mutex.lock();
+
+      FramebufferObject& buffer = front_buffer_switcher ? front_buffer_1 : front_buffer_2;
+
+      // the frame is already in the display's color space
+      blit_to_display(buffer, ahead.buffer, false);
+
+      fence_front_buffer();
+
+      texture_failed = false;
+
+      active_mutex.unlock();
+
+      last_shown_frame = ahead.frame;
+
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool RenderThread::find_render_ahead_frame(long *frame, int *slot)
+{
+  if (seq == nullptr
+      || ctx == nullptr
+      || pause_count > 0
+      || playback_speed_ == 0
+      || last_shown_frame < 0
+      || olive::Global->is_exporting()
+      || seq->GetSelectedGizmo() != nullptr) {
+    return false;
+  }
+
+  long end_frame = seq->GetEndFrame();
+
+  // frames are shown every `playback_speed_` frames in the direction of playback
+  for (int i=1;i<=kRenderAheadFrames;i++) {
+    long next_frame = last_shown_frame + playback_speed_ * i;
+
+    if (next_frame < 0 || next_frame >= end_frame) {
+      break;
+    }
+
+    bool rendered = false;
+
+    for (int j=0;j<kRenderAheadFrames;j++) {
+      const RenderAheadFrame& ahead = render_ahead[j];
+
+      if (ahead.ready && ahead.seq == seq && ahead.frame == next_frame) {
+        rendered = true;
+        break;
+      }
+    }
+
+    if (rendered) {
+      continue;
+    }
+
+    // render into a slot that doesn't hold one of the upcoming frames (e.g. a frame that's already been shown)
+    for (int j=0;j<kRenderAheadFrames;j++) {
+      const RenderAheadFrame& ahead = render_ahead[j];
+
+      long offset = ahead.frame - last_shown_frame;
+
+      if (!ahead.ready
+          || ahead.seq != seq
+          || offset % playback_speed_ != 0
+          || offset / playback_speed_ < 1
+          || offset / playback_speed_ > kRenderAheadFrames) {
+
+        if (frame != nullptr) {
+          *frame = next_frame;
         }
-        if (!back_buffer_2.IsCreated()) {
-          back_buffer_2.Create(ctx, seq->width, seq->height);
+
+        if (slot != nullptr) {
+          *slot = j;
         }
 
-        // If there's no pipeline shader, create it now
-        if (pipeline_program == nullptr) {
-          delete_shaders();
+        return true;
+      }
+    }
 
-          pipeline_program = olive::shader::GetPipeline();
-        }
+    return false;
+  }
 
-        // If there's no OpenColorIO shader or the configuration has changed, (re-)create it now
-        if (olive::config.enable_color_management && ocio_shader == nullptr) {
-          destroy_ocio();
+  return false;
+}
 
-          set_up_ocio();
-        }
+void RenderThread::render_ahead_frame()
+{
+  long frame;
+  int slot;
+
+  if (!find_render_ahead_frame(&frame, &slot)) {
+    return;
+  }
 
-        // draw frame
-        paint();
+  quint64 hash = CompositeCache::GetHash(seq, frame);
 
-        front_buffer_switcher = !front_buffer_switcher;
+  // Composing waits for every clip to decode the frame, which would hold up the frame the viewer needs next. Only
+  // render ahead once the frame is ready to compose (or already cached), otherwise try again shortly.
+  olive::PixelFormat format = static_cast<olive::PixelFormat>(olive::config.playback_bit_depth);
 
-        emit ready();
-      }
+  if (!olive::composite_cache.Contains(seq, frame, hash, tex_width, tex_height, format)
+      && !olive::rendering::frame_is_queued(seq, frame)) {
+    render_ahead_retry = true;
+    return;
+  }
+
+  QOpenGLFunctions* f = ctx->functions();
+
+  RenderAheadFrame& ahead = render_ahead[slot];
+  ahead.ready = false;
+
+  f->glEnable(GL_BLEND);
+
+  // if any of the frame's clips weren't ready, try the same frame again
+  render_ahead_retry = !compose_frame(frame, nullptr, false);
+
+  if (!render_ahead_retry) {
+    if (!ahead.buffer.IsCreated()) {
+      ahead.buffer.Create(ctx, tex_width, tex_height);
     }
+
+    blit_to_display(ahead.buffer, composite_buffer, true);
+
+    ahead.seq = seq;
+    ahead.frame = frame;
+    ahead.hash = hash;
+    ahead.ready = true;
   }
 
-  delete_ctx();
+  f->glDisable(GL_BLEND);
 
-  wait_lock_.unlock();
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
 }
 
-QMutex *RenderThread::get_texture_mutex()
+bool RenderThread::range_render_active()
 {
-  // return the mutex for the opposite texture being drawn to by the renderer
-  return front_buffer_switcher ? &front_mutex2 : &front_mutex1;
+  if (range_seq == nullptr || pause_count > 0) {
+    return false;
+  }
+
+  // the viewer has switched to another sequence
+  if (range_seq != seq) {
+    range_seq = nullptr;
+    return false;
+  }
+
+  return (ctx != nullptr
+          && playback_speed_ == 0
+          && olive::config.composite_cache_size > 0
+          && !olive::Global->is_exporting());
 }
 
-const GLuint &RenderThread::get_texture()
+void RenderThread::render_range_frame()
 {
-  // return the opposite texture to the texture being drawn to by the renderer
-  return front_buffer_switcher ? front_buffer_2.texture() : front_buffer_1.texture();
+  olive::PixelFormat format = static_cast<olive::PixelFormat>(olive::config.playback_bit_depth);
+
+  // skip frames that are already cached
+  while (range_frame < range_out
+         && olive::composite_cache.Contains(seq,
+                                            range_frame,
+                                            CompositeCache::GetHash(seq, range_frame),
+                                            tex_width,
+                                            tex_height,
+                                            format)) {
+    range_frame++;
+  }
+
+  if (range_frame >= range_out) {
+    range_seq = nullptr;
+    return;
+  }
+
+  QOpenGLFunctions* f = ctx->functions();
+
+  f->glEnable(GL_BLEND);
+
+  // if any of the frame's clips weren't ready, try the same frame again
+  range_retry = !compose_frame(range_frame, nullptr, false);
+
+  f->glDisable(GL_BLEND);
+
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+
+  if (!range_retry) {
+    range_frame++;
+  }
+}
+
+QMutex *RenderThread::lock_front_buffer(GLuint *texture, GLsync **fence)
+{
+  // read the switcher once so the mutex, texture and fence all belong to the same buffer even if the renderer switches
+  // buffers in the meantime (the opposite buffer to the one being drawn to by the renderer)
+  bool use_buffer_2 = front_buffer_switcher;
+
+  QMutex* mutex = use_buffer_2 ? &front_mutex2 : &front_mutex1;
+
+  mutex->lock();
+
+  *texture = use_buffer_2 ? front_buffer_2.texture() : front_buffer_1.texture();
+  *fence = use_buffer_2 ? &front_fence2 : &front_fence1;
+
+  return mutex;
+}
+
+void RenderThread::fence_front_buffer()
+{
+  QOpenGLExtraFunctions* xf = ctx->extraFunctions();
+
+  GLsync& fence = front_buffer_switcher ? front_fence1 : front_fence2;
+
+  if (fence != nullptr) {
+    xf->glDeleteSync(fence);
+  }
+
+  fence = xf->glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+  // a fence can only be signalled once it's been submitted, and other contexts waiting on it can't submit it for us
+  xf->glFlush();
 }
 
 void RenderThread::set_up_ocio()
@@ -191,40 +601,23 @@ void RenderThread::destroy_ocio()
   }
   ocio_lut_texture = 0;
   ocio_shader = nullptr;
+
+  // frames rendered ahead were converted with the old display transform
+  for (int i=0;i<kRenderAheadFrames;i++) {
+    render_ahead[i].ready = false;
+  }
 }
 
 void RenderThread::paint() {
-  // set up compose_sequence() parameters
-  ComposeSequenceParams params;
-  params.viewer = nullptr;
-  params.ctx = ctx;
-  params.seq = seq;
-  params.type = olive::kTypeVideo;
-  params.texture_failed = false;
-  params.wait_for_mutexes = true;
-  params.playback_speed = playback_speed_;
-  params.pipeline = pipeline_program.get();
-  params.backend_buffer1 = &back_buffer_1;
-  params.backend_buffer2 = &back_buffer_2;
-  params.main_buffer = &composite_buffer;
-
   // get currently selected gizmos
   gizmos = seq->GetSelectedGizmo();
-  params.gizmos = gizmos;
 
   QOpenGLFunctions* f = ctx->functions();
 
   f->glEnable(GL_BLEND);
 
-  // bind composite framebuffer for drawing
-  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, composite_buffer.buffer());
-
-  // Clear framebuffer to nothing
-  f->glClearColor(0.0, 0.0, 0.0, 0.0);
-  f->glClear(GL_COLOR_BUFFER_BIT);
-
   // Compose the current frame
-  olive::rendering::compose_sequence(params);
+  bool frame_complete = compose_frame(seq->playhead, gizmos, scrubbing_);
 
   // Copy composite buffer to front buffer
   // First lock the appropriate mutex for exclusivity
@@ -234,33 +627,17 @@ void RenderThread::paint() {
   FramebufferObject& buffer = front_buffer_switcher ? front_buffer_1 : front_buffer_2;
 
   // Blit the composite buffer to one of the front buffers
+  blit_to_display(buffer, composite_buffer, true);
 
-  // If we're color managing, conver the linear composited frame to display color space
-  if (olive::config.enable_color_management && ocio_shader != nullptr) {
-
-    olive::rendering::OCIOBlit(ocio_shader.get(),
-                               ocio_lut_texture,
-                               buffer,
-                               composite_buffer.texture());
-
-  } else {
-
-    // If we're not color managing, just blit normally
-    buffer.BindBuffer();
-    f->glClear(GL_COLOR_BUFFER_BIT);
-    composite_buffer.BindTexture();
-    olive::rendering::Blit(pipeline_program.get());
-    composite_buffer.ReleaseTexture();
-    buffer.ReleaseBuffer();
-
-  }
+  last_shown_frame = seq->playhead;
 
-  // flush changes
-  f->glFinish();
+  // fence rather than finish so the next frame can be set up while the GPU is still drawing this one, the viewer waits
+  // on the fence instead (see lock_front_buffer())
+  fence_front_buffer();
 
   f->glDisable(GL_BLEND);
 
-  texture_failed = params.texture_failed;
+  texture_failed = !frame_complete;
 
   active_mutex.unlock();
 
@@ -308,11 +685,14 @@ void RenderThread::start_render(QOpenGLContext *share,
                                 const QString& save,
                                 GLvoid* pixels,
                                 int pixel_linesize,
-                                int idivider) {
-  Q_UNUSED(idivider);
-
+                                int idivider,
+                                bool scrubbing) {
   seq = s;
 
+  divider = qMax(1, idivider);
+
+  scrubbing_ = scrubbing;
+
   playback_speed_ = playback_speed;
 
   // stall any dependent actions
@@ -337,6 +717,57 @@ void RenderThread::start_render(QOpenGLContext *share,
   wait_cond_.wakeAll();
 }
 
+void RenderThread::render_range(Sequence *s, long in, long out)
+{
+  wait_lock_.lock();
+
+  range_seq = s;
+  range_in = in;
+  range_frame = in;
+  range_out = out;
+  range_retry = false;
+
+  wait_lock_.unlock();
+
+  wait_cond_.wakeAll();
+}
+
+void RenderThread::stop_range_render()
+{
+  wait_lock_.lock();
+
+  range_seq = nullptr;
+
+  wait_lock_.unlock();
+}
+
+void RenderThread::pause_rendering()
+{
+  // the thread only releases wait_lock_ while it's waiting, so once we have it nothing is being rendered
+  wait_lock_.lock();
+
+  pause_count++;
+
+  wait_lock_.unlock();
+}
+
+void RenderThread::resume_rendering()
+{
+  wait_lock_.lock();
+
+  pause_count--;
+
+  // frames of the range that were already rendered may have changed, frames that are still cached are skipped
+  if (pause_count == 0) {
+    range_frame = range_in;
+    range_retry = false;
+  }
+
+  wait_lock_.unlock();
+
+  wait_cond_.wakeAll();
+}
+
 bool RenderThread::did_texture_fail() {
   return texture_failed;
 }
@@ -364,11 +795,31 @@ void RenderThread::wait_until_paused()
 }
 
 void RenderThread::delete_buffers() {
+  // fences are only set once a front buffer has been drawn to, so ctx exists if there are any
+  front_mutex1.lock();
+  if (front_fence1 != nullptr) {
+    ctx->extraFunctions()->glDeleteSync(front_fence1);
+    front_fence1 = nullptr;
+  }
+  front_mutex1.unlock();
+
+  front_mutex2.lock();
+  if (front_fence2 != nullptr) {
+    ctx->extraFunctions()->glDeleteSync(front_fence2);
+    front_fence2 = nullptr;
+  }
+  front_mutex2.unlock();
+
   composite_buffer.Destroy();
   front_buffer_1.Destroy();
   front_buffer_2.Destroy();
   back_buffer_1.Destroy();
   back_buffer_2.Destroy();
+
+  for (int i=0;i<kRenderAheadFrames;i++) {
+    render_ahead[i].buffer.Destroy();
+    render_ahead[i].ready = false;
+  }
 }
 
 void RenderThread::delete_shaders() {
@@ -380,6 +831,8 @@ void RenderThread::delete_ctx() {
     delete_shaders();
     delete_buffers();
     destroy_ocio();
+    olive::nest_cache.Clear(ctx);
+    olive::framebuffer_pool.Clear(ctx);
   }
 
   delete ctx;
@@ -41,8 +41,11 @@ public:
   ~RenderThread();
   void run();
 
-  QMutex* get_texture_mutex();
-  const GLuint& get_texture();
+  // locks the front buffer the renderer isn't drawing to and returns its mutex, which the caller must unlock once it's
+  // done with the buffer. `texture` is set to the buffer's texture and `fence` to the buffer's fence, which may only be
+  // read while the mutex is locked. Another context must glWaitSync() on the fence (if it isn't null) before sampling
+  // the texture so it waits on the GPU until the frame has finished rendering.
+  QMutex* lock_front_buffer(GLuint* texture, GLsync** fence);
 
   OldEffectNode* gizmos;
   void paint();
@@ -52,12 +55,54 @@ public:
                     const QString &save = nullptr,
                     GLvoid *pixels = nullptr,
                     int pixel_linesize = 0,
-                    int idivider = 0);
+                    int idivider = 0,
+                    bool scrubbing = false);
   bool did_texture_fail();
   void cancel();
   void wait_until_paused();
 
+  /**
+   * @brief Render a range of frames into olive::composite_cache in the background
+   *
+   * Frames are rendered whenever the thread would otherwise be idle, so frames requested with start_render() always
+   * come first. Rendering pauses during playback (so clips don't have to seek back and forth between the playhead and
+   * the frames being rendered) and stops if start_render() switches to another sequence. Frames that are already
+   * cached are skipped.
+   *
+   * @param s
+   *
+   * The sequence to render, which must be the one frames are being requested from with start_render()
+   *
+   * @param in
+   * @param out
+   *
+   * The first frame to render and the frame after the last one
+   */
+  void render_range(Sequence* s, long in, long out);
+
+  /**
+   * @brief Stop any range being rendered by render_range()
+   */
+  void stop_range_render();
+
 public slots:
+  /**
+   * @brief Stop rendering until resume_rendering() is called
+   *
+   * Returns once the frame being rendered (if any) is finished, so sequences can be modified safely. Frames requested
+   * with start_render() in the meantime are rendered once rendering resumes. Calls can be nested, rendering resumes
+   * once every call has been matched by resume_rendering().
+   */
+  void pause_rendering();
+
+  /**
+   * @brief Resume rendering after pause_rendering()
+   *
+   * A range being rendered with render_range() is checked again from its start, since frames already rendered may
+   * have been invalidated while rendering was paused.
+   */
+  void resume_rendering();
+
   // cleanup functions
   void delete_ctx();
   void delete_buffers();
@@ -70,6 +115,39 @@ private:
   // OpenColorIO functions
   void set_up_ocio();
 
+  // creates any buffers, shaders, etc. that don't exist yet for rendering the current sequence
+  void prepare();
+
+  // composes a frame of the current sequence into composite_buffer (or copies it from olive::composite_cache if it's
+  // cached there, frames composed while paused are added to it), returns TRUE if the frame is complete
+  bool compose_frame(long playhead, OldEffectNode* selected_gizmos, bool scrubbing);
+
+  // blits a texture to a buffer, converting it to the display's color space first if `convert_color` is TRUE and
+  // color management is enabled
+  void blit_to_display(FramebufferObject& buffer, const FramebufferObject& source, bool convert_color);
+
+  // replaces the fence of the front buffer being drawn to with one following everything drawn to it so far, its mutex
+  // must be locked
+  void fence_front_buffer();
+
+  // shows the requested frame from the render-ahead queue if it's been rendered there, returns TRUE if it was
+  bool present_render_ahead_frame();
+
+  // finds the next frame after the last one shown that should be rendered ahead during playback and the slot of the
+  // render-ahead queue to render it into, returns FALSE if there isn't one right now (always while rendering is
+  // paused), wait_lock_ must be locked
+  bool find_render_ahead_frame(long* frame, int* slot);
+
+  // renders the next frame of the render-ahead queue
+  void render_ahead_frame();
+
+  // returns whether there's a frame to render from render_range() right now (never while rendering is paused),
+  // wait_lock_ must be locked
+  bool range_render_active();
+
+  // renders the next uncached frame from render_range()
+  void render_range_frame();
+
   // OpenColorIO variables
   GLuint ocio_lut_texture;
   QOpenGLShaderProgramPtr ocio_shader;
@@ -77,9 +155,11 @@ private:
 
   FramebufferObject front_buffer_1;
   QMutex front_mutex1;
+  GLsync front_fence1;
 
   FramebufferObject front_buffer_2;
   QMutex front_mutex2;
+  GLsync front_fence2;
 
   FramebufferObject composite_buffer;
 
@@ -102,15 +182,50 @@ private:
   Sequence* seq;
 
   int playback_speed_;
+
+  // whether the user is scrubbing, only applies to the frame requested with start_render()
+  bool scrubbing_;
+
+  // amount the sequence's resolution is divided by for reduced resolution playback (1 for full resolution)
   int divider;
   int tex_width;
   int tex_height;
   bool queued;
   bool texture_failed;
   bool running;
+
+  // number of pause_rendering() calls that haven't been matched by resume_rendering() yet, protected by wait_lock_
+  int pause_count;
   QString save_fn;
   GLvoid *pixel_buffer;
   int pixel_buffer_linesize;
+
+  // range being rendered by render_range(), range_seq is nullptr if there isn't one
+  Sequence* range_seq;
+  long range_in;
+  long range_frame;
+  long range_out;
+  bool range_retry;
+
+  // number of frames composed ahead of the playhead during playback
+  static const int kRenderAheadFrames = 4;
+
+  // a frame composed ahead of the playhead during playback, converted to the display's color space so it can be
+  // copied straight to a front buffer when it's requested
+  struct RenderAheadFrame {
+    FramebufferObject buffer;
+    Sequence* seq;
+    long frame;
+    quint64 hash;
+    bool ready;
+  };
+
+  // render-ahead queue, reused as a ring as playback moves past each frame
+  RenderAheadFrame render_ahead[kRenderAheadFrames];
+
+  // last frame copied to a front buffer, frames are rendered ahead of this one
+  long last_shown_frame;
+  bool render_ahead_retry;
 };
 
 #endif // RENDERTHREAD_H
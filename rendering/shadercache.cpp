@@ -0,0 +1,105 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "shadercache.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+
+ShaderCache olive::shader_cache;
+
+ShaderCache::ShaderCache() {}
+
+QOpenGLShaderProgramPtr ShaderCache::Get(const QString &vertex_code, const QString &fragment_code)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+
+  if (ctx == nullptr) {
+    qWarning() << "No current context to create a shader program for";
+    return Compile(vertex_code, fragment_code);
+  }
+
+  QCryptographicHash hash(QCryptographicHash::Sha1);
+  hash.addData(vertex_code.toUtf8());
+  hash.addData(QByteArray(1, '\0'));
+  hash.addData(fragment_code.toUtf8());
+  QByteArray key = hash.result();
+
+  QOpenGLShaderProgramPtr program;
+
+  {
+    QMutexLocker locker(&lock_);
+
+    if (!programs_.contains(ctx)) {
+      // contexts are destroyed in the thread they belong to, so free their programs right there with them
+      connect(ctx, SIGNAL(aboutToBeDestroyed()), this, SLOT(ContextDestroyed()), Qt::DirectConnection);
+
+      programs_.insert(ctx, QHash<QByteArray, QOpenGLShaderProgramPtr>());
+    }
+
+    program = programs_.value(ctx).value(key);
+  }
+
+  if (program != nullptr) {
+    return program;
+  }
+
+  // compile without the lock held so other threads aren't stalled, a context is only used by one thread at a time so
+  // nothing else can be compiling this program for it
+  program = Compile(vertex_code, fragment_code);
+
+  // don't keep programs that failed so they're retried (and their errors logged again) next time
+  if (program->isLinked()) {
+    QMutexLocker locker(&lock_);
+
+    programs_[ctx].insert(key, program);
+  }
+
+  return program;
+}
+
+void ShaderCache::ContextDestroyed()
+{
+  QOpenGLContext* ctx = static_cast<QOpenGLContext*>(sender());
+
+  QMutexLocker locker(&lock_);
+
+  programs_.remove(ctx);
+}
+
+QOpenGLShaderProgramPtr ShaderCache::Compile(const QString &vertex_code, const QString &fragment_code)
+{
+  QOpenGLShaderProgramPtr program = std::make_shared<QOpenGLShaderProgram>();
+
+#if (QT_VERSION >= QT_VERSION_CHECK(5, 9, 0))
+  // uses glProgramBinary() with a binary stored on disk by a previous link if there is one
+  program->addCacheableShaderFromSourceCode(QOpenGLShader::Vertex, vertex_code);
+  program->addCacheableShaderFromSourceCode(QOpenGLShader::Fragment, fragment_code);
+#else
+  program->addShaderFromSourceCode(QOpenGLShader::Vertex, vertex_code);
+  program->addShaderFromSourceCode(QOpenGLShader::Fragment, fragment_code);
+#endif
+
+  if (!program->link()) {
+    qWarning() << "Failed to link shader program:" << program->log();
+  }
+
+  return program;
+}
@@ -0,0 +1,89 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef SHADERCACHE_H
+#define SHADERCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QMutex>
+#include <QOpenGLContext>
+
+#include "rendering/qopenglshaderprogramptr.h"
+
+/**
+ * @brief The ShaderCache class
+ *
+ * Compiling and linking GLSL takes the driver anywhere from a few to tens of milliseconds per program, and every clip
+ * used to compile its own copy of the same handful of programs (YUV conversion, OCIO transforms, effects) when it was
+ * opened. ShaderCache compiles each distinct program once per OpenGL context and hands the same linked program to
+ * everyone who asks for it afterwards, until the context is destroyed.
+ *
+ * Programs aren't shared between contexts even if the contexts share resources, since contexts in the same share
+ * group are used from different threads and a program's uniforms would be set by both at once.
+ *
+ * On Qt 5.9 and later, programs are also cached on disk as program binaries (Qt keys them by a hash of the source and
+ * the driver's vendor, renderer and version strings), so most programs don't need to be compiled at all after the first
+ * time Olive runs.
+ *
+ * All functions are thread-safe.
+ */
+class ShaderCache : public QObject {
+  Q_OBJECT
+public:
+  ShaderCache();
+
+  /**
+   * @brief Get a program linked from vertex and fragment shader source code for the current context
+   *
+   * The program is shared with anyone else who requests the same source code in the same context, so any uniforms
+   * that differ between users must be set before every draw.
+   *
+   * @return
+   *
+   * The program, which should be checked with QOpenGLShaderProgram::isLinked() in case the source code didn't compile.
+   */
+  QOpenGLShaderProgramPtr Get(const QString& vertex_code, const QString& fragment_code);
+
+private slots:
+  /**
+   * @brief Free the programs of a context that's about to be destroyed (the context is the sender())
+   */
+  void ContextDestroyed();
+
+private:
+  /**
+   * @brief Internal function to compile and link a program in the current context
+   */
+  static QOpenGLShaderProgramPtr Compile(const QString& vertex_code, const QString& fragment_code);
+
+  /**
+   * @brief Linked programs of each context keyed by a hash of their source code
+   */
+  QHash<QOpenGLContext*, QHash<QByteArray, QOpenGLShaderProgramPtr> > programs_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern ShaderCache shader_cache;
+}
+
+#endif // SHADERCACHE_H
@@ -1,30 +1,39 @@
 #include "shadergenerators.h"
 
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
 #include <QOpenGLExtraFunctions>
+#include <QGenericMatrix>
+#include <QVector3D>
+
+#include "rendering/shadercache.h"
+
+// vertex shader shared by all pipelines
+const char* const kPipelineVertexShader = "#version 110\n"
+                                          "\n"
+                                          "#ifdef GL_ES\n"
+                                          "precision mediump int;\n"
+                                          "precision mediump float;\n"
+                                          "#endif\n"
+                                          "\n"
+                                          "uniform mat4 mvp_matrix;\n"
+                                          "\n"
+                                          "attribute vec4 a_position;\n"
+                                          "attribute vec2 a_texcoord;\n"
+                                          "\n"
+                                          "varying vec2 v_texcoord;\n"
+                                          "\n"
+                                          "void main() {\n"
+                                          "  gl_Position = mvp_matrix * a_position;\n"
+                                          "  v_texcoord = a_texcoord;\n"
+                                          "}\n";
 
 QOpenGLShaderProgramPtr olive::shader::GetPipeline(const QString& function_name, const QString& shader_code)
 {
-  QOpenGLShaderProgramPtr program = std::make_shared<QOpenGLShaderProgram>();
-
   // Generate vertex shader
-  QString vert_shader = "#version 110\n"
-                        "\n"
-                        "#ifdef GL_ES\n"
-                        "precision mediump int;\n"
-                        "precision mediump float;\n"
-                        "#endif\n"
-                        "\n"
-                        "uniform mat4 mvp_matrix;\n"
-                        "\n"
-                        "attribute vec4 a_position;\n"
-                        "attribute vec2 a_texcoord;\n"
-                        "\n"
-                        "varying vec2 v_texcoord;\n"
-                        "\n"
-                        "void main() {\n"
-                        "  gl_Position = mvp_matrix * a_position;\n"
-                        "  v_texcoord = a_texcoord;\n"
-                        "}\n";
+  QString vert_shader = kPipelineVertexShader;
 
   // Generate fragment shader
   QString frag_shader = "#version 110\n"
@@ -78,10 +87,8 @@ QOpenGLShaderProgramPtr olive::shader::GetPipeline(const QString& function_name,
 
 
 
-  // Add shaders to program
-  program->addShaderFromSourceCode(QOpenGLShader::Vertex, vert_shader);
-  program->addShaderFromSourceCode(QOpenGLShader::Fragment, frag_shader);
-  program->link();
+  // Get a linked program from the shader cache (which only compiles it if it hasn't already)
+  QOpenGLShaderProgramPtr program = olive::shader_cache.Get(vert_shader, frag_shader);
 
   // Set opacity default to 100%
   program->bind();
@@ -228,3 +235,100 @@ QOpenGLShaderProgramPtr olive::shader::SetupOCIO(QOpenGLContext* ctx,
 
   return shader;
 }
+
+QOpenGLShaderProgramPtr olive::shader::GetYUVPipeline()
+{
+  // Samples each plane (chroma planes are upsampled by the texture filtering), normalizes the samples to the
+  // frame's bit depth, removes the range offsets and converts to RGB with the frame's color matrix
+  QString frag_shader = "#version 110\n"
+                        "\n"
+                        "#ifdef GL_ES\n"
+                        "precision mediump int;\n"
+                        "precision mediump float;\n"
+                        "#endif\n"
+                        "\n"
+                        "uniform sampler2D texture;\n"
+                        "uniform sampler2D u_texture;\n"
+                        "uniform sampler2D v_texture;\n"
+                        "uniform float bit_scale;\n"
+                        "uniform vec3 yuv_offset;\n"
+                        "uniform mat3 yuv_matrix;\n"
+                        "varying vec2 v_texcoord;\n"
+                        "\n"
+                        "void main() {\n"
+                        "  vec3 yuv = vec3(texture2D(texture, v_texcoord).r,\n"
+                        "                  texture2D(u_texture, v_texcoord).r,\n"
+                        "                  texture2D(v_texture, v_texcoord).r) * bit_scale;\n"
+                        "  gl_FragColor = vec4(yuv_matrix * (yuv - yuv_offset), 1.0);\n"
+                        "}\n";
+
+  QOpenGLShaderProgramPtr program = olive::shader_cache.Get(kPipelineVertexShader, frag_shader);
+
+  program->bind();
+  program->setUniformValue("u_texture", 1);
+  program->setUniformValue("v_texture", 2);
+  program->release();
+
+  return program;
+}
+
+void olive::shader::SetYUVUniforms(QOpenGLShaderProgram *pipeline, const AVFrame *frame)
+{
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+
+  int depth = desc->comp[0].depth;
+  double max_value = (1 << depth) - 1;
+
+  // textures normalize samples to the size of the sample rather than the bit depth (e.g. 10-bit in 16-bit samples)
+  int container_bits = (depth > 8) ? 16 : 8;
+  double bit_scale = double((1 << container_bits) - 1) / max_value;
+
+  // luma/chroma coefficients of the color matrix (FFmpeg's swscale assumes BT.601 if the frame doesn't specify one,
+  // so we do too for consistency with the software path)
+  double kr, kb;
+  switch (frame->colorspace) {
+  case AVCOL_SPC_BT709:
+    kr = 0.2126;
+    kb = 0.0722;
+    break;
+  case AVCOL_SPC_BT2020_NCL:
+  case AVCOL_SPC_BT2020_CL:
+    kr = 0.2627;
+    kb = 0.0593;
+    break;
+  default:
+    kr = 0.299;
+    kb = 0.114;
+  }
+  double kg = 1.0 - kr - kb;
+
+  // offsets and ranges of the samples in normalized values
+  bool full_range = (frame->color_range == AVCOL_RANGE_JPEG);
+  double depth_scale = (1 << (depth - 8));
+  double y_offset, y_range, c_offset, c_range;
+
+  if (full_range) {
+    y_offset = 0.0;
+    y_range = 1.0;
+    c_offset = (128.0 * depth_scale) / max_value;
+    c_range = 1.0;
+  } else {
+    y_offset = (16.0 * depth_scale) / max_value;
+    y_range = (219.0 * depth_scale) / max_value;
+    c_offset = (128.0 * depth_scale) / max_value;
+    c_range = (224.0 * depth_scale) / max_value;
+  }
+
+  // YCbCr to RGB with the ranges folded in (rows are R, G and B, columns are Y, Cb and Cr)
+  float matrix[] = {
+    float(1.0 / y_range), 0.0f, float(2.0 * (1.0 - kr) / c_range),
+    float(1.0 / y_range), float(-2.0 * kb * (1.0 - kb) / kg / c_range), float(-2.0 * kr * (1.0 - kr) / kg / c_range),
+    float(1.0 / y_range), float(2.0 * (1.0 - kb) / c_range), 0.0f
+  };
+
+  pipeline->bind();
+  pipeline->setUniformValue("bit_scale", float(bit_scale));
+  pipeline->setUniformValue("yuv_offset", QVector3D(float(y_offset), float(c_offset), float(c_offset)));
+  pipeline->setUniformValue("yuv_matrix", QMatrix3x3(matrix));
+  pipeline->release();
+}
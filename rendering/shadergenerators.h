@@ -1,6 +1,10 @@
 #ifndef SHADERGENERATORS_H
 #define SHADERGENERATORS_H
 
+extern "C" {
+#include <libavutil/frame.h>
+}
+
 #include "qopenglshaderprogramptr.h"
 #include "framebufferobject.h"
 #include <OpenColorIO/OpenColorIO.h>
@@ -20,6 +24,12 @@ QString GetAlphaDisassociateFunction(const QString& function_name);
 QString GetAlphaReassociateFunction(const QString& function_name);
 QString GetAlphaAssociateFunction(const QString& function_name);
 
+// Converts planar YUV from three single-channel textures (Y on unit 0, U on 1, V on 2) to RGB
+QOpenGLShaderProgramPtr GetYUVPipeline();
+
+// Sets the YUV pipeline's conversion uniforms for a frame's bit depth, color matrix and range
+void SetYUVUniforms(QOpenGLShaderProgram* pipeline, const AVFrame* frame);
+
 }
 }
 
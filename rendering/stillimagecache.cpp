@@ -0,0 +1,242 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "stillimagecache.h"
+
+#include <QOpenGLFunctions>
+
+#include "global/path.h"
+
+StillImageCache olive::still_image_cache;
+
+// memory allowed for frames that no clip is using anymore
+const int64_t kMaxIdleFrameBytes = 256 * 1048576;
+
+// maximum amount of textures kept that no clip is using anymore
+const int kMaxIdleTextures = 32;
+
+StillImageCache::StillImageCache() :
+  use_counter_(0)
+{}
+
+StillImageCache::~StillImageCache()
+{
+  QMap<QString, FrameEntry>::iterator i;
+
+  for (i=frames_.begin();i!=frames_.end();i++) {
+    av_frame_free(&i.value().frame);
+  }
+}
+
+QString StillImageCache::GetKey(const QString &filename,
+                                int stream_index,
+                                olive::PixelFormat pixel_format,
+                                bool native_yuv,
+                                int divider)
+{
+  return QString("%1:%2:%3:%4:%5").arg(get_file_hash(filename),
+                                       QString::number(stream_index),
+                                       QString::number(pixel_format),
+                                       QString::number(native_yuv),
+                                       QString::number(divider));
+}
+
+bool StillImageCache::GetFrame(const QString &key, AVFrame *frame)
+{
+  QMutexLocker locker(&lock_);
+
+  QMap<QString, FrameEntry>::iterator i = frames_.find(key);
+
+  if (i == frames_.end()) {
+    return false;
+  }
+
+  i.value().last_used = ++use_counter_;
+
+  return (av_frame_ref(frame, i.value().frame) >= 0);
+}
+
+void StillImageCache::AddFrame(const QString &key, const AVFrame *frame)
+{
+  AVFrame* ref = av_frame_clone(frame);
+
+  if (ref == nullptr) {
+    return;
+  }
+
+  FrameEntry entry;
+  entry.frame = ref;
+  entry.bytes = 0;
+
+  for (int i=0;i<AV_NUM_DATA_POINTERS && ref->buf[i] != nullptr;i++) {
+    entry.bytes += ref->buf[i]->size;
+  }
+
+  QMutexLocker locker(&lock_);
+
+  QMap<QString, FrameEntry>::iterator i = frames_.find(key);
+
+  // another clip may have decoded the same image at the same time, keep the one that's already shared
+  if (i != frames_.end()) {
+    av_frame_free(&ref);
+    return;
+  }
+
+  entry.last_used = ++use_counter_;
+
+  frames_.insert(key, entry);
+
+  TrimFrames(kMaxIdleFrameBytes);
+}
+
+GLuint StillImageCache::AcquireTexture(const QString &key)
+{
+  QMutexLocker locker(&lock_);
+
+  QMap<QString, TextureEntry>::iterator i = textures_.find(key);
+
+  if (i == textures_.end()
+      || i.value().share_group != QOpenGLContext::currentContext()->shareGroup()) {
+    return 0;
+  }
+
+  i.value().refs++;
+  i.value().last_used = ++use_counter_;
+
+  return i.value().texture;
+}
+
+bool StillImageCache::AddTexture(const QString &key, GLuint texture)
+{
+  QMutexLocker locker(&lock_);
+
+  if (textures_.contains(key)) {
+    return false;
+  }
+
+  TextureEntry entry;
+  entry.texture = texture;
+  entry.share_group = QOpenGLContext::currentContext()->shareGroup();
+  entry.refs = 1;
+  entry.last_used = ++use_counter_;
+
+  textures_.insert(key, entry);
+
+  return true;
+}
+
+void StillImageCache::ReleaseTexture(const QString &key)
+{
+  QMutexLocker locker(&lock_);
+
+  QMap<QString, TextureEntry>::iterator i = textures_.find(key);
+
+  if (i == textures_.end()) {
+    return;
+  }
+
+  i.value().refs--;
+
+  TrimTextures(kMaxIdleTextures);
+}
+
+void StillImageCache::Clear()
+{
+  QMutexLocker locker(&lock_);
+
+  TrimFrames(0);
+
+  if (QOpenGLContext::currentContext() != nullptr) {
+    TrimTextures(0);
+  }
+}
+
+bool StillImageCache::IsFrameIdle(const StillImageCache::FrameEntry &entry)
+{
+  // if the cache holds the only reference to the buffers, no clip is using this frame
+  return (entry.frame->buf[0] == nullptr || av_buffer_get_ref_count(entry.frame->buf[0]) == 1);
+}
+
+void StillImageCache::TrimFrames(int64_t max_idle_bytes)
+{
+  int64_t idle_bytes = 0;
+
+  QMap<QString, FrameEntry>::iterator i;
+
+  for (i=frames_.begin();i!=frames_.end();i++) {
+    if (IsFrameIdle(i.value())) {
+      idle_bytes += i.value().bytes;
+    }
+  }
+
+  while (idle_bytes > max_idle_bytes) {
+
+    // find the least recently used idle frame
+    QMap<QString, FrameEntry>::iterator lru = frames_.end();
+
+    for (i=frames_.begin();i!=frames_.end();i++) {
+      if (IsFrameIdle(i.value()) && (lru == frames_.end() || i.value().last_used < lru.value().last_used)) {
+        lru = i;
+      }
+    }
+
+    if (lru == frames_.end()) {
+      break;
+    }
+
+    idle_bytes -= lru.value().bytes;
+    av_frame_free(&lru.value().frame);
+    frames_.erase(lru);
+  }
+}
+
+void StillImageCache::TrimTextures(int max_idle_textures)
+{
+  QOpenGLContextGroup* share_group = QOpenGLContext::currentContext()->shareGroup();
+
+  int idle_textures = 0;
+
+  QMap<QString, TextureEntry>::iterator i;
+
+  for (i=textures_.begin();i!=textures_.end();i++) {
+    if (i.value().refs == 0 && i.value().share_group == share_group) {
+      idle_textures++;
+    }
+  }
+
+  while (idle_textures > max_idle_textures) {
+
+    // find the least recently used idle texture
+    QMap<QString, TextureEntry>::iterator lru = textures_.end();
+
+    for (i=textures_.begin();i!=textures_.end();i++) {
+      if (i.value().refs == 0
+          && i.value().share_group == share_group
+          && (lru == textures_.end() || i.value().last_used < lru.value().last_used)) {
+        lru = i;
+      }
+    }
+
+    QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &lru.value().texture);
+    textures_.erase(lru);
+
+    idle_textures--;
+  }
+}
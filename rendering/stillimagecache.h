@@ -0,0 +1,197 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef STILLIMAGECACHE_H
+#define STILLIMAGECACHE_H
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+#include <QMap>
+#include <QMutex>
+#include <QOpenGLContext>
+
+#include "rendering/pixelformats.h"
+
+/**
+ * @brief The StillImageCache class
+ *
+ * Still images (and other infinite-length streams) only ever produce one frame, but every clip using one would
+ * otherwise decode it, convert it, keep its own copy in memory and upload it to its own texture. A logo or lower third
+ * used hundreds of times in a sequence would be decoded and stored hundreds of times. StillImageCache is a
+ * project-wide cache that lets every clip using the same image share:
+ *
+ * * One decoded frame. Cachers add the frame they decoded with AddFrame() and other Cachers get a new reference to
+ *   the same buffers with GetFrame(). Frames are reference counted by FFmpeg, so the cache only needs to know whether
+ *   anyone other than itself still references a frame.
+ * * One OpenGL texture. Clips add the texture they uploaded with AddTexture() and other clips borrow it with
+ *   AcquireTexture() and give it back with ReleaseTexture().
+ *
+ * Entries are keyed with GetKey() by file and the format frames are conformed to. Frames and textures no longer used
+ * by any clip are kept for re-use up to a limit, the least recently used being freed first.
+ *
+ * All functions are thread-safe. Texture functions must be called with an OpenGL context current.
+ */
+class StillImageCache {
+public:
+  StillImageCache();
+
+  /**
+   * @brief StillImageCache Destructor
+   *
+   * Frees all frames. Textures can't be freed without a context and are left to be freed with their context.
+   */
+  ~StillImageCache();
+
+  /**
+   * @brief Get the key to identify a still image's frames and textures with
+   *
+   * @param filename
+   *
+   * The file the image is decoded from (the Footage URL or its proxy)
+   *
+   * @param stream_index
+   *
+   * The index of the stream in the file
+   *
+   * @param pixel_format
+   *
+   * The pixel format frames are conformed to
+   *
+   * @param native_yuv
+   *
+   * Whether frames may be left in planar YUV (see DecoderParams::video_native_yuv)
+   *
+   * @param divider
+   *
+   * Amount the image's size is divided by (see DecoderParams::video_divider)
+   */
+  static QString GetKey(const QString& filename,
+                        int stream_index,
+                        olive::PixelFormat pixel_format,
+                        bool native_yuv,
+                        int divider);
+
+  /**
+   * @brief Get a reference to an image decoded by another clip
+   *
+   * @param frame
+   *
+   * An empty frame to receive a new reference to the cached frame
+   *
+   * @return
+   *
+   * **TRUE** if the image was in the cache.
+   */
+  bool GetFrame(const QString& key, AVFrame* frame);
+
+  /**
+   * @brief Add a decoded image to the cache
+   *
+   * The cache keeps its own reference to the frame's buffers, the caller still owns `frame`.
+   */
+  void AddFrame(const QString& key, const AVFrame* frame);
+
+  /**
+   * @brief Borrow a texture another clip has uploaded this image to
+   *
+   * @return
+   *
+   * The texture, or 0 if there isn't one usable by the current context. A texture returned here must be given back
+   * with ReleaseTexture() rather than deleted.
+   */
+  GLuint AcquireTexture(const QString& key);
+
+  /**
+   * @brief Share a texture an image has been uploaded to
+   *
+   * If successful, the cache takes ownership of the texture and counts the caller as borrowing it, so it must be given
+   * back with ReleaseTexture() rather than deleted.
+   *
+   * @return
+   *
+   * **TRUE** if the texture was added, **FALSE** if the cache already has a texture for this image (in which case the
+   * caller keeps ownership of `texture`).
+   */
+  bool AddTexture(const QString& key, GLuint texture);
+
+  /**
+   * @brief Give back a texture from AcquireTexture() or AddTexture()
+   */
+  void ReleaseTexture(const QString& key);
+
+  /**
+   * @brief Free all frames and textures that aren't in use
+   *
+   * Textures are only freed if a context sharing them is current.
+   */
+  void Clear();
+
+private:
+  struct FrameEntry {
+    AVFrame* frame;
+    int64_t bytes;
+    quint64 last_used;
+  };
+
+  struct TextureEntry {
+    GLuint texture;
+    QOpenGLContextGroup* share_group;
+    int refs;
+    quint64 last_used;
+  };
+
+  /**
+   * @brief Internal function to determine whether any clip still references a cached frame
+   */
+  static bool IsFrameIdle(const FrameEntry& entry);
+
+  /**
+   * @brief Internal function to free the least recently used idle frames until they're within the limit
+   *
+   * lock_ must be locked.
+   */
+  void TrimFrames(int64_t max_idle_bytes);
+
+  /**
+   * @brief Internal function to free the least recently used idle textures until they're within the limit
+   *
+   * Only textures usable by the current context can be freed. lock_ must be locked.
+   */
+  void TrimTextures(int max_idle_textures);
+
+  QMap<QString, FrameEntry> frames_;
+
+  QMap<QString, TextureEntry> textures_;
+
+  /**
+   * @brief Incremented every time an entry is used, for ordering entries from least to most recently used
+   */
+  quint64 use_counter_;
+
+  QMutex lock_;
+};
+
+namespace olive {
+extern StillImageCache still_image_cache;
+}
+
+#endif // STILLIMAGECACHE_H
@@ -21,6 +21,11 @@
 #include "clip.h"
 
 #include <QtMath>
+#include <QOpenGLExtraFunctions>
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
 
 #include "nodes/oldeffectnode.h"
 #include "effects/transition.h"
@@ -28,6 +33,8 @@
 #include "global/config.h"
 #include "rendering/cacher.h"
 #include "rendering/renderfunctions.h"
+#include "rendering/shadergenerators.h"
+#include "rendering/stillimagecache.h"
 #include "panels/project.h"
 #include "timeline/sequence.h"
 #include "panels/timeline.h"
@@ -37,6 +44,15 @@
 #include "global/debug.h"
 #include "global/timing.h"
 
+/**
+ * @brief Let the Sequence a Track belongs to know its clips have changed so its ClipIndex is rebuilt
+ */
+void InvalidateClipIndex(Track* t) {
+  if (t != nullptr && t->sequence() != nullptr) {
+    t->sequence()->InvalidateClipIndex();
+  }
+}
+
 Clip::Clip(Track *s) :
   track_(s),
   cacher(this),
@@ -52,7 +68,8 @@ Clip::Clip(Track *s) :
   undeletable(false),
   replaced(false),
   open_(false),
-  texture(0)
+  texture(0),
+  yuv_framebuffer(0)
 {
 }
 
@@ -340,6 +357,8 @@ long Clip::timeline_in(bool with_transition) {
 void Clip::set_timeline_in(long t)
 {
   timeline_in_ = t;
+
+  InvalidateClipIndex(track_);
 }
 
 long Clip::timeline_out(bool with_transitions) {
@@ -354,6 +373,8 @@ long Clip::timeline_out(bool with_transitions) {
 void Clip::set_timeline_out(long t)
 {
   timeline_out_ = t;
+
+  InvalidateClipIndex(track_);
 }
 
 bool Clip::reversed()
@@ -418,7 +439,11 @@ Track *Clip::track()
 
 void Clip::set_track(Track *t)
 {
+  InvalidateClipIndex(track_);
+
   track_ = t;
+
+  InvalidateClipIndex(track_);
 }
 
 // timeline functions
@@ -560,12 +585,27 @@ void Clip::Close(bool wait) {
       media()->to_sequence()->Close();
     }
 
-    // destroy opengl texture in main thread
+    // destroy opengl texture in main thread (or give it back if it's shared with other clips)
     if (texture > 0) {
-      QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &texture);
+      if (shared_texture_key.isEmpty()) {
+        QOpenGLContext::currentContext()->functions()->glDeleteTextures(1, &texture);
+      } else {
+        olive::still_image_cache.ReleaseTexture(shared_texture_key);
+        shared_texture_key.clear();
+      }
       texture = 0;
     }
 
+    // free the upload ring (waiting for the cacher if it's copying a frame into it)
+    cacher.upload_ring()->Destroy();
+
+    if (yuv_framebuffer > 0) {
+      QOpenGLContext::currentContext()->functions()->glDeleteFramebuffers(1, &yuv_framebuffer);
+      QOpenGLContext::currentContext()->functions()->glDeleteTextures(3, yuv_textures);
+      yuv_framebuffer = 0;
+    }
+    yuv_shader = nullptr;
+
     // close all effects
     for (int i=0;i<effects.size();i++) {
       if (effects.at(i)->is_open()) {
@@ -573,11 +613,9 @@ void Clip::Close(bool wait) {
       }
     }
 
-    // delete framebuffers
-    fbo.clear();
-
-    // delete OCIO shader
+    // release OCIO shader (the shader and LUT are owned by olive::ocio_cache)
     ocio_shader = nullptr;
+    ocio_lut_texture = 0;
 
     if (UsesCacher()) {
       cacher.Close(wait);
@@ -597,36 +635,60 @@ void Clip::Cache(long playhead, bool scrubbing, QVector<Clip*>& nests, int playb
   cacher_frame = playhead;
 }
 
-bool Clip::Retrieve()
+void Clip::Preroll(long playhead, QVector<Clip *> &nests, int playback_speed) {
+  cacher.Preroll(playhead, nests, playback_speed);
+}
+
+bool Clip::IsFrameQueued(long playhead)
+{
+  return IsOpen() && cacher.IsFrameQueued(playhead);
+}
+
+bool Clip::Retrieve(bool* approximate)
 {
   bool ret = false;
 
   if (UsesCacher()) {
 
-    // Retrieve the frame from the cacher that we requested in Cache().
-    AVFrame* frame = cacher.Retrieve();
-
-    // Wait for exclusive control of the queue to avoid any threading collisions
-    cacher.queue()->lock();
-
-    // Check if we retrieved a frame (nullptr) and if the queue still contains this frame.
+    // Retrieve the frame from the cacher that we requested in Cache() and pin it so the cacher doesn't free it while
+    // we're uploading it.
     //
     // `nullptr` is returned if the cacher failed to get any sort of frame and is uncommon, but we do need
     // to handle it.
     //
-    // We check the queue because in some situations (e.g. intensive scrubbing), in the time it took to gain
-    // exclusive control of the queue, the cacher may have deleted the frame.
-    // Therefore we check to ensure the queue still contains the frame now that we have exclusive control,
-    // to avoid any attempt to utilize now-freed memory.
+    // Pinning also returns `nullptr` if in some situations (e.g. intensive scrubbing), in the time since Cache(), the
+    // cacher has already removed the frame from the queue. This avoids any attempt to utilize now-freed memory, or a
+    // recycled frame that now holds a different picture.
+    int64_t retrieved_pts;
+    AVFrame* frame = cacher.Retrieve(approximate, &retrieved_pts);
+    frame = cacher.queue()->pin(frame, retrieved_pts);
+
+    // still images are only uploaded once, if another clip has already uploaded this one, use its texture
+    if (frame != nullptr && texture == 0 && !cacher.still_image_key().isEmpty()) {
+      texture = olive::still_image_cache.AcquireTexture(cacher.still_image_key());
+
+      if (texture > 0) {
+        shared_texture_key = cacher.still_image_key();
+        texture_timestamp = frame->pts;
+      }
+    }
 
-    if (frame != nullptr && cacher.queue()->contains(frame)) {
+    if (frame != nullptr && texture > 0 && frame->pts == texture_timestamp) {
 
-      //if (frame->pts != texture_timestamp) {
+      // the texture already contains this frame (e.g. playback is paused or the clip is holding a frame), so there's
+      // no need to upload it again
+
+      ret = true;
+
+    } else if (frame != nullptr) {
 
       bool allocate_data = false;
 
       QOpenGLFunctions* f = QOpenGLContext::currentContext()->functions();
 
+      // frames the decoder left in planar YUV are converted on the GPU
+      bool yuv_frame = !(av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format))->flags & AV_PIX_FMT_FLAG_RGB);
+
       // check if the opengl texture exists yet, create it if not
       if (texture == 0) {
 
@@ -657,57 +719,209 @@ bool Clip::Retrieve()
 
       const olive::PixelFormatInfo& pix_fmt_info = olive::pixel_formats.at(cacher.media_pixel_format());
 
-      f->glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[0]/pix_fmt_info.bytes_per_pixel);
-
-      if (allocate_data) {
-
-        // the raw frame size may differ from the one we're using (e.g. a lower resolution proxy), so we make sure
-        // the texture is using the correct dimensions, but then treat it as if it's the original resolution in the
-        // composition
-        f->glTexImage2D(
-              GL_TEXTURE_2D,
-              0,
-              pix_fmt_info.internal_format,
-              video_width,
-              video_height,
-              0,
-              pix_fmt_info.pixel_format,
-              pix_fmt_info.pixel_type,
-              frame->data[0]
-            );
+      if (yuv_frame) {
+
+        // the decoder left this frame in planar YUV, we convert it into the texture on the GPU
+
+        if (allocate_data) {
+          f->glTexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                pix_fmt_info.internal_format,
+                video_width,
+                video_height,
+                0,
+                pix_fmt_info.pixel_format,
+                pix_fmt_info.pixel_type,
+                nullptr
+              );
+        }
+
+        f->glBindTexture(GL_TEXTURE_2D, 0);
+
+        ConvertYUVFrame(frame, allocate_data);
 
       } else {
 
-        f->glTexSubImage2D(GL_TEXTURE_2D,
-                           0,
-                           0,
-                           0,
-                           video_width,
-                           video_height,
-                           pix_fmt_info.pixel_format,
-                           pix_fmt_info.pixel_type,
-                           frame->data[0]
-            );
+        PixelUploadRing* upload_ring = cacher.upload_ring();
+
+        // during playback, the cacher may have already copied this frame into the upload ring, in which case the GPU
+        // can transfer it into the texture without us copying it from client memory
+        const void* pixels = frame->data[0];
+        int linesize = frame->linesize[0];
+        bool staged = (!allocate_data && upload_ring->Acquire(frame->pts, &pixels, &linesize));
+
+        f->glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize/pix_fmt_info.bytes_per_pixel);
+
+        if (allocate_data) {
+
+          // the raw frame size may differ from the one we're using (e.g. a lower resolution proxy), so we make sure
+          // the texture is using the correct dimensions, but then treat it as if it's the original resolution in the
+          // composition
+          f->glTexImage2D(
+                GL_TEXTURE_2D,
+                0,
+                pix_fmt_info.internal_format,
+                video_width,
+                video_height,
+                0,
+                pix_fmt_info.pixel_format,
+                pix_fmt_info.pixel_type,
+                pixels
+              );
+
+          // create the upload ring now that we know how large frames are (still images are only uploaded once so
+          // they don't need one)
+          if (cacher.still_image_key().isEmpty()) {
+            upload_ring->Create(QOpenGLContext::currentContext(), linesize * video_height);
+          }
 
-      }
+        } else {
 
-      f->glBindTexture(GL_TEXTURE_2D, 0);
+          f->glTexSubImage2D(GL_TEXTURE_2D,
+                             0,
+                             0,
+                             0,
+                             video_width,
+                             video_height,
+                             pix_fmt_info.pixel_format,
+                             pix_fmt_info.pixel_type,
+                             pixels
+              );
+
+        }
+
+        if (staged) {
+          upload_ring->Release();
+        }
 
-      f->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        f->glBindTexture(GL_TEXTURE_2D, 0);
+
+        f->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+      }
 
       texture_timestamp = frame->pts;
 
+      // share newly uploaded still images with every other clip using them
+      if (allocate_data
+          && !cacher.still_image_key().isEmpty()
+          && olive::still_image_cache.AddTexture(cacher.still_image_key(), texture)) {
+        shared_texture_key = cacher.still_image_key();
+      }
+
       ret = true;
     } else {
       qCritical() << "Failed to retrieve frame for clip" << name();
     }
 
-    cacher.queue()->unlock();
+    cacher.queue()->unpin();
   }
 
   return ret;
 }
 
+void Clip::ConvertYUVFrame(AVFrame *frame, bool allocate_data)
+{
+  QOpenGLContext* ctx = QOpenGLContext::currentContext();
+  QOpenGLFunctions* f = ctx->functions();
+
+  int video_width = cacher.media_width();
+  int video_height = cacher.media_height();
+
+  const AVPixFmtDescriptor* desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(frame->format));
+
+  // samples over 8 bits are stored in 16 bits
+  bool high_bit_depth = (desc->comp[0].depth > 8);
+  int bytes_per_sample = high_bit_depth ? 2 : 1;
+  GLint plane_internal_format = high_bit_depth ? GL_R16 : GL_R8;
+  GLenum plane_pixel_type = high_bit_depth ? GL_UNSIGNED_SHORT : GL_UNSIGNED_BYTE;
+
+  // create the plane textures, framebuffer and conversion shader the first time
+  if (yuv_framebuffer == 0) {
+    f->glGenTextures(3, yuv_textures);
+
+    for (int i=0;i<3;i++) {
+      f->glBindTexture(GL_TEXTURE_2D, yuv_textures[i]);
+
+      f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+      f->glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    }
+
+    f->glGenFramebuffers(1, &yuv_framebuffer);
+
+    yuv_shader = olive::shader::GetYUVPipeline();
+  }
+
+  // upload each plane as-is (chroma planes are smaller for subsampled formats)
+  for (int i=0;i<3;i++) {
+    int plane_width = (i == 0) ? video_width : AV_CEIL_RSHIFT(video_width, desc->log2_chroma_w);
+    int plane_height = (i == 0) ? video_height : AV_CEIL_RSHIFT(video_height, desc->log2_chroma_h);
+
+    f->glActiveTexture(GL_TEXTURE0 + i);
+    f->glBindTexture(GL_TEXTURE_2D, yuv_textures[i]);
+
+    f->glPixelStorei(GL_UNPACK_ROW_LENGTH, frame->linesize[i]/bytes_per_sample);
+
+    if (allocate_data) {
+      f->glTexImage2D(GL_TEXTURE_2D,
+                      0,
+                      plane_internal_format,
+                      plane_width,
+                      plane_height,
+                      0,
+                      GL_RED,
+                      plane_pixel_type,
+                      frame->data[i]);
+    } else {
+      f->glTexSubImage2D(GL_TEXTURE_2D,
+                         0,
+                         0,
+                         0,
+                         plane_width,
+                         plane_height,
+                         GL_RED,
+                         plane_pixel_type,
+                         frame->data[i]);
+    }
+  }
+
+  f->glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+
+  // keep the framebuffer and viewport compose_sequence() is using
+  GLint previous_framebuffer;
+  GLint previous_viewport[4];
+  f->glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &previous_framebuffer);
+  f->glGetIntegerv(GL_VIEWPORT, previous_viewport);
+
+  // render the planes through the conversion shader into `texture`
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, yuv_framebuffer);
+
+  if (allocate_data) {
+    ctx->extraFunctions()->glFramebufferTexture2D(
+          GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0
+          );
+  }
+
+  f->glViewport(0, 0, video_width, video_height);
+
+  olive::shader::SetYUVUniforms(yuv_shader.get(), frame);
+
+  // Blit() draws with the texture bound to unit 0, which is the Y plane
+  f->glActiveTexture(GL_TEXTURE0);
+  olive::rendering::Blit(yuv_shader.get());
+
+  for (int i=2;i>=0;i--) {
+    f->glActiveTexture(GL_TEXTURE0 + i);
+    f->glBindTexture(GL_TEXTURE_2D, 0);
+  }
+
+  f->glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previous_framebuffer);
+  f->glViewport(previous_viewport[0], previous_viewport[1], previous_viewport[2], previous_viewport[3]);
+}
+
 bool Clip::UsesCacher()
 {
   return type() == olive::kTypeAudio || (media() != nullptr && media()->get_type() == MEDIA_TYPE_FOOTAGE);
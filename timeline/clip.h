@@ -36,6 +36,7 @@
 #include "project/media.h"
 #include "project/footage.h"
 #include "rendering/framebufferobject.h"
+#include "rendering/qopenglshaderprogramptr.h"
 #include "marker.h"
 #include "nodes/nodegraph.h"
 #include "selection.h"
@@ -138,7 +139,9 @@ public:
   // playback functions
   void Open();
   void Cache(long playhead, bool scrubbing, QVector<Clip*> &nests, int playback_speed);
-  bool Retrieve();
+  void Preroll(long playhead, QVector<Clip*> &nests, int playback_speed);
+  bool Retrieve(bool* approximate = nullptr);
+  bool IsFrameQueued(long playhead);
   void Close(bool wait);
   bool IsOpen();
 
@@ -154,11 +157,20 @@ public:
   QMutex cache_lock;
 
   // video playback variables
-  QVector<FramebufferObject> fbo;
+  QVector<FramebufferObject*> fbo; // checked out of olive::framebuffer_pool while the clip is being composed
   GLuint texture;
   int64_t texture_timestamp;
 
+  // key of `texture` in olive::still_image_cache if it's shared with other clips (empty if this clip owns it)
+  QString shared_texture_key;
+
+  // planar YUV frames are uploaded to one texture per plane and converted to RGB into `texture`
+  GLuint yuv_textures[3];
+  GLuint yuv_framebuffer;
+  QOpenGLShaderProgramPtr yuv_shader;
+
 #ifndef NO_OCIO
+  // input color space transform shared from olive::ocio_cache
   QOpenGLShaderProgramPtr ocio_shader;
   GLuint ocio_lut_texture;
 #endif
@@ -186,6 +198,8 @@ private:
   QVector<Marker> markers;
   QColor color_;
   bool open_;
+
+  void ConvertYUVFrame(AVFrame* frame, bool allocate_data);
 };
 
 #endif // CLIP_H
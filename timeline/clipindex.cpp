@@ -0,0 +1,191 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#include "clipindex.h"
+
+#include <algorithm>
+#include <climits>
+
+#include "timeline/sequence.h"
+#include "timeline/clip.h"
+#include "timeline/track.h"
+#include "timeline/tracklist.h"
+
+ClipIndex::ClipIndex(Sequence *parent) :
+  parent_(parent),
+  dirty_(true)
+{
+  entries_.resize(olive::kTypeCount);
+  last_clips_.resize(olive::kTypeCount);
+}
+
+void ClipIndex::Invalidate()
+{
+  QMutexLocker locker(&lock_);
+
+  dirty_ = true;
+}
+
+void ClipIndex::GetClipsInRange(olive::TrackType type,
+                                long start,
+                                long end,
+                                QVector<Clip *> *clips,
+                                QVector<Clip *> *left_clips)
+{
+  QMutexLocker locker(&lock_);
+
+  if (dirty_) {
+    Rebuild();
+  }
+
+  int first_found = clips->size();
+
+  const QVector<Entry>& entries = entries_.at(type);
+
+  QuerySubtree(entries, 0, entries.size(), start, end, clips);
+
+  if (left_clips != nullptr) {
+    QVector<Clip*>& last_clips = last_clips_[type];
+
+    for (int i=0;i<last_clips.size();i++) {
+      Clip* c = last_clips.at(i);
+
+      bool found = false;
+
+      for (int j=first_found;j<clips->size();j++) {
+        if (clips->at(j) == c) {
+          found = true;
+          break;
+        }
+      }
+
+      if (!found) {
+        left_clips->append(c);
+      }
+    }
+
+    last_clips = clips->mid(first_found);
+  }
+}
+
+void ClipIndex::Rebuild()
+{
+  for (int i=0;i<olive::kTypeCount;i++) {
+    QVector<Entry>& entries = entries_[i];
+    entries.clear();
+
+    TrackList* track_list = parent_->GetTrackList(static_cast<olive::TrackType>(i));
+
+    for (int j=0;j<track_list->TrackCount();j++) {
+      Track* track = track_list->TrackAt(j);
+
+      for (int k=0;k<track->ClipCount();k++) {
+        Clip* c = track->GetClip(k).get();
+
+        Entry entry;
+        entry.in = c->timeline_in(true);
+        entry.out = c->timeline_out(true);
+        entry.max_out = entry.out;
+        entry.clip = c;
+
+        entries.append(entry);
+      }
+    }
+
+    std::sort(entries.begin(), entries.end(), EntryLessThan);
+
+    BuildSubtree(entries, 0, entries.size());
+
+    // forget any remembered clips that are no longer in the sequence (they may have been deleted)
+    QVector<Clip*>& last_clips = last_clips_[i];
+
+    for (int j=0;j<last_clips.size();j++) {
+      bool in_sequence = false;
+
+      for (int k=0;k<entries.size();k++) {
+        if (entries.at(k).clip == last_clips.at(j)) {
+          in_sequence = true;
+          break;
+        }
+      }
+
+      if (!in_sequence) {
+        last_clips.removeAt(j);
+        j--;
+      }
+    }
+  }
+
+  dirty_ = false;
+}
+
+bool ClipIndex::EntryLessThan(const Entry &a, const Entry &b)
+{
+  return a.in < b.in;
+}
+
+long ClipIndex::BuildSubtree(QVector<Entry> &entries, int lo, int hi)
+{
+  if (lo >= hi) {
+    return LONG_MIN;
+  }
+
+  int mid = (lo + hi) / 2;
+
+  Entry& entry = entries[mid];
+
+  entry.max_out = qMax(entry.out, qMax(BuildSubtree(entries, lo, mid), BuildSubtree(entries, mid + 1, hi)));
+
+  return entry.max_out;
+}
+
+void ClipIndex::QuerySubtree(const QVector<Entry> &entries,
+                             int lo,
+                             int hi,
+                             long start,
+                             long end,
+                             QVector<Clip *> *clips)
+{
+  if (lo >= hi) {
+    return;
+  }
+
+  int mid = (lo + hi) / 2;
+
+  const Entry& entry = entries.at(mid);
+
+  // no clip in this subtree reaches the range
+  if (entry.max_out <= start) {
+    return;
+  }
+
+  QuerySubtree(entries, lo, mid, start, end, clips);
+
+  // this clip and every clip after it starts after the range
+  if (entry.in >= end) {
+    return;
+  }
+
+  if (entry.out > start) {
+    clips->append(entry.clip);
+  }
+
+  QuerySubtree(entries, mid + 1, hi, start, end, clips);
+}
@@ -0,0 +1,140 @@
+/***
+
+  Olive - Non-Linear Video Editor
+  Copyright (C) 2019  Olive Team
+
+  This program is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  This program is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+***/
+
+#ifndef CLIPINDEX_H
+#define CLIPINDEX_H
+
+#include <QVector>
+#include <QMutex>
+
+#include "tracktypes.h"
+
+class Clip;
+class Sequence;
+
+/**
+ * @brief The ClipIndex class
+ *
+ * An interval index of a Sequence's clips for finding the clips around a frame without visiting every clip in the
+ * Sequence, which compose_sequence() needs to do for every frame it renders.
+ *
+ * The clips of each track type are kept in an array sorted by their timeline in point (including any transition they
+ * share with another clip), which is treated as an implicit balanced binary tree where every node also stores the
+ * latest timeline out point of its subtree. Finding the clips overlapping a range is O(log n + k) for k clips found.
+ *
+ * The index is rebuilt lazily the next time it's queried after Invalidate(), which the Sequence, its tracks and its
+ * clips call whenever a clip is added, removed or moved.
+ *
+ * All functions are thread-safe.
+ */
+class ClipIndex {
+public:
+  ClipIndex(Sequence* parent);
+
+  /**
+   * @brief Mark the index as out of date so it's rebuilt the next time it's queried
+   */
+  void Invalidate();
+
+  /**
+   * @brief Find the clips of a type that overlap a range of frames
+   *
+   * Clips are only found by their timeline in and out points, so whether each clip is actually active (e.g. enabled
+   * and not muted) still needs to be checked with Clip::IsActiveAt().
+   *
+   * @param type
+   *
+   * Type of clips to find
+   *
+   * @param start
+   * @param end
+   *
+   * The first frame of the range and the frame after the last one
+   *
+   * @param clips
+   *
+   * Array to append the clips to, in order of timeline in point
+   *
+   * @param left_clips
+   *
+   * If not `nullptr`, the clips found the last time this was called for `type` with `left_clips` set that are no
+   * longer found this time (e.g. so the caller can close them) are appended to this array, and the clips found this
+   * time are remembered for the next call.
+   */
+  void GetClipsInRange(olive::TrackType type,
+                       long start,
+                       long end,
+                       QVector<Clip*>* clips,
+                       QVector<Clip*>* left_clips = nullptr);
+
+private:
+  struct Entry {
+    long in;
+    long out;
+
+    // latest out point of this entry's subtree in the implicit tree
+    long max_out;
+
+    Clip* clip;
+  };
+
+  /**
+   * @brief Internal function to rebuild the index from the parent Sequence's clips, lock_ must be locked
+   */
+  void Rebuild();
+
+  /**
+   * @brief Internal function for sorting entries by in point
+   */
+  static bool EntryLessThan(const Entry& a, const Entry& b);
+
+  /**
+   * @brief Internal function to set the max_out of every entry of the subtree in [lo, hi), returns the subtree's max_out
+   */
+  static long BuildSubtree(QVector<Entry>& entries, int lo, int hi);
+
+  /**
+   * @brief Internal function to find the entries of the subtree in [lo, hi) overlapping [start, end)
+   */
+  static void QuerySubtree(const QVector<Entry>& entries,
+                           int lo,
+                           int hi,
+                           long start,
+                           long end,
+                           QVector<Clip*>* clips);
+
+  Sequence* parent_;
+
+  /**
+   * @brief Entries of each track type sorted by in point
+   */
+  QVector<QVector<Entry> > entries_;
+
+  /**
+   * @brief Clips found by the last call to GetClipsInRange() of each track type with `left_clips` set
+   */
+  QVector<QVector<Clip*> > last_clips_;
+
+  bool dirty_;
+
+  QMutex lock_;
+};
+
+#endif // CLIPINDEX_H
@@ -27,13 +27,15 @@
 #include "global/clipboard.h"
 #include "global/config.h"
 #include "global/debug.h"
+#include "undo/undostack.h"
 
 Sequence::Sequence() :
   playhead(0),
   using_workarea(false),
   workarea_in(0),
   workarea_out(0),
-  wrapper_sequence(false)
+  wrapper_sequence(false),
+  clip_index_(this)
 {
   // Set up tracks
   track_lists_.resize(olive::kTypeCount);
@@ -41,6 +43,8 @@ Sequence::Sequence() :
   for (int i=0;i<track_lists_.size();i++) {
     track_lists_[i] = new TrackList(this, static_cast<olive::TrackType>(i));
   }
+
+  connect(&olive::undo_stack, SIGNAL(indexChanged(int)), this, SLOT(InvalidateClipIndex()));
 }
 
 SequencePtr Sequence::copy() {
@@ -133,6 +137,20 @@ QVector<Clip *> Sequence::GetAllClips()
   return all_clips;
 }
 
+void Sequence::GetClipsInRange(olive::TrackType type,
+                               long start,
+                               long end,
+                               QVector<Clip *> *clips,
+                               QVector<Clip *> *left_clips)
+{
+  clip_index_.GetClipsInRange(type, start, end, clips, left_clips);
+}
+
+void Sequence::InvalidateClipIndex()
+{
+  clip_index_.Invalidate();
+}
+
 TrackList *Sequence::GetTrackList(olive::TrackType type)
 {
   return track_lists_.at(type);
@@ -29,6 +29,7 @@
 #include "selection.h"
 #include "tracklist.h"
 #include "ghost.h"
+#include "clipindex.h"
 
 class Sequence : public QObject {
   Q_OBJECT
@@ -47,6 +48,19 @@ public:
 
   long GetEndFrame();
   QVector<Clip*> GetAllClips();
+
+  /**
+   * @brief Find the clips of a type that overlap a range of frames
+   *
+   * Much faster than checking every clip from GetAllClips() on long Sequences. See ClipIndex::GetClipsInRange() for
+   * the parameters.
+   */
+  void GetClipsInRange(olive::TrackType type,
+                       long start,
+                       long end,
+                       QVector<Clip*>* clips,
+                       QVector<Clip*>* left_clips = nullptr);
+
   TrackList* GetTrackList(olive::TrackType type);
 
   /**
@@ -121,11 +135,21 @@ public:
   int save_id;
 
   QVector<Marker> markers;
+public slots:
+  /**
+   * @brief Update the index used by GetClipsInRange() after clips have been added, removed or moved
+   *
+   * Called automatically whenever the undo stack changes, since some edits (e.g. to transitions) change where clips
+   * are on the timeline without going through Clip or Track.
+   */
+  void InvalidateClipIndex();
 signals:
   void Changed();
 private:
   QVector<TrackList*> track_lists_;
 
+  ClipIndex clip_index_;
+
   ClipPtr SplitClip(ComboAction* ca, bool transitions, Clip *clip, long frame);
   ClipPtr SplitClip(ComboAction* ca, bool transitions, Clip *clip, long frame, long post_in);
   bool SplitSelection(ComboAction* ca, QVector<Selection> selections);
@@ -110,6 +110,8 @@ void Track::AddClip(ClipPtr clip)
     clip->track()->RemoveClip(clip.get());
   }
   clip->set_track(this);
+
+  sequence()->InvalidateClipIndex();
 }
 
 int Track::ClipCount()
@@ -125,6 +127,8 @@ ClipPtr Track::GetClip(int i)
 void Track::RemoveClip(int i)
 {
   clips_.removeAt(i);
+
+  sequence()->InvalidateClipIndex();
 }
 
 void Track::RemoveClip(Clip *c)
@@ -132,6 +136,8 @@ void Track::RemoveClip(Clip *c)
   for (int i=0;i<clips_.size();i++) {
     if (clips_.at(i).get() == c) {
       clips_.removeAt(i);
+
+      sequence()->InvalidateClipIndex();
       return;
     }
   }
@@ -48,6 +48,8 @@ void TrackList::RemoveTrack(int i)
   }
   tracks_.removeAt(i);
 
+  GetParent()->InvalidateClipIndex();
+
   emit TrackCountChanged();
 }
 
@@ -55,6 +55,8 @@
 #include "panels/panels.h"
 #include "dialogs/debugdialog.h"
 #include "rendering/audio.h"
+#include "rendering/audioconformer.h"
+#include "rendering/compositecache.h"
 #include "rendering/renderfunctions.h"
 #include "undo/undostack.h"
 #include "effects/effectloaders.h"
@@ -294,6 +296,12 @@ MainWindow::MainWindow(QWidget *parent) :
   // start omnipotent proxy generator process
   olive::proxy_generator.start();
 
+  // start conforming audio streams in the background as clips request them
+  olive::audio_conformer.start(QThread::LowPriority);
+
+  // free composited frames that an edit has made stale
+  connect(&olive::undo_stack, SIGNAL(indexChanged(int)), &olive::composite_cache, SLOT(Validate()));
+
   // load preferred language from file
   olive::Global->load_translation_from_config();
 
@@ -680,6 +688,10 @@ void MainWindow::setup_menus() {
   loop_action_->setCheckable(true);
   loop_action_->setData(reinterpret_cast<quintptr>(&olive::config.loop));
 
+  playback_menu->addSeparator();
+
+  render_in_to_out_ = MenuHelper::create_menu_action(playback_menu, "renderintoout", panel_sequence_viewer, SLOT(render_in_to_out()));
+
   // INITIALIZE WINDOW MENU
 
   window_menu = MenuHelper::create_submenu(menuBar, this, SLOT(windowMenu_About_To_Be_Shown()));
@@ -890,6 +902,7 @@ void MainWindow::Retranslate()
   shuttle_right_->setText(tr("Shuttle Right"));
 
   loop_action_->setText(tr("Loop"));
+  render_in_to_out_->setText(tr("Render In to Out"));
 
   window_menu->setTitle(tr("&Window"));
 
@@ -958,6 +971,9 @@ void MainWindow::closeEvent(QCloseEvent *e) {
     // stop proxy generator thread
     olive::proxy_generator.cancel();
 
+    // stop audio conformer thread
+    olive::audio_conformer.Cancel();
+
     panel_graph_editor->set_row(nullptr);
     panel_effect_controls->Clear(true);
 
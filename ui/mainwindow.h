@@ -299,6 +299,7 @@ private:
   QAction* shuttle_stop_;
   QAction* shuttle_right_;
   QAction* loop_action_;
+  QAction* render_in_to_out_;
 
   // window menu
 
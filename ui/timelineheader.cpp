@@ -39,11 +39,13 @@
 #include "ui/menuhelper.h"
 #include "global/debug.h"
 #include "undo/undostack.h"
+#include "rendering/compositecache.h"
 
 #define CLICK_RANGE 5
 #define PLAYHEAD_SIZE 6
 #define LINE_MIN_PADDING 50
 #define SUBLINE_MIN_PADDING 50 // TODO play with this
+#define CACHE_BAR_HEIGHT 3
 
 // used only if center_timeline_timecodes is FALSE
 #define TEXT_PADDING_FROM_LINE 4
@@ -77,6 +79,9 @@ TimelineHeader::TimelineHeader(QWidget *parent) :
 
   setContextMenuPolicy(Qt::CustomContextMenu);
   connect(this, SIGNAL(customContextMenuRequested(const QPoint &)), this, SLOT(show_context_menu(const QPoint &)));
+
+  // show frames as they're added to or removed from the composite cache
+  connect(&olive::composite_cache, SIGNAL(Changed()), this, SLOT(update()));
 }
 
 void TimelineHeader::set_scroll(int s) {
@@ -253,6 +258,7 @@ void TimelineHeader::mouseMoveEvent(QMouseEvent* event) {
 
         update_parents();
       } else {
+        viewer->scrubbing = true;
         set_playhead(event->pos().x());
       }
     } else {
@@ -281,6 +287,13 @@ void TimelineHeader::mouseMoveEvent(QMouseEvent* event) {
 void TimelineHeader::mouseReleaseEvent(QMouseEvent*) {
   if (viewer->seq != nullptr) {
     dragging = false;
+
+    // the frame shown while scrubbing may only be a nearby keyframe, so show the exact frame now
+    if (viewer->scrubbing) {
+      viewer->scrubbing = false;
+      viewer->update_viewer();
+    }
+
     if (resizing_workarea) {
       olive::undo_stack.push(new SetTimelineInOutCommand(viewer->seq.get(), true, temp_workarea_in, temp_workarea_out));
     } else if (dragging_markers && selected_markers.size() > 0) {
@@ -441,6 +454,20 @@ void TimelineHeader::paintEvent(QPaintEvent*) {
       p.drawLine(out_x, 0, out_x, height());
     }
 
+    // draw frames that are in the composite cache
+    QVector<QPair<long, long> > cached_ranges = olive::composite_cache.GetCachedRanges(viewer->seq.get());
+    for (int i=0;i<cached_ranges.size();i++) {
+      int cache_in_x = getHeaderScreenPointFromFrame(cached_ranges.at(i).first);
+      int cache_out_x = getHeaderScreenPointFromFrame(cached_ranges.at(i).second);
+      if (cache_out_x >= 0 && cache_in_x <= width()) {
+        p.fillRect(QRect(cache_in_x,
+                         height() - CACHE_BAR_HEIGHT,
+                         qMax(1, cache_out_x - cache_in_x),
+                         CACHE_BAR_HEIGHT),
+                   QColor(0, 192, 64));
+      }
+    }
+
     // draw markers
     for (int i=0;i<viewer->marker_ref->size();i++) {
       const Marker& m = viewer->marker_ref->at(i);
@@ -52,6 +52,7 @@ extern "C" {
 #include "global/timing.h"
 #include "ui/collapsiblewidget.h"
 #include "undo/undo.h"
+#include "undo/undostack.h"
 #include "project/media.h"
 #include "ui/viewercontainer.h"
 #include "rendering/cacher.h"
@@ -87,6 +88,10 @@ ViewerWidget::ViewerWidget(QWidget *parent) :
   renderer.start(QThread::HighestPriority);
   connect(&renderer, SIGNAL(ready()), this, SLOT(queue_repaint()));
 
+  // keep the renderer from reading sequences while they're being modified
+  connect(&olive::undo_stack, SIGNAL(aboutToChange()), &renderer, SLOT(pause_rendering()));
+  connect(&olive::undo_stack, SIGNAL(changed()), &renderer, SLOT(resume_rendering()));
+
   window = new ViewerWindow(this);
 }
 
@@ -117,6 +122,10 @@ void ViewerWidget::show_context_menu() {
   QAction* save_frame_as_image = menu.addAction(tr("Save Frame as Image..."));
   connect(save_frame_as_image, SIGNAL(triggered(bool)), this, SLOT(save_frame()));
 
+  // clips are decoded at the reduced size while a reduced playback resolution is set, so a saved frame would just be
+  // an upscaled one
+  save_frame_as_image->setEnabled(olive::config.playback_resolution_divider == 1);
+
   Menu* fullscreen_menu = new Menu(tr("Show Fullscreen"));
   menu.addMenu(fullscreen_menu);
   QList<QScreen*> screens = QGuiApplication::screens();
@@ -148,6 +157,19 @@ void ViewerWidget::show_context_menu() {
   connect(&zoom_menu, SIGNAL(triggered(QAction*)), this, SLOT(set_menu_zoom(QAction*)));
   menu.addMenu(&zoom_menu);
 
+  Menu resolution_menu(tr("Playback Resolution"));
+  resolution_menu.addAction(tr("Full"))->setData(1);
+  resolution_menu.addAction("1/2")->setData(2);
+  resolution_menu.addAction("1/4")->setData(4);
+  resolution_menu.addAction("1/8")->setData(8);
+  for (int i=0;i<resolution_menu.actions().size();i++) {
+    QAction* resolution_action = resolution_menu.actions().at(i);
+    resolution_action->setCheckable(true);
+    resolution_action->setChecked(resolution_action->data().toInt() == olive::config.playback_resolution_divider);
+  }
+  connect(&resolution_menu, SIGNAL(triggered(QAction*)), this, SLOT(set_playback_resolution(QAction*)));
+  menu.addMenu(&resolution_menu);
+
   if (viewer->mode() != Viewer::kTimelineMode) {
     menu.addAction(tr("Close Media"), viewer, SLOT(close_media()));
   }
@@ -156,6 +178,10 @@ void ViewerWidget::show_context_menu() {
 }
 
 void ViewerWidget::save_frame() {
+  if (olive::config.playback_resolution_divider != 1) {
+    return;
+  }
+
   QFileDialog fd(this);
   fd.setAcceptMode(QFileDialog::AcceptSave);
   fd.setFileMode(QFileDialog::AnyFile);
@@ -212,6 +238,35 @@ void ViewerWidget::set_menu_zoom(QAction* action) {
   }
 }
 
+void ViewerWidget::set_playback_resolution(QAction *action) {
+  int divider = action->data().toInt();
+
+  if (divider == olive::config.playback_resolution_divider) {
+    return;
+  }
+
+  olive::config.playback_resolution_divider = divider;
+
+  // clips need to re-open their decoders at the new resolution, so stop everything that's using them first (as
+  // Viewer::set_sequence() does before closing a sequence)
+  Viewer* viewers[] = {panel_footage_viewer, panel_sequence_viewer};
+  for (Viewer* v : viewers) {
+    if (v->seq != nullptr) {
+      RenderThread* r = v->viewer_widget()->get_renderer();
+
+      v->pause();
+      r->stop_range_render();
+      r->pause_rendering();
+
+      v->seq->Close();
+
+      r->resume_rendering();
+    }
+  }
+
+  update_ui(false);
+}
+
 void ViewerWidget::retry() {
   update();
 }
@@ -240,7 +295,14 @@ void ViewerWidget::frame_update() {
       update();
     } else {
       doneCurrent();
-      renderer.start_render(context(), viewer->seq.get(), viewer->get_playback_speed());
+      renderer.start_render(context(),
+                            viewer->seq.get(),
+                            viewer->get_playback_speed(),
+                            nullptr,
+                            nullptr,
+                            0,
+                            olive::config.playback_resolution_divider,
+                            viewer->scrubbing);
     }
 
     // render the audio
@@ -726,15 +788,20 @@ void ViewerWidget::paintGL() {
   if (waveform) {
     draw_waveform_func();
   } else {
-    const GLuint tex = renderer.get_texture();
-    QMutex* tex_lock = renderer.get_texture_mutex();
-
-    tex_lock->lock();
+    GLuint tex;
+    GLsync* tex_fence;
+    QMutex* tex_lock = renderer.lock_front_buffer(&tex, &tex_fence);
 
     QOpenGLFunctions* f = context()->functions();
 
     makeCurrent();
 
+    // don't sample the texture before the render thread's GPU commands drawing it have finished (this waits on the GPU
+    // rather than blocking this thread)
+    if (*tex_fence != nullptr) {
+      context()->extraFunctions()->glWaitSync(*tex_fence, 0, GL_TIMEOUT_IGNORED);
+    }
+
     // clear to solid black
     f->glClearColor(0.0, 0.0, 0.0, 0.0);
     f->glClear(GL_COLOR_BUFFER_BIT);
@@ -761,14 +828,21 @@ void ViewerWidget::paintGL() {
     }
 
     if (window->isVisible()) {
-      window->set_texture(tex, double(viewer->seq->width)/double(viewer->seq->height), tex_lock);
+      window->set_texture(tex, double(viewer->seq->width)/double(viewer->seq->height), tex_lock, tex_fence);
     }
 
     tex_lock->unlock();
 
     if (renderer.did_texture_fail() && !viewer->playing) {
       doneCurrent();
-      renderer.start_render(context(), viewer->seq.get(), viewer->get_playback_speed());
+      renderer.start_render(context(),
+                            viewer->seq.get(),
+                            viewer->get_playback_speed(),
+                            nullptr,
+                            nullptr,
+                            0,
+                            olive::config.playback_resolution_divider,
+                            viewer->scrubbing);
     }
   }
 }
@@ -110,6 +110,7 @@ private slots:
   void set_fit_zoom();
   void set_custom_zoom();
   void set_menu_zoom(QAction *action);
+  void set_playback_resolution(QAction* action);
 };
 
 #endif // VIEWERWIDGET_H
@@ -27,6 +27,7 @@
 #include <QMenuBar>
 #include <QShortcut>
 #include <QOpenGLFunctions>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLContext>
 #include <QDebug>
 
@@ -38,6 +39,7 @@ ViewerWindow::ViewerWindow(QWidget *parent) :
   QOpenGLWidget(parent, Qt::Window),
   texture_(0),
   mutex_(nullptr),
+  fence_(nullptr),
   show_fullscreen_msg_(false)
 {
   setMouseTracking(true);
@@ -46,10 +48,11 @@ ViewerWindow::ViewerWindow(QWidget *parent) :
   connect(&fullscreen_msg_timer_, SIGNAL(timeout()), this, SLOT(fullscreen_msg_timeout()));
 }
 
-void ViewerWindow::set_texture(GLuint t, double iar, QMutex* imutex) {
+void ViewerWindow::set_texture(GLuint t, double iar, QMutex* imutex, GLsync* ifence) {
   texture_ = t;
   ar_ = iar;
   mutex_ = imutex;
+  fence_ = ifence;
   update();
 }
 
@@ -122,6 +125,11 @@ void ViewerWindow::paintGL() {
 
     makeCurrent();
 
+    // the render thread no longer finishes every frame, so wait on the GPU until it's done drawing this one
+    if (fence_ != nullptr && *fence_ != nullptr) {
+      context()->extraFunctions()->glWaitSync(*fence_, 0, GL_TIMEOUT_IGNORED);
+    }
+
     // clear to solid black
     f->glClearColor(0.0, 0.0, 0.0, 0.0);
     f->glClear(GL_COLOR_BUFFER_BIT);
@@ -33,7 +33,7 @@ class ViewerWindow : public QOpenGLWidget {
   Q_OBJECT
 public:
   ViewerWindow(QWidget *parent);
-  void set_texture(GLuint t, double iar, QMutex *imutex);
+  void set_texture(GLuint t, double iar, QMutex *imutex, GLsync* ifence);
 protected:
   virtual void showEvent(QShowEvent*) override;
   virtual void keyPressEvent(QKeyEvent*) override;
@@ -46,6 +46,10 @@ private:
   GLuint texture_;
   double ar_;
   QMutex* mutex_;
+
+  // fence of the texture's front buffer, only valid to read while mutex_ is locked since the render thread replaces it
+  // every frame
+  GLsync* fence_;
   QOpenGLShaderProgramPtr pipeline_;
 
   // shortcuts
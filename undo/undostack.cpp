@@ -20,4 +20,25 @@
 
 #include "undostack.h"
 
-QUndoStack olive::undo_stack;
+UndoStack olive::undo_stack;
+
+void UndoStack::push(QUndoCommand *cmd)
+{
+  emit aboutToChange();
+  QUndoStack::push(cmd);
+  emit changed();
+}
+
+void UndoStack::undo()
+{
+  emit aboutToChange();
+  QUndoStack::undo();
+  emit changed();
+}
+
+void UndoStack::redo()
+{
+  emit aboutToChange();
+  QUndoStack::redo();
+  emit changed();
+}
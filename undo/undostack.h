@@ -23,11 +23,50 @@
 
 #include <QUndoStack>
 
+/**
+ * @brief The UndoStack class
+ *
+ * QUndoStack that signals before and after it executes a command, so anything reading sequences from another thread
+ * (e.g. a RenderThread) can stay out of the way while they're modified.
+ */
+class UndoStack : public QUndoStack {
+  Q_OBJECT
+public:
+  /**
+   * @brief Execute a command and add it to the stack (see QUndoStack::push())
+   */
+  void push(QUndoCommand* cmd);
+
+public slots:
+  /**
+   * @brief Undo the current command (see QUndoStack::undo())
+   */
+  void undo();
+
+  /**
+   * @brief Redo the next command (see QUndoStack::redo())
+   */
+  void redo();
+
+signals:
+  /**
+   * @brief Emitted right before a command is executed or undone
+   */
+  void aboutToChange();
+
+  /**
+   * @brief Emitted right after a command has been executed or undone
+   *
+   * Always follows aboutToChange().
+   */
+  void changed();
+};
+
 namespace olive {
 /**
  * @brief Global undo stack object
  */
-extern QUndoStack undo_stack;
+extern UndoStack undo_stack;
 }
 
 #endif // UNDOSTACK_H